@@ -0,0 +1,499 @@
+/******************************************************************************
+* Filename: cJSON-bench.c
+*
+* Description:
+* Checks and times the string scanning in cJSON.c against a byte at a time
+* reference, the way cJSON walked strings before they were scanned 16 bytes
+* at a time.
+*
+* The checks, which run first, compare cJSON against the reference:
+*  - random strings covering every byte value print exactly as the reference
+*    escapes them and parse back to the same bytes,
+*  - random string literals mixing plain text, raw control characters and
+*    every escape, including \uXXXX and surrogate pairs, parse to the bytes
+*    the reference decodes them to,
+*  - every truncated prefix of an offer is rejected and the whole offer parses.
+* String lengths run across several 16 byte chunks so the special characters
+* land at every offset within a chunk and in the byte loop tail.
+*
+* Then {"type":"offer","sdp":...} documents with 1, 2 and 6 media sections are
+* parsed and printed, and the time per call is reported. The document in a
+* file given with --file is timed as well.
+*
+* The cJSON-bench-scalar target is the same program built with
+* CJSON_SCAN_SCALAR, so cJSON scans a byte at a time even where SSE2 is
+* available. The cJSON-bench-compare target runs both, one after the other,
+* to show the SSE2 scanner's timings next to the scalar fallback's. Only SSE2
+* has a vector scanner, elsewhere both builds use the byte loop.
+*
+* Usage:
+* cJSON-bench [--iterations 20000] [--file offer.json]
+*
+* Build with -fsanitize=address,undefined to run the checks under the
+* sanitizers, the cJSON-bench target itself is built with -O2 for timing.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cJSON.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20000
+#define CHECK_STRING_COUNT 20000
+#define CHECK_STRING_MAX_LENGTH 300
+#define CHECK_LITERAL_MAX_PIECES 80
+#define SDP_MAX_LENGTH 65536
+
+/* The same test as cJSON.c uses to pick its scanner. */
+#if !defined(CJSON_SCAN_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define BENCH_SCANNER "SSE2"
+#else
+#define BENCH_SCANNER "scalar"
+#endif
+
+static double now_seconds(void);
+static size_t reference_escape(const unsigned char* input, char* output);
+static size_t append_utf8(unsigned int codepoint, char* output);
+static int check_print_round_trip(void);
+static int check_parse_literals(void);
+static int check_truncated_offer(const char* text);
+static char* make_sdp(int media_count);
+static char* make_offer(const char* sdp);
+static void bench_document(const char* name, const char* text, int iterations);
+
+int main(int argc, char* argv[])
+{
+  int iterations = BENCH_DEFAULT_ITERATIONS;
+  const char* file_path = NULL;
+  int media_counts[] = { 1, 2, 6 };
+  char name[64];
+  char* sdp;
+  char* text;
+  int failures = 0;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+      file_path = argv[++i];
+    }
+    else {
+      fprintf(stderr, "Usage: cJSON-bench [--iterations %d] [--file offer.json]\n", BENCH_DEFAULT_ITERATIONS);
+      return 2;
+    }
+  }
+
+  if (iterations <= 0) {
+    fprintf(stderr, "The iteration count must be positive.\n");
+    return 2;
+  }
+
+  sdp = make_sdp(2);
+  text = make_offer(sdp);
+
+  failures += check_print_round_trip();
+  failures += check_parse_literals();
+  failures += check_truncated_offer(text);
+
+  free(text);
+  free(sdp);
+
+  if (failures > 0) {
+    printf("%d check(s) failed.\n", failures);
+    return 1;
+  }
+
+  printf("Checks passed, timing the %s string scanner.\n", BENCH_SCANNER);
+
+  for (i = 0; i < (int)(sizeof(media_counts) / sizeof(media_counts[0])); i++) {
+    sdp = make_sdp(media_counts[i]);
+    text = make_offer(sdp);
+    snprintf(name, sizeof(name), "%d media offer", media_counts[i]);
+    bench_document(name, text, iterations);
+    free(text);
+    free(sdp);
+  }
+
+  if (file_path != NULL) {
+    FILE* file = fopen(file_path, "rb");
+    long length;
+
+    if (file == NULL || fseek(file, 0, SEEK_END) != 0 || (length = ftell(file)) < 0) {
+      fprintf(stderr, "Could not read %s.\n", file_path);
+      return 2;
+    }
+
+    rewind(file);
+    text = (char*)malloc((size_t)length + 1);
+    text[fread(text, 1, (size_t)length, file)] = '\0';
+    fclose(file);
+
+    bench_document(file_path, text, iterations);
+    free(text);
+  }
+
+  return 0;
+}
+
+static double now_seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+* Escapes a string a byte at a time the way cJSON's printer always has.
+* @param[in] input: the null terminated string to escape.
+* @param[out] output: at least six times the input's length plus one.
+* @@Returns the length of the escaped string, without quotes.
+*/
+static size_t reference_escape(const unsigned char* input, char* output)
+{
+  char* output_start = output;
+
+  for (; *input != '\0'; input++) {
+    switch (*input) {
+    case '\"': *output++ = '\\'; *output++ = '\"'; break;
+    case '\\': *output++ = '\\'; *output++ = '\\'; break;
+    case '\b': *output++ = '\\'; *output++ = 'b'; break;
+    case '\f': *output++ = '\\'; *output++ = 'f'; break;
+    case '\n': *output++ = '\\'; *output++ = 'n'; break;
+    case '\r': *output++ = '\\'; *output++ = 'r'; break;
+    case '\t': *output++ = '\\'; *output++ = 't'; break;
+    default:
+      if (*input < 32) {
+        output += sprintf(output, "\\u%04x", *input);
+      }
+      else {
+        *output++ = (char)*input;
+      }
+      break;
+    }
+  }
+
+  *output = '\0';
+  return (size_t)(output - output_start);
+}
+
+static size_t append_utf8(unsigned int codepoint, char* output)
+{
+  if (codepoint < 0x80) {
+    output[0] = (char)codepoint;
+    return 1;
+  }
+  else if (codepoint < 0x800) {
+    output[0] = (char)(0xC0 | (codepoint >> 6));
+    output[1] = (char)(0x80 | (codepoint & 0x3F));
+    return 2;
+  }
+  else if (codepoint < 0x10000) {
+    output[0] = (char)(0xE0 | (codepoint >> 12));
+    output[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    output[2] = (char)(0x80 | (codepoint & 0x3F));
+    return 3;
+  }
+
+  output[0] = (char)(0xF0 | (codepoint >> 18));
+  output[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+  output[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+  output[3] = (char)(0x80 | (codepoint & 0x3F));
+  return 4;
+}
+
+/**
+* Prints random strings of every non zero byte value, both as a value and as
+* a key, and compares them with the reference escaping. Each printed document
+* has to parse back to the original bytes.
+* @@Returns the number of strings that failed.
+*/
+static int check_print_round_trip(void)
+{
+  unsigned char input[CHECK_STRING_MAX_LENGTH + 1];
+  char escaped[CHECK_STRING_MAX_LENGTH * 6 + 1];
+  char* expected = (char*)malloc(sizeof(escaped) * 2 + 16);
+  unsigned int seed = 1;
+  int failures = 0;
+  int i, j, length;
+
+  for (i = 0; i < CHECK_STRING_COUNT; i++) {
+    cJSON* object = cJSON_CreateObject();
+    cJSON* parsed;
+    cJSON* item;
+    char* printed;
+
+    length = rand_r(&seed) % CHECK_STRING_MAX_LENGTH;
+    for (j = 0; j < length; j++) {
+      /* Mostly plain text so the specials fall at varying offsets, as in an SDP. */
+      input[j] = (rand_r(&seed) % 4 == 0) ? (unsigned char)(1 + rand_r(&seed) % 255) : (unsigned char)('a' + j % 26);
+    }
+    input[length] = '\0';
+
+    reference_escape(input, escaped);
+    snprintf(expected, sizeof(escaped) * 2 + 16, "{\"%s\":\"%s\"}", escaped, escaped);
+
+    cJSON_AddStringToObject(object, (const char*)input, (const char*)input);
+    printed = cJSON_PrintUnformatted(object);
+    parsed = printed != NULL ? cJSON_Parse(printed) : NULL;
+    item = parsed != NULL ? parsed->child : NULL;
+
+    if (printed == NULL || strcmp(printed, expected) != 0 ||
+      item == NULL || strcmp(item->string, (const char*)input) != 0 || strcmp(item->valuestring, (const char*)input) != 0) {
+      if (failures++ == 0) {
+        printf("Print round trip failed for string %d:\n  expected %s\n  printed  %s\n", i, expected, printed != NULL ? printed : "(null)");
+      }
+    }
+
+    free(printed);
+    cJSON_Delete(parsed);
+    cJSON_Delete(object);
+  }
+
+  free(expected);
+
+  if (failures > 0) {
+    printf("Print round trip: %d of %d strings failed.\n", failures, CHECK_STRING_COUNT);
+  }
+
+  return failures > 0;
+}
+
+/**
+* Builds random string literals from plain runs, raw control characters, the
+* two character escapes and \u escapes, alongside the bytes the reference
+* decodes them to, and parses them.
+* @@Returns the number of literals that failed.
+*/
+static int check_parse_literals(void)
+{
+  static const char short_escapes[] = "\"\\/bfnrt";
+  static const char short_escaped[] = "\"\\/\b\f\n\r\t";
+  char literal[CHECK_LITERAL_MAX_PIECES * 32];
+  char expected[CHECK_LITERAL_MAX_PIECES * 32];
+  unsigned int seed = 2;
+  unsigned int codepoint;
+  size_t literal_length, expected_length;
+  int failures = 0;
+  int i, j, k, pieces, run;
+
+  for (i = 0; i < CHECK_STRING_COUNT; i++) {
+    cJSON* parsed;
+
+    literal_length = 0;
+    expected_length = 0;
+    literal[literal_length++] = '\"';
+    pieces = rand_r(&seed) % CHECK_LITERAL_MAX_PIECES;
+
+    for (j = 0; j < pieces; j++) {
+      switch (rand_r(&seed) % 6) {
+      case 0:
+      case 1:
+        /* Plain bytes, anything but a quote, backslash or null. */
+        run = rand_r(&seed) % 24;
+        for (k = 0; k < run; k++) {
+          char c;
+          do {
+            c = (char)(1 + rand_r(&seed) % 255);
+          } while (c == '\"' || c == '\\');
+          literal[literal_length++] = c;
+          expected[expected_length++] = c;
+        }
+        break;
+      case 2:
+        /* cJSON has always passed raw control characters through. */
+        literal[literal_length] = expected[expected_length] = (char)(1 + rand_r(&seed) % 31);
+        literal_length++;
+        expected_length++;
+        break;
+      case 3:
+        k = rand_r(&seed) % (int)(sizeof(short_escapes) - 1);
+        literal[literal_length++] = '\\';
+        literal[literal_length++] = short_escapes[k];
+        expected[expected_length++] = short_escaped[k];
+        break;
+      case 4:
+        /* A BMP character other than a surrogate or null. */
+        do {
+          codepoint = 1 + rand_r(&seed) % 0xFFFF;
+        } while (codepoint >= 0xD800 && codepoint <= 0xDFFF);
+        literal_length += sprintf(literal + literal_length, "\\u%04X", codepoint);
+        expected_length += append_utf8(codepoint, expected + expected_length);
+        break;
+      default:
+        codepoint = 0x10000 + rand_r(&seed) % 0x100000;
+        literal_length += sprintf(literal + literal_length, "\\u%04x\\u%04x",
+          0xD800 + ((codepoint - 0x10000) >> 10), 0xDC00 + ((codepoint - 0x10000) & 0x3FF));
+        expected_length += append_utf8(codepoint, expected + expected_length);
+        break;
+      }
+    }
+
+    literal[literal_length++] = '\"';
+    literal[literal_length] = '\0';
+    expected[expected_length] = '\0';
+
+    parsed = cJSON_ParseWithLength(literal, literal_length);
+    if (parsed == NULL || !cJSON_IsString(parsed) || strcmp(parsed->valuestring, expected) != 0) {
+      if (failures++ == 0) {
+        printf("Parse failed for literal %d: %s\n", i, literal);
+      }
+    }
+
+    cJSON_Delete(parsed);
+  }
+
+  if (failures > 0) {
+    printf("Parse literals: %d of %d literals failed.\n", failures, CHECK_STRING_COUNT);
+  }
+
+  return failures > 0;
+}
+
+/**
+* Parses every prefix of an offer without its terminator. All but the whole
+* document have to be rejected, and the whole one has to print back the same.
+* @@Returns 1 if any prefix was handled wrongly.
+*/
+static int check_truncated_offer(const char* text)
+{
+  size_t length = strlen(text);
+  size_t i;
+  int failures = 0;
+
+  for (i = 0; i <= length; i++) {
+    /* cJSON looks at the byte after an object's last member without checking
+    * the length, as it always has, so the copy is null terminated. Reading any
+    * further past the prefix is caught by ASan. */
+    char* prefix = (char*)malloc(i + 1);
+    cJSON* parsed;
+    char* printed = NULL;
+
+    memcpy(prefix, text, i);
+    prefix[i] = '\0';
+    parsed = cJSON_ParseWithLength(prefix, i);
+    if (parsed != NULL) {
+      printed = cJSON_PrintUnformatted(parsed);
+    }
+
+    if ((i < length && parsed != NULL) || (i == length && (printed == NULL || strcmp(printed, text) != 0))) {
+      if (failures++ == 0) {
+        printf("Truncated offer: the %zu byte prefix was %s.\n", i, parsed != NULL ? "accepted" : "rejected");
+      }
+    }
+
+    free(printed);
+    cJSON_Delete(parsed);
+    free(prefix);
+  }
+
+  return failures > 0;
+}
+
+/**
+* A browser style offer with a number of video sections. The cname carries a
+* quote and a backslash so the escapes are exercised too.
+*/
+static char* make_sdp(int media_count)
+{
+  char* sdp = (char*)malloc(SDP_MAX_LENGTH);
+  size_t length = 0;
+  int media, payload;
+
+  length += snprintf(sdp + length, SDP_MAX_LENGTH - length,
+    "v=0\r\no=- 4611731400430051336 2 IN IP4 127.0.0.1\r\ns=-\r\nt=0 0\r\n"
+    "a=group:BUNDLE 0 1\r\na=msid-semantic: WMS stream\r\n");
+
+  for (media = 0; media < media_count; media++) {
+    length += snprintf(sdp + length, SDP_MAX_LENGTH - length,
+      "m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 102\r\nc=IN IP4 0.0.0.0\r\na=rtcp:9 IN IP4 0.0.0.0\r\n"
+      "a=ice-ufrag:Vhv3\r\na=ice-pwd:YJ8dn7K3Ghs0ZC4xq0BtAYyz\r\na=ice-options:trickle\r\n"
+      "a=fingerprint:sha-256 7B:8B:F0:65:5F:78:E2:51:3B:AC:6F:F3:3F:46:1B:35:DC:B8:5F:64:1A:24:C2:43:F0:A1:58:D0:A1:2C:19:08\r\n"
+      "a=setup:actpass\r\na=mid:%d\r\na=extmap:1 urn:ietf:params:rtp-hdrext:toffset\r\n"
+      "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\na=sendrecv\r\na=rtcp-mux\r\na=rtcp-rsize\r\n",
+      media);
+
+    for (payload = 96; payload < 103; payload++) {
+      length += snprintf(sdp + length, SDP_MAX_LENGTH - length,
+        "a=rtpmap:%d VP8/90000\r\na=rtcp-fb:%d goog-remb\r\na=rtcp-fb:%d transport-cc\r\n"
+        "a=rtcp-fb:%d ccm fir\r\na=rtcp-fb:%d nack\r\na=rtcp-fb:%d nack pli\r\n",
+        payload, payload, payload, payload, payload, payload);
+    }
+
+    length += snprintf(sdp + length, SDP_MAX_LENGTH - length,
+      "a=ssrc:1001 cname:\"stream\\video\"\r\na=candidate:1 1 udp 2122260223 192.168.1.10 54321 typ host generation 0\r\n");
+  }
+
+  return sdp;
+}
+
+static char* make_offer(const char* sdp)
+{
+  cJSON* offer = cJSON_CreateObject();
+  char* text;
+
+  cJSON_AddStringToObject(offer, "type", "offer");
+  cJSON_AddStringToObject(offer, "sdp", sdp);
+  text = cJSON_PrintUnformatted(offer);
+  cJSON_Delete(offer);
+
+  return text;
+}
+
+/**
+* Times parsing a document and printing it back, formatted and unformatted.
+*/
+static void bench_document(const char* name, const char* text, int iterations)
+{
+  cJSON* document = cJSON_Parse(text);
+  size_t checksum = 0;
+  double start, parse_seconds, print_seconds, print_formatted_seconds;
+  int i;
+
+  if (document == NULL) {
+    printf("%s: not valid JSON, skipped.\n", name);
+    return;
+  }
+
+  start = now_seconds();
+  for (i = 0; i < iterations; i++) {
+    cJSON* parsed = cJSON_Parse(text);
+    checksum += parsed->child != NULL;
+    cJSON_Delete(parsed);
+  }
+  parse_seconds = now_seconds() - start;
+
+  start = now_seconds();
+  for (i = 0; i < iterations; i++) {
+    char* printed = cJSON_PrintUnformatted(document);
+    checksum += printed[1];
+    free(printed);
+  }
+  print_seconds = now_seconds() - start;
+
+  start = now_seconds();
+  for (i = 0; i < iterations; i++) {
+    char* printed = cJSON_Print(document);
+    checksum += printed[1];
+    free(printed);
+  }
+  print_formatted_seconds = now_seconds() - start;
+
+  /* The checksum keeps the loops from being optimised away. */
+  printf("%s, %zu bytes: parse %.2f us, print unformatted %.2f us, print %.2f us (%zu)\n", name, strlen(text),
+    parse_seconds * 1e6 / iterations, print_seconds * 1e6 / iterations,
+    print_formatted_seconds * 1e6 / iterations, checksum % 10);
+
+  cJSON_Delete(document);
+}
@@ -49,6 +49,16 @@
 #include <locale.h>
 #endif
 
+/* Only SSE2 is implemented, other targets scan a byte at a time. Defining
+ * CJSON_SCAN_SCALAR forces the byte loop on SSE2 targets too, for comparison. */
+#if !defined(CJSON_SCAN_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#include <emmintrin.h>
+#define CJSON_SCAN_SSE2
+#endif
+#if defined(_MSC_VER) && defined(CJSON_SCAN_SSE2)
+#include <intrin.h>
+#endif
+
 #if defined(_MSC_VER)
 #pragma warning (pop)
 #endif
@@ -765,6 +775,125 @@ fail:
     return 0;
 }
 
+#if defined(CJSON_SCAN_SSE2)
+/* index of the lowest set bit of a non zero mask */
+static unsigned int lowest_set_bit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+static unsigned int count_set_bits(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned int count = 0;
+    for (; mask != 0; mask &= mask - 1)
+    {
+        count++;
+    }
+    return count;
+#else
+    return (unsigned int)__builtin_popcount(mask);
+#endif
+}
+
+/* mask of the quotes, backslashes and, if control_characters is set, control characters in 16 bytes */
+static __m128i special_characters(const __m128i chunk, const cJSON_bool control_characters)
+{
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\')));
+    if (control_characters)
+    {
+        /* unsigned chunk <= 31 */
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(_mm_min_epu8(chunk, _mm_set1_epi8(31)), chunk));
+    }
+    return special;
+}
+#endif
+
+/* Find the first quote, backslash or, if control_characters is set, control
+ * character between input and end. Returns end if there is none. Runs of plain
+ * text, which is most of a document holding an SDP, are checked 16 bytes at a
+ * time with SSE2 where it's available. */
+static const unsigned char *find_special_character(const unsigned char *input, const unsigned char * const end, const cJSON_bool control_characters)
+{
+#if defined(CJSON_SCAN_SSE2)
+    while ((end - input) >= 16)
+    {
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(special_characters(_mm_loadu_si128((const __m128i*)input), control_characters));
+        if (mask != 0)
+        {
+            return input + lowest_set_bit(mask);
+        }
+        input += 16;
+    }
+#endif
+
+    while ((input < end) && (*input != '\"') && (*input != '\\') && (!control_characters || (*input > 31)))
+    {
+        input++;
+    }
+
+    return input;
+}
+
+/* How many more characters than there are between input and end it takes to
+ * escape them. Most escapes are two characters, other control characters
+ * become six character \uXXXX sequences. */
+static size_t count_escape_characters(const unsigned char *input, const unsigned char * const end)
+{
+    size_t escape_characters = 0;
+
+#if defined(CJSON_SCAN_SSE2)
+    while ((end - input) >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)input);
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(special_characters(chunk, true));
+        if (mask != 0)
+        {
+            /* quote, backslash, \b, \f, \n, \r and \t */
+            __m128i short_escapes = _mm_or_si128(special_characters(chunk, false),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\b')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\f'))),
+                _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')))));
+            unsigned int long_escapes = mask & ~(unsigned int)_mm_movemask_epi8(short_escapes);
+            escape_characters += count_set_bits(mask) + (4 * count_set_bits(long_escapes));
+        }
+        input += 16;
+    }
+#endif
+
+    for (; input < end; input++)
+    {
+        switch (*input)
+        {
+            case '\"':
+            case '\\':
+            case '\b':
+            case '\f':
+            case '\n':
+            case '\r':
+            case '\t':
+                /* one character escape sequence */
+                escape_characters++;
+                break;
+            default:
+                if (*input < 32)
+                {
+                    /* UTF-16 escape sequence uXXXX */
+                    escape_characters += 5;
+                }
+                break;
+        }
+    }
+
+    return escape_characters;
+}
+
 /* Parse the input text into an unescaped cinput, and populate item. */
 static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_buffer)
 {
@@ -783,22 +912,25 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
         /* calculate approximate size of the output (overestimate) */
         size_t allocation_length = 0;
         size_t skipped_bytes = 0;
-        while (((size_t)(input_end - input_buffer->content) < input_buffer->length) && (*input_end != '\"'))
+        const unsigned char * const content_end = input_buffer->content + input_buffer->length;
+        for (;;)
         {
+            input_end = find_special_character(input_end, content_end, false);
+            if ((input_end >= content_end) || (*input_end == '\"'))
+            {
+                break;
+            }
+
             /* is escape sequence */
-            if (input_end[0] == '\\')
+            if ((input_end + 1) >= content_end)
             {
-                if ((size_t)(input_end + 1 - input_buffer->content) >= input_buffer->length)
-                {
-                    /* prevent buffer overflow when last input character is a backslash */
-                    goto fail;
-                }
-                skipped_bytes++;
-                input_end++;
+                /* prevent buffer overflow when last input character is a backslash */
+                goto fail;
             }
-            input_end++;
+            skipped_bytes++;
+            input_end += 2;
         }
-        if (((size_t)(input_end - input_buffer->content) >= input_buffer->length) || (*input_end != '\"'))
+        if ((input_end >= content_end) || (*input_end != '\"'))
         {
             goto fail; /* string ended unexpectedly */
         }
@@ -818,7 +950,11 @@ static cJSON_bool parse_string(cJSON * const item, parse_buffer * const input_bu
     {
         if (*input_pointer != '\\')
         {
-            *output_pointer++ = *input_pointer++;
+            /* copy everything up to the next escape sequence in one go */
+            const unsigned char *run_end = find_special_character(input_pointer, input_end, false);
+            memcpy(output_pointer, input_pointer, (size_t)(run_end - input_pointer));
+            output_pointer += run_end - input_pointer;
+            input_pointer = run_end;
         }
         /* escape sequence */
         else
@@ -898,6 +1034,7 @@ fail:
 static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffer * const output_buffer)
 {
     const unsigned char *input_pointer = NULL;
+    const unsigned char *input_end = NULL;
     unsigned char *output = NULL;
     unsigned char *output_pointer = NULL;
     size_t output_length = 0;
@@ -923,30 +1060,9 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     }
 
     /* set "flag" to 1 if something needs to be escaped */
-    for (input_pointer = input; *input_pointer; input_pointer++)
-    {
-        switch (*input_pointer)
-        {
-            case '\"':
-            case '\\':
-            case '\b':
-            case '\f':
-            case '\n':
-            case '\r':
-            case '\t':
-                /* one character escape sequence */
-                escape_characters++;
-                break;
-            default:
-                if (*input_pointer < 32)
-                {
-                    /* UTF-16 escape sequence uXXXX */
-                    escape_characters += 5;
-                }
-                break;
-        }
-    }
-    output_length = (size_t)(input_pointer - input) + escape_characters;
+    input_end = input + strlen((const char*)input);
+    escape_characters = count_escape_characters(input, input_end);
+    output_length = (size_t)(input_end - input) + escape_characters;
 
     output = ensure(output_buffer, output_length + sizeof("\"\""));
     if (output == NULL)
@@ -968,47 +1084,52 @@ static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffe
     output[0] = '\"';
     output_pointer = output + 1;
     /* copy the string */
-    for (input_pointer = input; *input_pointer != '\0'; (void)input_pointer++, output_pointer++)
+    for (input_pointer = input; input_pointer < input_end; (void)input_pointer++, output_pointer++)
     {
-        if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\'))
-        {
-            /* normal character, copy */
-            *output_pointer = *input_pointer;
-        }
-        else
+        const unsigned char *run_end = find_special_character(input_pointer, input_end, true);
+        if (run_end != input_pointer)
         {
-            /* character needs to be escaped */
-            *output_pointer++ = '\\';
-            switch (*input_pointer)
+            /* normal characters, copy them in one go */
+            memcpy(output_pointer, input_pointer, (size_t)(run_end - input_pointer));
+            output_pointer += run_end - input_pointer;
+            input_pointer = run_end;
+            if (input_pointer == input_end)
             {
-                case '\\':
-                    *output_pointer = '\\';
-                    break;
-                case '\"':
-                    *output_pointer = '\"';
-                    break;
-                case '\b':
-                    *output_pointer = 'b';
-                    break;
-                case '\f':
-                    *output_pointer = 'f';
-                    break;
-                case '\n':
-                    *output_pointer = 'n';
-                    break;
-                case '\r':
-                    *output_pointer = 'r';
-                    break;
-                case '\t':
-                    *output_pointer = 't';
-                    break;
-                default:
-                    /* escape and print as unicode codepoint */
-                    sprintf((char*)output_pointer, "u%04x", *input_pointer);
-                    output_pointer += 4;
-                    break;
+                break;
             }
         }
+
+        /* character needs to be escaped */
+        *output_pointer++ = '\\';
+        switch (*input_pointer)
+        {
+            case '\\':
+                *output_pointer = '\\';
+                break;
+            case '\"':
+                *output_pointer = '\"';
+                break;
+            case '\b':
+                *output_pointer = 'b';
+                break;
+            case '\f':
+                *output_pointer = 'f';
+                break;
+            case '\n':
+                *output_pointer = 'n';
+                break;
+            case '\r':
+                *output_pointer = 'r';
+                break;
+            case '\t':
+                *output_pointer = 't';
+                break;
+            default:
+                /* escape and print as unicode codepoint */
+                sprintf((char*)output_pointer, "u%04x", *input_pointer);
+                output_pointer += 4;
+                break;
+        }
     }
     output[output_length + 1] = '\"';
     output[output_length + 2] = '\0';
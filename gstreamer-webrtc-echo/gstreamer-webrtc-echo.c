@@ -16,6 +16,64 @@
 * Remarks:
 * To find the properties and signals available for the webrtcbin plugin see:
 * https://gitlab.freedesktop.org/gstreamer/gst-plugins-bad/-/blob/master/ext/webrtc/gstwebrtcbin.c#L6489
+*
+* SIGTERM puts the server into drain mode, new offers get a 503 and the
+* process exits once the existing pipelines have gone or the drain timeout
+* passes. With --handoff PATH a replacement server started with the same PATH
+* takes over the listening socket over a Unix socket (SCM_RIGHTS) before this
+* one stops accepting, so signaling stays up through a restart.
+*
+* /whip takes a WHIP (RFC 9725) offer as raw SDP and returns the raw SDP
+* answer plus a resource URL. A PATCH to the resource trickles the remote
+* candidates in an SDP fragment and a DELETE shuts its pipeline down.
+*
+* Pipelines are built ahead of time on the GStreamer main loop and parked in
+* the READY state, so an offer only has to take one from the pool and set it
+* playing. The pool is topped back up in the background after every offer.
+* /stats reports the pool's hit rate and the offer to answer latencies.
+*
+* With --broadcast every peer gets the same stream. One shared pipeline runs
+* the test source and the VP8 encoder and hands its RTP packets to each peer
+* pipeline's appsrc, so a peer only costs its own SRTP and transport. A
+* keyframe is requested whenever a peer connects or asks for one.
+*
+* --simulcast adds two smaller layers to the broadcast, each scaled and
+* encoded once. Peers are fed encoded frames from one layer and payload them
+* themselves, so moving between layers at a keyframe leaves their RTP stream
+* unbroken. Each peer's layer follows the loss in its receiver reports.
+*
+* With --echo each peer is sent back its own video instead of the test
+* source. The incoming VP8 RTP is depayloaded and payloaded again straight
+* into the webrtcbin, nothing is decoded or encoded, so a peer costs little
+* more than its SRTP and the echo's latency is close to the network's.
+*
+* --trace-sample N adds a buffer probe to every element boundary. Every Nth
+* buffer leaving a source is stamped with a reference timestamp meta and each
+* boundary it crosses records how long it's been since, along with the fill
+* level of a queue. Queue overruns are counted. The aggregates are in /stats
+* and printed every --trace-dump seconds. With tracing off no probes are added.
+*
+* --encoder picks the test source's encoder from a table of profiles, VP8,
+* VP9 or H.264 with their threads, token partitions, speed, keyframe
+* interval and bitrate, any of which can be overridden. --benchmark encodes
+* a clip at 720p and 1080p with each profile and reports the frame rate and
+* CPU use, to find the cheapest profile a host can run.
+*
+* Offers never block the libevent thread. The request is parked while the
+* webrtcbin works through set-remote-description, create-answer and
+* set-local-description, each started from the previous one's promise
+* callback. The finished answer is queued back to the libevent thread, which
+* sends the reply, so any number of offers can be in progress at once.
+*
+* Every session is kept in a registry along with its connection state. A
+* timer on the libevent thread tears down the whole pipeline of any session
+* that has failed or closed, has been disconnected for longer than a grace
+* period or never connected within --session-timeout seconds. --max-sessions
+* caps how many can run at once, offers beyond it get a 503. /stats reports
+* the live sessions and the process's thread count and resident memory.
+*
+* Only the lengths of the offer and answer SDPs are printed, --verbose prints
+* them in full.
 * 
 * Author:
 * Aaron Clauson (aaron@sipsorcery.com)
@@ -34,31 +92,282 @@
 #include <event2/event.h>
 #include <event2/http.h>
 #include <event2/http_struct.h>
+#include <gst/app/gstappsink.h>
+#include <gst/app/gstappsrc.h>
 #include <gst/gst.h>
+#include <gst/video/video.h>
 #include <gst/webrtc/webrtc.h>
 #include <gst/webrtc/dtlstransport.h>
 
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 #define HTTP_SERVER_ADDRESS "0.0.0.0"
 #define HTTP_SERVER_PORT 8080
 #define HTTP_OFFER_URL "/offer"
+#define HTTP_WHIP_URL "/whip"
+#define HTTP_STATS_URL "/stats"
+#define SDP_CONTENT_TYPE "application/sdp"
+#define TRICKLE_CONTENT_TYPE "application/trickle-ice-sdpfrag"
 #define RTP_CAPS_VP8 "application/x-rtp,media=video,encoding-name=VP8,payload=96"
-//#define RTP_CAPS_H264 "application/x-rtp,media=video,encoding-name=H264,payload=104"
+#define RTP_CAPS_VP9 "application/x-rtp,media=video,encoding-name=VP9,payload=98"
+#define RTP_CAPS_H264 "application/x-rtp,media=video,encoding-name=H264,payload=104"
+#define RTP_CAPS_CLOCK_RATE ",clock-rate=90000"
+#define BROADCAST_KEYFRAME_MAX_DIST 300
+#define BROADCAST_PEER_QUEUE_BUFFERS 256
+#define SIMULCAST_LAYERS 3
+#define SIMULCAST_PEER_QUEUE_FRAMES 30
+#define SIMULCAST_STATS_INTERVAL_SECONDS 1
+#define SIMULCAST_LOSS_DOWN 0.10
+#define SIMULCAST_LOSS_UP 0.02
+#define SIMULCAST_UP_HOLD_SECONDS 5
+#define ECHO_JITTERBUFFER_LATENCY_MS 20
+#define TRACE_DUMP_INTERVAL_SECONDS 10
+#define TRACE_REFERENCE_CAPS "timestamp/x-echo-trace"
+#define DRAIN_TIMEOUT_SECONDS 60
+#define DRAIN_RETRY_AFTER_SECONDS "1"
+#define HANDOFF_ACK_TIMEOUT_SECONDS 5
+#define HANDOFF_ACK 'A'
+#define PIPELINE_POOL_SIZE 4
+#define OFFER_LATENCY_SAMPLES 1024
+#define SESSION_SWEEP_INTERVAL_SECONDS 1
+#define SESSION_CONNECT_TIMEOUT_SECONDS 30
+#define SESSION_DISCONNECTED_GRACE_SECONDS 10
+#define SESSION_LIMIT_RETRY_AFTER_SECONDS "5"
+#define BENCHMARK_FRAMES 300
+
+struct offer_request;
+struct encoder_profile;
 
 static void on_http_request_cb(struct evhttp_request* req, void* arg);
+static void on_whip_request_cb(struct evhttp_request* req, void* arg);
+static void on_whip_resource_request_cb(struct evhttp_request* req, void* arg);
+static void answer_offer(struct evhttp_request* req, GstElement* webrtcbin, const gchar* sdp_offer_str,
+  gsize sdp_offer_len, gboolean is_whip, gint64 start_time);
+static char* extract_json_string(char* json, size_t json_len, const char* key, size_t* value_len);
+static void add_json_string(struct evbuffer* buffer, const char* str);
+static void stop_pipeline(GstElement* webrtcbin);
+static void register_session(GstElement* webrtcbin);
+static gboolean is_at_session_limit();
+static void on_session_timer(evutil_socket_t fd, short events, void* arg);
+static void stop_all_sessions();
+static gint64 read_process_status(const char* field);
+static gboolean claim_pipeline_stop(GstElement* webrtcbin);
+static void free_whip_resource(gpointer data);
 static GstElement* create_webrtc();
+static GstElement* build_webrtc();
+static void destroy_webrtc(GstElement* webrtcbin);
+static void schedule_pipeline_pool_refill();
+static gboolean refill_pipeline_pool(gpointer user_data);
+static void record_offer_latency(gint64 start_time);
+static void on_stats_request_cb(struct evhttp_request* req, void* arg);
+static void trace_pipeline(GstElement* pipeline);
+static GstPadProbeReturn on_trace_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data);
+static void on_trace_queue_overrun(GstElement* queue, gpointer user_data);
+static cJSON* create_trace_json();
+static void on_trace_dump_timer(evutil_socket_t fd, short events, void* arg);
+static gboolean parse_encoder_profile(const char* spec, struct encoder_profile* profile);
+static gchar* build_encoder(const struct encoder_profile* profile);
+static gchar* build_encoder_launch(const struct encoder_profile* profile);
+static const char* get_encoder_payloader(const struct encoder_profile* profile);
+static const char* get_encoder_caps(const struct encoder_profile* profile);
+static const char* get_encoder_rtp_caps(const struct encoder_profile* profile);
+static int run_encoder_benchmark(const struct encoder_profile* profiles, gsize count);
+static gboolean start_broadcast();
+static GstFlowReturn on_broadcast_sample(GstAppSink* appsink, gpointer user_data);
+static void add_broadcast_peer(GstElement* webrtcbin);
+static void remove_broadcast_peer(GstElement* webrtcbin);
+static void request_broadcast_keyframe(gint layer);
+static void request_broadcast_peer_keyframe(GstElement* webrtcbin);
+static void free_broadcast_peer(gpointer data);
+static void on_simulcast_timer(evutil_socket_t fd, short events, void* arg);
+static void on_simulcast_stats(GstPromise* promise, gpointer user_data);
 static void on_negotiation_needed (GstElement* element, gpointer user_data);
 static void send_ice_candidate_message (GstElement* webrtc G_GNUC_UNUSED, guint mlineindex, gchar* candidate, gpointer user_data G_GNUC_UNUSED);
 static void on_new_transceiver (GstElement* object, GstWebRTCRTPTransceiver* candidate, gpointer udata);
+static void on_incoming_pad (GstElement* webrtcbin, GstPad* pad, gpointer user_data);
 static void on_ice_gathering_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data);
 static void on_ice_connection_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data);
 static void on_connection_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data);
 static void on_offer_set (GstPromise* promise, gpointer user_data);
 static void on_answer_created (GstPromise* promise, gpointer user_data);
-static void set_offer(GstElement* webrtc, const gchar* sdp_offer_str);
+static void on_local_description_set (GstPromise* promise, gpointer user_data);
+static void queue_offer_completion(struct offer_request* offer);
+static void on_offer_completions(evutil_socket_t fd, short events, void* arg);
+static void on_offer_connection_closed(struct evhttp_connection* evcon, void* arg);
+static void complete_offer(struct offer_request* offer);
+static void send_offer_answer(struct offer_request* offer);
+static void send_whip_answer(struct offer_request* offer);
 static gboolean bus_call (GstBus* bus, GstMessage* msg, gpointer data);
+static void on_term_signal(evutil_socket_t sig, short events, void* arg);
+static void on_drain_timer(evutil_socket_t fd, short events, void* arg);
+static void on_handoff_request(evutil_socket_t fd, short events, void* arg);
+static void begin_drain(struct event_base* base);
+static struct evhttp_bound_socket* receive_listen_socket(const char* handoff_path, struct evhttp* http_svr);
+static evutil_socket_t create_handoff_socket(const char* handoff_path);
+static int send_listen_socket(evutil_socket_t handoff_socket, evutil_socket_t listen_socket);
+
+static struct evhttp* _http_svr = NULL;
+static struct evhttp_bound_socket* _bound_socket = NULL;
+static struct event* _drain_timer = NULL;
+static struct event* _handoff_event = NULL;
+static int _drain_timeout_seconds = DRAIN_TIMEOUT_SECONDS;
+static gint64 _drain_deadline = 0;
+static volatile gint _is_draining = 0;
+/* Pipelines created and not yet torn down, updated from GStreamer threads. */
+static volatile gint _active_pipelines = 0;
+
+/* A WHIP session's pipeline and ETag, keyed by its resource id. Only used on the libevent thread. */
+struct whip_resource {
+  GstElement* webrtcbin;
+  gchar* etag;
+};
+
+static GHashTable* _whip_resources = NULL;
+
+/* A running pipeline and the last connection state its webrtcbin reported. */
+struct session {
+  GstElement* webrtcbin;
+  GstWebRTCPeerConnectionState connection_state;
+  gint64 created_at;
+  gint64 state_changed_at;
+};
+
+/* Every session keyed by its webrtcbin. Connection states are updated from
+* the webrtcbins' threads, sessions are only added and removed on the libevent thread. */
+static GMutex _sessions_mutex;
+static GHashTable* _sessions = NULL;
+static struct event* _session_timer = NULL;
+static gint _max_sessions = 0;
+static gint _session_timeout_seconds = SESSION_CONNECT_TIMEOUT_SECONDS;
+static volatile gint _sessions_rejected = 0;
+static volatile gint _sessions_timed_out = 0;
+static volatile gint _sessions_ended = 0;
+
+/* An offer whose HTTP request is parked until the webrtcbin has produced its answer. */
+struct offer_request {
+  struct evhttp_request* req;  /* NULL once the client has gone. */
+  GstElement* webrtcbin;
+  gboolean is_whip;
+  gint64 start_time;
+  gchar* answer_sdp;           /* NULL if the offer couldn't be answered. */
+};
+
+/* Finished offer_requests on their way back to the libevent thread, which is
+* woken by a byte written to the notify socket pair. */
+static GAsyncQueue* _offer_completions = NULL;
+static evutil_socket_t _offer_completion_notify[2] = { -1, -1 };
+
+/* webrtcbins whose pipelines are built and parked in READY, waiting for an offer. */
+static GAsyncQueue* _pipeline_pool = NULL;
+static gint _pipeline_pool_size = PIPELINE_POOL_SIZE;
+static volatile gint _pipeline_pool_refilling = 0;
+static volatile gint _pipeline_pool_hits = 0;
+static volatile gint _pipeline_pool_misses = 0;
+
+/* Ring of the most recent offer to answer times in microseconds. */
+static GMutex _offer_latency_mutex;
+static gint64 _offer_latencies[OFFER_LATENCY_SAMPLES];
+static guint64 _offer_latency_count = 0;
+
+/* A peer fed by the broadcast pipeline and the layer it's sent. */
+struct broadcast_peer {
+  GstElement* webrtcbin;
+  GstElement* appsrc;
+  gint layer;                  /* -1 until the first keyframe of the target layer. */
+  gint target_layer;
+  gint64 low_loss_since;       /* Start of the current run of low loss reports, or the last layer switch. */
+};
+
+/* A simulcast layer's size and bitrate in kbps, smallest first. */
+struct simulcast_layer {
+  gint width;
+  gint height;
+  gint bitrate;
+};
+
+static const struct simulcast_layer _simulcast_layers[SIMULCAST_LAYERS] = {
+  { 320, 180, 150 },
+  { 640, 360, 500 },
+  { 1280, 720, 1500 },
+};
+
+/* The shared source and encoder pipeline, an appsink per layer and the peers it feeds, for --broadcast. */
+static gboolean _is_broadcast = FALSE;
+static gboolean _is_simulcast = FALSE;
+static GstElement* _broadcast_pipeline = NULL;
+static GstElement* _broadcast_sinks[SIMULCAST_LAYERS] = { NULL };
+static gint _broadcast_layer_count = 0;
+static GMutex _broadcast_mutex;
+static GPtrArray* _broadcast_peers = NULL;
+
+/* Send each peer's own video back to it rather than the test source, for --echo. */
+static gboolean _is_echo = FALSE;
+
+/* Latency, queue level and overrun totals for one element boundary, e.g.
+* "queue ! vp8enc", across every pipeline. Latencies are from the buffer
+* leaving its source, in microseconds. */
+struct trace_boundary {
+  gchar* name;
+  gboolean is_queue;
+  guint64 samples;
+  gint64 latency_sum;
+  gint64 latency_max;
+  guint64 queue_level_sum;
+  guint queue_level_max;
+  guint64 overruns;
+};
+
+/* The boundary a probe feeds and, for a source's pad, how many buffers it has seen. */
+struct trace_probe {
+  struct trace_boundary* boundary;
+  GstElement* queue;           /* The upstream element if it's a queue. */
+  gboolean is_source;
+  guint count;
+};
+
+/* How the test source is encoded. -1 leaves a setting at the encoder's default. */
+struct encoder_profile {
+  const char* name;
+  const char* codec;           /* The RTP encoding name, VP8, VP9 or H264. */
+  gint threads;
+  gint token_partitions;       /* VP8 only, log2 of the number of partitions. */
+  gint cpu_used;               /* libvpx's speed, or openh264's complexity (0 to 2) for H.264. */
+  gint keyframe_interval;      /* In frames. */
+  gint target_bitrate;         /* In kbps. */
+};
+
+/* The first profile is the default, it's the encoder the server has always used. */
+static const struct encoder_profile _encoder_profiles[] = {
+  { "vp8", "VP8", -1, -1, -1, -1, -1 },
+  { "vp8-fast", "VP8", 2, 1, 8, 300, 1000 },
+  { "vp8-hd", "VP8", 4, 2, 4, 300, 2500 },
+  { "vp9", "VP9", 2, -1, 8, 300, 1000 },
+  { "h264", "H264", 2, -1, 0, 300, 1500 },
+};
+
+static struct encoder_profile _encoder_profile;
+static gchar* _encoder_launch = NULL;
+
+/* Tracing is off, and no probes added, while the sample interval is 0. */
+static gint _trace_sample_interval = 0;
+static gint _trace_dump_seconds = TRACE_DUMP_INTERVAL_SECONDS;
+static GstCaps* _trace_caps = NULL;
+static GMutex _trace_mutex;
+static GPtrArray* _trace_boundaries = NULL;
+
+/* Print every offer and answer SDP in full, for --verbose. */
+static gboolean _is_verbose = FALSE;
 
 int main(int argc, char* argv[])
 {
@@ -66,7 +375,20 @@ int main(int argc, char* argv[])
   GThread* main_loop_thread;
   struct event_base* base = NULL;
   struct evhttp* httpSvr = NULL;
+  struct event* term_event = NULL;
+  struct event* completion_event = NULL;
+  struct timeval session_interval = { SESSION_SWEEP_INTERVAL_SECONDS, 0 };
+  struct timeval trace_dump_interval = { 0, 0 };
+  struct event* trace_dump_event = NULL;
+  struct timeval simulcast_interval = { SIMULCAST_STATS_INTERVAL_SECONDS, 0 };
+  struct event* simulcast_event = NULL;
+  const char* handoff_path = NULL;
+  evutil_socket_t handoff_socket = -1;
+  GstElement* pooled;
+  gboolean is_benchmark = FALSE;
+  gboolean has_encoder = FALSE;
   int res = 0;
+  int i;
 
 #ifdef _WIN32
   {
@@ -81,6 +403,88 @@ int main(int argc, char* argv[])
   /* Initialise GStreamer. */
   gst_init (&argc, &argv);
 
+  _encoder_profile = _encoder_profiles[0];
+
+  /* gst_init has already removed its own options. */
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--handoff") == 0 && i + 1 < argc) {
+      handoff_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--drain-timeout") == 0 && i + 1 < argc) {
+      _drain_timeout_seconds = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--pool-size") == 0 && i + 1 < argc) {
+      _pipeline_pool_size = MAX(atoi(argv[++i]), 0);
+    }
+    else if (strcmp(argv[i], "--broadcast") == 0) {
+      _is_broadcast = TRUE;
+    }
+    else if (strcmp(argv[i], "--simulcast") == 0) {
+      _is_broadcast = TRUE;
+      _is_simulcast = TRUE;
+    }
+    else if (strcmp(argv[i], "--echo") == 0) {
+      _is_echo = TRUE;
+    }
+    else if (strcmp(argv[i], "--encoder") == 0 && i + 1 < argc) {
+      if (!parse_encoder_profile(argv[++i], &_encoder_profile)) {
+        fprintf(stderr, "Invalid encoder profile %s.\n", argv[i]);
+        return -1;
+      }
+      has_encoder = TRUE;
+    }
+    else if (strcmp(argv[i], "--benchmark") == 0) {
+      is_benchmark = TRUE;
+    }
+    else if (strcmp(argv[i], "--trace-sample") == 0 && i + 1 < argc) {
+      _trace_sample_interval = MAX(atoi(argv[++i]), 0);
+    }
+    else if (strcmp(argv[i], "--trace-dump") == 0 && i + 1 < argc) {
+      _trace_dump_seconds = MAX(atoi(argv[++i]), 0);
+    }
+    else if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+      _max_sessions = MAX(atoi(argv[++i]), 0);
+    }
+    else if (strcmp(argv[i], "--session-timeout") == 0 && i + 1 < argc) {
+      _session_timeout_seconds = MAX(atoi(argv[++i]), 0);
+    }
+    else if (strcmp(argv[i], "--verbose") == 0) {
+      _is_verbose = TRUE;
+    }
+    else {
+      fprintf(stderr, "Unrecognised option %s, options are --handoff PATH, --drain-timeout SECONDS, --pool-size N, "
+        "--broadcast, --simulcast, --echo, --encoder PROFILE[,SETTING=VALUE...], --benchmark, --trace-sample N, --trace-dump SECONDS, "
+        "--max-sessions N, --session-timeout SECONDS and --verbose.\n", argv[i]);
+      return -1;
+    }
+  }
+
+  if (_is_broadcast && _is_echo) {
+    fprintf(stderr, "--broadcast or --simulcast and --echo can't be used together.\n");
+    return -1;
+  }
+
+  if (is_benchmark) {
+    /* Just the chosen profile if there is one, otherwise all of them. */
+    return has_encoder ? run_encoder_benchmark(&_encoder_profile, 1) :
+      run_encoder_benchmark(_encoder_profiles, G_N_ELEMENTS(_encoder_profiles));
+  }
+
+  /* Peers that join a broadcast need a keyframe to start from before long. */
+  if (_is_broadcast && _encoder_profile.keyframe_interval < 0) {
+    _encoder_profile.keyframe_interval = BROADCAST_KEYFRAME_MAX_DIST;
+  }
+
+  _encoder_launch = build_encoder_launch(&_encoder_profile);
+  if (!_is_echo) {
+    printf("Encoding with %s.\n", _encoder_launch);
+  }
+
+  if (_trace_sample_interval > 0) {
+    _trace_caps = gst_caps_new_empty_simple(TRACE_REFERENCE_CAPS);
+    _trace_boundaries = g_ptr_array_new();
+  }
+
   gst_main_loop = g_main_loop_new(NULL, FALSE);
   main_loop_thread = g_thread_new("main_loop", (GThreadFunc)g_main_loop_run, gst_main_loop);
   if (main_loop_thread == NULL) {
@@ -88,6 +492,16 @@ int main(int argc, char* argv[])
     return -1;
   }
 
+  if (_is_broadcast && !start_broadcast()) {
+    fprintf(stderr, "Failed to start the broadcast pipeline.\n");
+    return -1;
+  }
+
+  _sessions = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+  _pipeline_pool = g_async_queue_new();
+  schedule_pipeline_pool_refill();
+
   /* Initialise libevent HTTP server. */
   base = event_base_new();
   if (!base) {
@@ -101,26 +515,127 @@ int main(int argc, char* argv[])
     return -1;
   }
 
-  res = evhttp_bind_socket(httpSvr, HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT);
+  _http_svr = httpSvr;
+
+#ifdef _WIN32
+  res = evutil_socketpair(AF_INET, SOCK_STREAM, 0, _offer_completion_notify);
+#else
+  res = evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, _offer_completion_notify);
+#endif
   if (res != 0) {
-    fprintf(stderr, "Failed to start HTTP server on %s:%d.\n", HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT);
-    return res;
+    fprintf(stderr, "Failed to create the offer completion socket pair.\n");
+    return -1;
+  }
+
+  evutil_make_socket_nonblocking(_offer_completion_notify[0]);
+  evutil_make_socket_nonblocking(_offer_completion_notify[1]);
+
+  _offer_completions = g_async_queue_new();
+  completion_event = event_new(base, _offer_completion_notify[0], EV_READ | EV_PERSIST, on_offer_completions, NULL);
+  event_add(completion_event, NULL);
+
+  if (handoff_path != NULL) {
+    _bound_socket = receive_listen_socket(handoff_path, httpSvr);
+    if (_bound_socket != NULL) {
+      printf("Took over the listening socket from the server running at %s.\n", handoff_path);
+    }
+  }
+
+  if (_bound_socket == NULL) {
+    _bound_socket = evhttp_bind_socket_with_handle(httpSvr, HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT);
+    if (_bound_socket == NULL) {
+      fprintf(stderr, "Failed to start HTTP server on %s:%d.\n", HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT);
+      return -1;
+    }
+  }
+
+  if (handoff_path != NULL) {
+    handoff_socket = create_handoff_socket(handoff_path);
+    if (handoff_socket >= 0) {
+      _handoff_event = event_new(base, handoff_socket, EV_READ | EV_PERSIST, on_handoff_request, base);
+      event_add(_handoff_event, NULL);
+    }
+  }
+
+  term_event = evsignal_new(base, SIGTERM, on_term_signal, base);
+  if (!term_event || event_add(term_event, NULL) < 0) {
+    fprintf(stderr, "Failed to add SIGTERM event handler.\n");
+  }
+
+  _drain_timer = event_new(base, -1, EV_PERSIST, on_drain_timer, base);
+
+  _session_timer = event_new(base, -1, EV_PERSIST, on_session_timer, NULL);
+  event_add(_session_timer, &session_interval);
+
+  if (_is_simulcast) {
+    simulcast_event = event_new(base, -1, EV_PERSIST, on_simulcast_timer, NULL);
+    event_add(simulcast_event, &simulcast_interval);
+  }
+
+  if (_trace_sample_interval > 0 && _trace_dump_seconds > 0) {
+    trace_dump_interval.tv_sec = _trace_dump_seconds;
+    trace_dump_event = event_new(base, -1, EV_PERSIST, on_trace_dump_timer, NULL);
+    event_add(trace_dump_event, &trace_dump_interval);
   }
 
   evhttp_set_allowed_methods(httpSvr,
     EVHTTP_REQ_GET |
     EVHTTP_REQ_POST |
+    EVHTTP_REQ_PATCH |
+    EVHTTP_REQ_DELETE |
     EVHTTP_REQ_OPTIONS);
 
   printf("Waiting for SDP offer on http://%s:%d%s...\n", HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT, HTTP_OFFER_URL);
+  printf("Waiting for WHIP offer on http://%s:%d%s...\n", HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT, HTTP_WHIP_URL);
+
+  _whip_resources = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_whip_resource);
 
   res = evhttp_set_cb(httpSvr, HTTP_OFFER_URL, on_http_request_cb, NULL);
+  res = evhttp_set_cb(httpSvr, HTTP_WHIP_URL, on_whip_request_cb, NULL);
+  res = evhttp_set_cb(httpSvr, HTTP_STATS_URL, on_stats_request_cb, NULL);
+
+  /* WHIP resource URLs carry the session id so they can't have a fixed callback. */
+  evhttp_set_gencb(httpSvr, on_whip_resource_request_cb, NULL);
 
   event_base_dispatch(base);
 
   g_main_loop_unref (gst_main_loop);
 
   evhttp_free(httpSvr);
+  event_free(_session_timer);
+  if (trace_dump_event != NULL) {
+    event_free(trace_dump_event);
+  }
+  if (simulcast_event != NULL) {
+    event_free(simulcast_event);
+  }
+  stop_all_sessions();
+  g_hash_table_destroy(_sessions);
+  g_hash_table_destroy(_whip_resources);
+
+  while ((pooled = g_async_queue_try_pop(_pipeline_pool)) != NULL) {
+    destroy_webrtc(pooled);
+  }
+  g_async_queue_unref(_pipeline_pool);
+
+  if (_broadcast_pipeline != NULL) {
+    gst_element_set_state(_broadcast_pipeline, GST_STATE_NULL);
+    for (i = 0; i < _broadcast_layer_count; i++) {
+      gst_object_unref(_broadcast_sinks[i]);
+    }
+    gst_object_unref(_broadcast_pipeline);
+    g_ptr_array_unref(_broadcast_peers);
+  }
+
+  if (handoff_socket >= 0) {
+    evutil_closesocket(handoff_socket);
+#ifndef _WIN32
+    /* Once handed off the path belongs to the replacement server. */
+    if (_bound_socket != NULL) {
+      unlink(handoff_path);
+    }
+#endif
+  }
 
 #ifdef _WIN32
   WSACleanup();
@@ -141,21 +656,11 @@ static void on_http_request_cb(struct evhttp_request* req, void* arg)
   const char* uri = evhttp_request_get_uri(req);
   struct evbuffer* http_req_body;
   size_t http_req_body_len;
-  unsigned char* http_req_buffer;
-  const cJSON* sdp_init_offer_json = NULL;
-  const cJSON* sdp_json = NULL;
-  cJSON* sdp_json_answer;
-  cJSON* sdp_json_answer_type;
-  cJSON* sdp_json_answer_sdp;
-  char* json_response;
+  char* sdp_offer;
+  size_t sdp_offer_len = 0;
   struct evbuffer* resp_buffer;
-  size_t response_length;
-  int resp_lock = 0;
   GstElement* webrtcbin;
-  GstPromise* create_answer_promise;
-  const GstStructure* answer_reply;
-  GstWebRTCSessionDescription* answer;
-  gchar* answer_sdp_text;
+  gint64 start_time = g_get_monotonic_time();
 
   printf("Received HTTP request for %s.\n", uri);
 
@@ -165,11 +670,25 @@ static void on_http_request_cb(struct evhttp_request* req, void* arg)
     evhttp_add_header(req->output_headers, "Access-Control-Allow-Headers", "content-type");
     evhttp_send_reply(req, 200, "OK", NULL);
   }
+  else if (g_atomic_int_get(&_is_draining)) {
+    /* Closing the connection sends the retry to whichever server now owns the listening socket. */
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+    evhttp_add_header(req->output_headers, "Retry-After", DRAIN_RETRY_AFTER_SECONDS);
+    evhttp_add_header(req->output_headers, "Connection", "close");
+    evhttp_send_reply(req, 503, "Service Unavailable", NULL);
+  }
+  else if (is_at_session_limit()) {
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+    evhttp_add_header(req->output_headers, "Retry-After", SESSION_LIMIT_RETRY_AFTER_SECONDS);
+    evhttp_send_reply(req, 503, "Service Unavailable", NULL);
+  }
   else {
 
     resp_buffer = evbuffer_new();
     if (!resp_buffer) {
       fprintf(stderr, "Failed to create HTTP response buffer.\n");
+      evhttp_send_error(req, 500, "Internal Server Error");
+      return;
     }
 
     if (!evbuffer_enable_locking(resp_buffer, NULL)) {
@@ -182,68 +701,25 @@ static void on_http_request_cb(struct evhttp_request* req, void* arg)
     http_req_body_len = evbuffer_get_length(http_req_body);
 
     if (http_req_body_len > 0) {
-      http_req_buffer = calloc(http_req_body_len + 1, sizeof(char));
-
-      evbuffer_copyout(http_req_body, http_req_buffer, http_req_body_len);
-
       printf("HTTP request body length %zu.\n", http_req_body_len);
 
-      //printf("Body: %s\n", sdp_buffer);
-
-      sdp_init_offer_json = cJSON_Parse(http_req_buffer);
-
-      printf("sdp offer: %s\n", cJSON_Print(sdp_init_offer_json));
-
-      sdp_json = cJSON_GetObjectItemCaseSensitive(sdp_init_offer_json, "sdp");
+      /* The SDP is unescaped in place in the request's own buffer, nothing is copied or allocated. */
+      sdp_offer = extract_json_string((char*)evbuffer_pullup(http_req_body, -1), http_req_body_len, "sdp", &sdp_offer_len);
 
-      if (cJSON_IsString(sdp_json) && (sdp_json->valuestring != NULL)) {
+      if (sdp_offer != NULL) {
+        if (_is_verbose) {
+          printf("sdp offer: %.*s\n", (int)sdp_offer_len, sdp_offer);
+        }
+        else {
+          printf("SDP offer length %zu.\n", sdp_offer_len);
+        }
 
         webrtcbin = create_webrtc();
 
         if (webrtcbin != NULL) {
 
-          set_offer(webrtcbin, sdp_json->valuestring);
-
-          create_answer_promise = gst_promise_new();
-          g_signal_emit_by_name(webrtcbin, "create-answer", NULL, create_answer_promise);
-
-          if (gst_promise_wait(create_answer_promise) == GST_PROMISE_RESULT_REPLIED) {
-
-            printf("create-answer promise wait over.\n");
-
-            answer_reply = gst_promise_get_reply (create_answer_promise);
-
-            gst_structure_get (answer_reply, "answer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer, NULL);
-            gst_promise_unref (create_answer_promise);
-
-            if (answer != NULL) {
-
-              answer_sdp_text = gst_sdp_message_as_text(answer->sdp);
-              gst_webrtc_session_description_free (answer);
-
-              sdp_json_answer = cJSON_CreateObject();
-              sdp_json_answer_type = cJSON_CreateString("answer");
-              cJSON_AddItemToObject(sdp_json_answer, "type", sdp_json_answer_type);
-              sdp_json_answer_sdp = cJSON_CreateString(answer_sdp_text);
-              cJSON_AddItemToObject(sdp_json_answer, "sdp", sdp_json_answer_sdp);
-              json_response = cJSON_Print(sdp_json_answer);
-
-              printf("Return SDP answer to client: %s.\n", json_response);
-
-              response_length = strlen(json_response);
-              evhttp_add_header(req->output_headers, "Content-type", "application/json");
-              evbuffer_add(resp_buffer, json_response, response_length);
-              evhttp_send_reply(req, 200, "OK", resp_buffer);
-            }
-            else {
-              evbuffer_add_printf(resp_buffer, "Failed to get webrtc SDP answer.");
-              evhttp_send_reply(req, 501, "Internal Server Error", resp_buffer);
-            }
-          }
-          else {
-            evbuffer_add_printf(resp_buffer, "Timed out waiting for webrtc SDP answer.");
-            evhttp_send_reply(req, 501, "Internal Server Error", resp_buffer);
-          }
+          /* The reply is sent by send_offer_answer once the answer is ready. */
+          answer_offer(req, webrtcbin, sdp_offer, sdp_offer_len, FALSE, start_time);
         }
         else {
           evbuffer_add_printf(resp_buffer, "Failed to initialise webrtc peer connection.");
@@ -259,34 +735,105 @@ static void on_http_request_cb(struct evhttp_request* req, void* arg)
       evbuffer_add_printf(resp_buffer, "Request was missing the SDP offer.");
       evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
     }
+
+    evbuffer_free(resp_buffer);
   }
 }
 
 /**
-* Attempts to create the gstreamer WebRTC pipeline. Signal handlers
-* for important events are attached to the WebRTC object and will be
-* responsible for progressing the WebRTC connection subsequent to its
-* creation.
+* Gets a gstreamer WebRTC pipeline for a new offer and sets it playing. A
+* pipeline from the pool is used if there is one, otherwise one is built on
+* the spot. Either way the pool is topped up again in the background.
 * @@Returns a new WebRTC object.
 */
 static GstElement* create_webrtc()
+{
+  GstElement* webrtcbin;
+  GstStateChangeReturn ret;
+
+  webrtcbin = g_async_queue_try_pop(_pipeline_pool);
+
+  if (webrtcbin != NULL) {
+    g_atomic_int_inc(&_pipeline_pool_hits);
+  }
+  else {
+    g_atomic_int_inc(&_pipeline_pool_misses);
+    webrtcbin = build_webrtc();
+    if (webrtcbin == NULL) {
+      return NULL;
+    }
+  }
+
+  schedule_pipeline_pool_refill();
+
+  /* Start playing */
+  ret = gst_element_set_state (GST_ELEMENT (GST_ELEMENT_PARENT (webrtcbin)), GST_STATE_PLAYING);
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    g_printerr("Unable to set the pipeline to the playing state.\n");
+    destroy_webrtc(webrtcbin);
+    return NULL;
+  }
+
+  g_atomic_int_inc(&_active_pipelines);
+  register_session(webrtcbin);
+
+  if (_is_broadcast) {
+    add_broadcast_peer(webrtcbin);
+  }
+
+  return webrtcbin;
+}
+
+/**
+* Builds a gstreamer WebRTC pipeline and takes it to the READY state. Signal
+* handlers for important events are attached to the WebRTC object and will be
+* responsible for progressing the WebRTC connection once it's been handed an
+* offer.
+* @@Returns a new WebRTC object, or NULL if the pipeline couldn't be built.
+*/
+static GstElement* build_webrtc()
 {
   GstElement* pipeline, * webrtcbin;
   GstBus* bus;
   GstStateChangeReturn ret;
   GError* error = NULL;
-
-  pipeline =
-     gst_parse_launch ("webrtcbin bundle-policy=max-bundle name=sendonly "
-       "videotestsrc is-live=true pattern=ball ! videoconvert ! queue ! vp8enc deadline=1 ! rtpvp8pay ! "
-       "queue ! " RTP_CAPS_VP8 " ! sendonly. "
-       , &error);
-
-  //pipeline =
-  //  gst_parse_launch ("webrtcbin bundle-policy=max-bundle name=sendonly "
-  //    "videotestsrc is-live=true pattern=ball ! videoconvert ! queue ! openh264enc ! rtph264pay ! "
-  //    "queue ! " RTP_CAPS_H264 " ! sendonly. "
-  //    , &error);
+  gchar* launch;
+
+  if (_is_simulcast) {
+    /* Frames from whichever layer the peer is on. Payloading them here keeps
+    * the peer's sequence numbers and timestamps running across a layer switch. */
+    launch = g_strdup_printf ("webrtcbin bundle-policy=max-bundle name=sendonly "
+      "appsrc name=broadcastin is-live=true format=time do-timestamp=true caps=\"%s\" ! "
+      "queue leaky=downstream max-size-bytes=0 max-size-time=0 max-size-buffers=" G_STRINGIFY(SIMULCAST_PEER_QUEUE_FRAMES) " ! "
+      "%s ! %s ! sendonly. ", get_encoder_caps(&_encoder_profile), get_encoder_payloader(&_encoder_profile),
+      get_encoder_rtp_caps(&_encoder_profile));
+    pipeline = gst_parse_launch (launch, &error);
+    g_free (launch);
+  }
+  else if (_is_broadcast) {
+    /* RTP from the shared encoder, a slow peer drops packets rather than holding the others up. */
+    launch = g_strdup_printf ("webrtcbin bundle-policy=max-bundle name=sendonly "
+      "appsrc name=broadcastin is-live=true format=time do-timestamp=true caps=\"%s" RTP_CAPS_CLOCK_RATE "\" ! "
+      "queue leaky=downstream max-size-bytes=0 max-size-time=0 max-size-buffers=" G_STRINGIFY(BROADCAST_PEER_QUEUE_BUFFERS) " ! "
+      "sendonly. ", get_encoder_rtp_caps(&_encoder_profile));
+    pipeline = gst_parse_launch (launch, &error);
+    g_free (launch);
+  }
+  else if (_is_echo) {
+    /* The depayloader is linked to webrtcbin's incoming pad by on_incoming_pad.
+    * Without a queue the echo runs on the jitterbuffer's thread, a peer adds no threads. */
+    pipeline =
+      gst_parse_launch ("webrtcbin bundle-policy=max-bundle latency=" G_STRINGIFY(ECHO_JITTERBUFFER_LATENCY_MS) " name=sendonly "
+        "rtpvp8depay name=echodepay ! rtpvp8pay ! " RTP_CAPS_VP8 " ! sendonly. "
+        , &error);
+  }
+  else {
+    launch = g_strdup_printf ("webrtcbin bundle-policy=max-bundle name=sendonly "
+      "videotestsrc is-live=true pattern=ball ! videoconvert ! queue ! %s ! "
+      "queue ! %s ! sendonly. ", _encoder_launch, get_encoder_rtp_caps(&_encoder_profile));
+    pipeline = gst_parse_launch (launch, &error);
+    g_free (launch);
+  }
 
   if (error) {
     gst_printerr ("Failed to parse launch: %s\n", error->message);
@@ -309,6 +856,10 @@ static GstElement* create_webrtc()
   webrtcbin = gst_bin_get_by_name (GST_BIN (pipeline), "sendonly");
   g_assert_nonnull (webrtcbin);
 
+  if (_trace_sample_interval > 0) {
+    trace_pipeline (pipeline);
+  }
+
   g_signal_connect (webrtcbin, "on-negotiation-needed", G_CALLBACK (on_negotiation_needed), NULL);
   g_signal_connect (webrtcbin, "on-ice-candidate", G_CALLBACK (send_ice_candidate_message), NULL);
   g_signal_connect (webrtcbin, "on-new-transceiver", G_CALLBACK (on_new_transceiver), NULL);
@@ -316,11 +867,16 @@ static GstElement* create_webrtc()
   g_signal_connect (webrtcbin, "notify::ice-gathering-state", G_CALLBACK (on_ice_gathering_state_notify), NULL);
   g_signal_connect (webrtcbin, "notify::ice-connection-state", G_CALLBACK (on_ice_connection_state_notify), NULL);
   g_signal_connect (webrtcbin, "notify::connection-state", G_CALLBACK (on_connection_state_notify), NULL);
-  
-  /* Start playing */
-  ret = gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  if (_is_echo) {
+    g_signal_connect (webrtcbin, "pad-added", G_CALLBACK (on_incoming_pad), NULL);
+  }
+
+  /* Elements are created, linked and opened here, off the offer's critical path. */
+  ret = gst_element_set_state (pipeline, GST_STATE_READY);
   if (ret == GST_STATE_CHANGE_FAILURE) {
-    g_printerr("Unable to set the pipeline to the playing state.\n");
+    g_printerr("Unable to set the pipeline to the ready state.\n");
+    gst_object_unref(webrtcbin);
     gst_object_unref(pipeline);
     return NULL;
   }
@@ -333,166 +889,2365 @@ static GstElement* create_webrtc()
 }
 
 /**
-* 
-* @param[in] webrtc: the HTTP request received from the remote client.
-* @param[in] sdp_offer_str: not used.
+* Shuts down a pipeline and releases everything it holds, the bus watch, the
+* elements and their threads. Used by stop_pipeline for sessions and directly
+* for pooled pipelines at exit and ones that fail to start.
 */
-static void set_offer(GstElement* webrtc, const gchar* sdp_offer_str)
+static void destroy_webrtc(GstElement* webrtcbin)
 {
-  GstWebRTCSessionDescription* offer = NULL;
-  GstPromise* promise;
-  GstSDPMessage* sdp;
-  int ret;
+  GstElement* pipeline = GST_ELEMENT(gst_element_get_parent(webrtcbin));
+  GstBus* bus = gst_element_get_bus(pipeline);
 
-  printf("set_offer.\n");
+  remove_broadcast_peer(webrtcbin);
 
-  ret = gst_sdp_message_new (&sdp);
-  g_assert_cmphex (ret, == , GST_SDP_OK);
-  ret = gst_sdp_message_parse_buffer (sdp_offer_str, (guint)strlen (sdp_offer_str), sdp);
-  g_assert_cmphex (ret, == , GST_SDP_OK);
+  gst_bus_remove_watch(bus);
+  gst_object_unref(bus);
 
-  offer = gst_webrtc_session_description_new (GST_WEBRTC_SDP_TYPE_OFFER, sdp);
-  g_assert_nonnull (offer);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
 
-  /* Set remote description on our pipeline */
-  promise = gst_promise_new_with_change_func (on_offer_set, webrtc, NULL);
-  g_signal_emit_by_name (webrtc, "set-remote-description", offer, promise);
+  /* Releases the references from gst_parse_launch and build_webrtc as well as get_parent. */
+  gst_object_unref(pipeline);
+  gst_object_unref(pipeline);
+  gst_object_unref(webrtcbin);
 }
 
-static void on_offer_set (GstPromise* promise, gpointer webrtc)
+/**
+* Starts topping up the pipeline pool on the GStreamer main loop unless a
+* refill is already running. Safe to call from any thread.
+*/
+static void schedule_pipeline_pool_refill()
 {
-  const GstStructure* reply;
-  const GstPromise* answer_promise;
-
-  printf("on_offer_set.\n");
-
-  reply = gst_promise_get_reply (promise);
-  gst_promise_unref (promise);
-
-  answer_promise = gst_promise_new_with_change_func (on_answer_created, webrtc, NULL);
-  g_signal_emit_by_name (webrtc, "create-answer", NULL, answer_promise);
+  if (g_async_queue_length(_pipeline_pool) < _pipeline_pool_size &&
+    g_atomic_int_compare_and_exchange(&_pipeline_pool_refilling, 0, 1)) {
+    g_idle_add(refill_pipeline_pool, NULL);
+  }
 }
 
-/* Answer created by our pipeline, to be sent to the peer */
-static void on_answer_created (GstPromise* promise, gpointer webrtc)
+/**
+* Idle callback that builds one pipeline at a time, so bus messages for the
+* live sessions aren't held up, until the pool is full.
+*/
+static gboolean refill_pipeline_pool(gpointer user_data)
 {
-  GstWebRTCSessionDescription* answer;
-  const GstStructure* reply;
-  const gchar* answer_sdp_text = NULL;
-  GstPromise* set_local_promise;
-
-  printf("on_answer_created.\n");
+  GstElement* webrtcbin;
 
-  g_assert_cmphex (gst_promise_wait (promise), == , GST_PROMISE_RESULT_REPLIED);
-  reply = gst_promise_get_reply (promise);
-  gst_structure_get (reply, "answer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer, NULL);
-  gst_promise_unref (promise);
+  if (!g_atomic_int_get(&_is_draining) && g_async_queue_length(_pipeline_pool) < _pipeline_pool_size) {
+    webrtcbin = build_webrtc();
+    if (webrtcbin != NULL) {
+      g_async_queue_push(_pipeline_pool, webrtcbin);
+      return G_SOURCE_CONTINUE;
+    }
+  }
 
-  set_local_promise = gst_promise_new ();
-  g_signal_emit_by_name (webrtc, "set-local-description", answer, set_local_promise);
-  gst_promise_interrupt (set_local_promise);
-  gst_promise_unref (set_local_promise);
+  g_atomic_int_set(&_pipeline_pool_refilling, 0);
 
-  //answer_sdp_text = gst_sdp_message_as_text(answer->sdp);
+  /* An offer may have taken a pipeline after the last check. */
+  if (!g_atomic_int_get(&_is_draining)) {
+    schedule_pipeline_pool_refill();
+  }
 
-  //printf("Answer SDP: %s.\n", answer_sdp_text);
+  return G_SOURCE_REMOVE;
+}
 
-  //_sdp_answer_str = answer_sdp_text;
+/**
+* Records how long an offer took to answer, from the request arriving.
+*/
+static void record_offer_latency(gint64 start_time)
+{
+  g_mutex_lock(&_offer_latency_mutex);
+  _offer_latencies[_offer_latency_count % OFFER_LATENCY_SAMPLES] = g_get_monotonic_time() - start_time;
+  _offer_latency_count++;
+  g_mutex_unlock(&_offer_latency_mutex);
+}
 
-  gst_webrtc_session_description_free (answer);
+static gint compare_latency(gconstpointer a, gconstpointer b)
+{
+  gint64 first = *(const gint64*)a, second = *(const gint64*)b;
+  return (first > second) - (first < second);
 }
 
-static void on_negotiation_needed (GstElement* element, gpointer user_data)
+/**
+* The handler function for the stats endpoint, reports the pipeline pool's
+* hit rate and percentiles of the recent offer to answer latencies as JSON.
+* @param[in] req: the HTTP request received from the client.
+* @param[in] arg: not used.
+*/
+static void on_stats_request_cb(struct evhttp_request* req, void* arg)
 {
-  gchar* name;
-  GstWebRTCSignalingState signalingState = 0;
-  GstWebRTCSessionDescription* remoteDescription = NULL;
+  gint64 latencies[OFFER_LATENCY_SAMPLES];
+  guint64 latency_count;
+  size_t samples;
+  gint hits = g_atomic_int_get(&_pipeline_pool_hits);
+  gint misses = g_atomic_int_get(&_pipeline_pool_misses);
+  cJSON* stats_json;
+  cJSON* pool_json;
+  cJSON* latency_json;
+  cJSON* sessions_json;
+  cJSON* process_json;
+  int layer_peers[SIMULCAST_LAYERS];
+  gint layer;
+  guint i;
+  char* stats_text;
+  struct evbuffer* resp_buffer;
 
-  printf("on_negotiation_needed\n");
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
 
-  g_object_get (G_OBJECT (element), "name", &name, NULL);
-  g_print ("The name of the element is '%s'.\n", name);
-  g_free (name);
+  if (req->type != EVHTTP_REQ_GET) {
+    evhttp_add_header(req->output_headers, "Allow", "GET");
+    evhttp_send_reply(req, 405, "Method Not Allowed", NULL);
+    return;
+  }
 
-  g_object_get (G_OBJECT (element), "signaling-state", &signalingState, NULL);
-  g_print ("The signaling state of the element is '%d'.\n", signalingState);
+  g_mutex_lock(&_offer_latency_mutex);
+  latency_count = _offer_latency_count;
+  samples = (size_t)MIN(latency_count, OFFER_LATENCY_SAMPLES);
+  memcpy(latencies, _offer_latencies, samples * sizeof(gint64));
+  g_mutex_unlock(&_offer_latency_mutex);
 
-  g_object_get (G_OBJECT (element), "remote-description", &remoteDescription, NULL);
-  if (remoteDescription == NULL) {
-    g_print("Remote description is not set.\n");
+  qsort(latencies, samples, sizeof(gint64), compare_latency);
+
+  stats_json = cJSON_CreateObject();
+  cJSON_AddNumberToObject(stats_json, "activePipelines", g_atomic_int_get(&_active_pipelines));
+  if (!_is_echo) {
+    cJSON_AddStringToObject(stats_json, "encoder", _encoder_launch);
   }
-  else {
-    g_print("Remote description is set.\n");
+
+  if (_is_broadcast) {
+    g_mutex_lock(&_broadcast_mutex);
+    cJSON_AddNumberToObject(stats_json, "broadcastPeers", _broadcast_peers->len);
+    if (_is_simulcast) {
+      /* Peers on each layer, smallest first. */
+      memset(layer_peers, 0, sizeof(layer_peers));
+      for (i = 0; i < _broadcast_peers->len; i++) {
+        layer = ((struct broadcast_peer*)g_ptr_array_index(_broadcast_peers, i))->layer;
+        if (layer >= 0) {
+          layer_peers[layer]++;
+        }
+      }
+      cJSON_AddItemToObject(stats_json, "simulcastLayerPeers", cJSON_CreateIntArray(layer_peers, SIMULCAST_LAYERS));
+    }
+    g_mutex_unlock(&_broadcast_mutex);
   }
-}
 
-static void send_ice_candidate_message (GstElement* webrtc G_GNUC_UNUSED, guint mlineindex,
-  gchar* candidate, gpointer user_data G_GNUC_UNUSED)
-{
-  //printf("send_ice_candidate_message\n");
-}
+  sessions_json = cJSON_AddObjectToObject(stats_json, "sessions");
+  g_mutex_lock(&_sessions_mutex);
+  cJSON_AddNumberToObject(sessions_json, "live", g_hash_table_size(_sessions));
+  g_mutex_unlock(&_sessions_mutex);
+  cJSON_AddNumberToObject(sessions_json, "max", _max_sessions);
+  cJSON_AddNumberToObject(sessions_json, "rejected", g_atomic_int_get(&_sessions_rejected));
+  cJSON_AddNumberToObject(sessions_json, "ended", g_atomic_int_get(&_sessions_ended));
+  cJSON_AddNumberToObject(sessions_json, "timedOut", g_atomic_int_get(&_sessions_timed_out));
+
+  /* -1 where /proc isn't available. */
+  process_json = cJSON_AddObjectToObject(stats_json, "process");
+  cJSON_AddNumberToObject(process_json, "threads", (double)read_process_status("Threads"));
+  cJSON_AddNumberToObject(process_json, "residentKb", (double)read_process_status("VmRSS"));
+
+  pool_json = cJSON_AddObjectToObject(stats_json, "pipelinePool");
+  cJSON_AddNumberToObject(pool_json, "size", _pipeline_pool_size);
+  cJSON_AddNumberToObject(pool_json, "available", MAX(g_async_queue_length(_pipeline_pool), 0));
+  cJSON_AddNumberToObject(pool_json, "hits", hits);
+  cJSON_AddNumberToObject(pool_json, "misses", misses);
+  cJSON_AddNumberToObject(pool_json, "hitRate", (hits + misses) > 0 ? (double)hits / (hits + misses) : 0);
+
+  if (_trace_sample_interval > 0) {
+    cJSON_AddItemToObject(stats_json, "trace", create_trace_json());
+  }
 
-static void on_new_transceiver (GstElement* object, GstWebRTCRTPTransceiver* candidate, gpointer udata)
-{
-  g_print("on_new_transceiver.\n");
-}
+  /* Percentiles are over the most recent OFFER_LATENCY_SAMPLES answers. */
+  latency_json = cJSON_AddObjectToObject(stats_json, "offerLatency");
+  cJSON_AddNumberToObject(latency_json, "count", (double)latency_count);
+  if (samples > 0) {
+    cJSON_AddNumberToObject(latency_json, "p50Ms", latencies[(samples - 1) * 50 / 100] / 1000.0);
+    cJSON_AddNumberToObject(latency_json, "p95Ms", latencies[(samples - 1) * 95 / 100] / 1000.0);
+    cJSON_AddNumberToObject(latency_json, "p99Ms", latencies[(samples - 1) * 99 / 100] / 1000.0);
+    cJSON_AddNumberToObject(latency_json, "maxMs", latencies[samples - 1] / 1000.0);
+  }
 
-static void on_ice_gathering_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data)
-{
-  GstWebRTCICEGatheringState ice_gathering_state = 0;
-  g_object_get (G_OBJECT (webrtcbin), "ice-gathering-state", &ice_gathering_state, NULL);
-  g_print ("on_ice_gathering_state_notify '%d'.\n", ice_gathering_state);
-}
+  stats_text = cJSON_PrintUnformatted(stats_json);
 
-static void on_ice_connection_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data)
-{
-  GstWebRTCICEConnectionState ice_connection_state = 0;
-  g_object_get (G_OBJECT (webrtcbin), "ice-connection-state", &ice_connection_state, NULL);
-  g_print ("on_ice_connection_state_notify '%d'.\n", ice_connection_state);
+  resp_buffer = evbuffer_new();
+  evbuffer_add(resp_buffer, stats_text, strlen(stats_text));
+  evhttp_add_header(req->output_headers, "Content-Type", "application/json");
+  evhttp_send_reply(req, 200, "OK", resp_buffer);
+  evbuffer_free(resp_buffer);
+
+  cJSON_free(stats_text);
+  cJSON_Delete(stats_json);
 }
 
-static void on_connection_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data)
+/**
+* Finds or creates the totals for a boundary, they live as long as the process.
+*/
+static struct trace_boundary* get_trace_boundary(const gchar* name, gboolean is_queue)
 {
-  GstWebRTCPeerConnectionState connection_state = 0;
-  g_object_get (G_OBJECT (webrtcbin), "connection-state", &connection_state, NULL);
-  g_print ("on_connection_state_notify '%d'.\n", connection_state);
+  struct trace_boundary* boundary = NULL;
+  guint i;
 
-  if (connection_state == GST_WEBRTC_PEER_CONNECTION_STATE_FAILED) {
-    g_print("Peer connections failed, shutting down pipeline.\n");
-    gst_element_set_state (webrtcbin, GST_STATE_NULL);
-    gst_object_unref (webrtcbin);
+  g_mutex_lock(&_trace_mutex);
+
+  for (i = 0; i < _trace_boundaries->len && boundary == NULL; i++) {
+    if (strcmp(((struct trace_boundary*)g_ptr_array_index(_trace_boundaries, i))->name, name) == 0) {
+      boundary = g_ptr_array_index(_trace_boundaries, i);
+    }
   }
-}
 
-static gboolean bus_call (GstBus* bus, GstMessage* msg, gpointer data)
-{
-  //GMainLoop* loop = (GMainLoop*)data;
+  if (boundary == NULL) {
+    boundary = g_new0(struct trace_boundary, 1);
+    boundary->name = g_strdup(name);
+    boundary->is_queue = is_queue;
+    g_ptr_array_add(_trace_boundaries, boundary);
+  }
 
-  //g_print("bus_call %d.\n", GST_MESSAGE_TYPE (msg));
+  g_mutex_unlock(&_trace_mutex);
 
-  switch (GST_MESSAGE_TYPE (msg)) {
+  return boundary;
+}
 
-  case GST_MESSAGE_EOS:
-    g_print ("End of stream\n");
-    //g_main_loop_quit (loop);
-    break;
+/**
+* Adds a trace probe to each of an element's linked source pads, and counts
+* its overruns if it's a queue.
+*/
+static void trace_element(GstElement* element)
+{
+  const gchar* factory = GST_OBJECT_NAME(gst_element_get_factory(element));
+  gboolean is_queue = strcmp(factory, "queue") == 0;
+  GstIterator* pads = gst_element_iterate_src_pads(element);
+  GValue item = G_VALUE_INIT;
+  struct trace_probe* probe;
+  GstPad* pad;
+  GstPad* peer;
+  GstElement* peer_element;
+  gchar* name;
 
-  case GST_MESSAGE_ERROR: {
-    gchar* debug;
-    GError* error;
+  while (gst_iterator_next(pads, &item) == GST_ITERATOR_OK) {
+    pad = g_value_get_object(&item);
+    peer = gst_pad_get_peer(pad);
+    peer_element = peer != NULL ? gst_pad_get_parent_element(peer) : NULL;
 
-    gst_message_parse_error (msg, &error, &debug);
-    g_free (debug);
+    if (peer_element != NULL) {
+      name = g_strdup_printf("%s ! %s", factory, GST_OBJECT_NAME(gst_element_get_factory(peer_element)));
 
-    g_printerr ("Error: %s\n", error->message);
+      probe = g_new0(struct trace_probe, 1);
+      probe->boundary = get_trace_boundary(name, is_queue);
+      probe->queue = is_queue ? element : NULL;
+      probe->is_source = GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SOURCE);
+
+      gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST, on_trace_probe, probe, g_free);
+
+      if (is_queue) {
+        g_signal_connect(element, "overrun", G_CALLBACK(on_trace_queue_overrun), probe->boundary);
+      }
+
+      g_free(name);
+      gst_object_unref(peer_element);
+    }
+
+    if (peer != NULL) {
+      gst_object_unref(peer);
+    }
+    g_value_reset(&item);
+  }
+
+  g_value_unset(&item);
+  gst_iterator_free(pads);
+}
+
+/**
+* Adds trace probes to every element boundary in a pipeline. Pads added once
+* the pipeline is running, such as the webrtcbin's incoming ones, aren't traced.
+*/
+static void trace_pipeline(GstElement* pipeline)
+{
+  GstIterator* elements = gst_bin_iterate_elements(GST_BIN(pipeline));
+  GValue item = G_VALUE_INIT;
+
+  while (gst_iterator_next(elements, &item) == GST_ITERATOR_OK) {
+    trace_element(g_value_get_object(&item));
+    g_value_reset(&item);
+  }
+
+  g_value_unset(&item);
+  gst_iterator_free(elements);
+}
+
+/**
+* Stamps every Nth buffer leaving a source and records the age of any stamped
+* buffer crossing a boundary. The payloader sends a frame's packets as a list,
+* the first packet stands for the frame.
+*/
+static GstPadProbeReturn on_trace_probe(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  struct trace_probe* probe = (struct trace_probe*)user_data;
+  struct trace_boundary* boundary = probe->boundary;
+  GstReferenceTimestampMeta* meta;
+  GstBuffer* buffer;
+  GstBufferList* list;
+  gint64 latency;
+  guint queue_level = 0;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+    if (gst_buffer_list_length(list) == 0) {
+      return GST_PAD_PROBE_OK;
+    }
+    buffer = gst_buffer_list_get(list, 0);
+  }
+  else {
+    buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  }
+
+  meta = gst_buffer_get_reference_timestamp_meta(buffer, _trace_caps);
+
+  /* A broadcast peer's appsrc passes on the stamp from the shared pipeline. */
+  if (meta == NULL && probe->is_source && (info->type & GST_PAD_PROBE_TYPE_BUFFER) &&
+    probe->count++ % _trace_sample_interval == 0) {
+    buffer = gst_buffer_make_writable(buffer);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    meta = gst_buffer_add_reference_timestamp_meta(buffer, _trace_caps,
+      g_get_monotonic_time() * GST_USECOND, GST_CLOCK_TIME_NONE);
+  }
+
+  if (meta == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  latency = g_get_monotonic_time() - (gint64)(meta->timestamp / GST_USECOND);
+
+  if (probe->queue != NULL) {
+    g_object_get(probe->queue, "current-level-buffers", &queue_level, NULL);
+  }
+
+  g_mutex_lock(&_trace_mutex);
+  boundary->samples++;
+  boundary->latency_sum += latency;
+  boundary->latency_max = MAX(boundary->latency_max, latency);
+  boundary->queue_level_sum += queue_level;
+  boundary->queue_level_max = MAX(boundary->queue_level_max, queue_level);
+  g_mutex_unlock(&_trace_mutex);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/**
+* A queue is full. A leaky one drops a buffer, any other blocks its upstream.
+*/
+static void on_trace_queue_overrun(GstElement* queue, gpointer user_data)
+{
+  g_mutex_lock(&_trace_mutex);
+  ((struct trace_boundary*)user_data)->overruns++;
+  g_mutex_unlock(&_trace_mutex);
+}
+
+static gint compare_trace_boundary(gconstpointer a, gconstpointer b)
+{
+  const struct trace_boundary* first = (const struct trace_boundary*)a;
+  const struct trace_boundary* second = (const struct trace_boundary*)b;
+  double first_mean = first->samples > 0 ? (double)first->latency_sum / first->samples : 0;
+  double second_mean = second->samples > 0 ? (double)second->latency_sum / second->samples : 0;
+
+  return (first_mean > second_mean) - (first_mean < second_mean);
+}
+
+/**
+* Builds the trace aggregates as JSON. Boundaries are ordered by their mean
+* latency, which puts them in pipeline order, so the difference between one
+* and the next is the time spent in the element between them.
+*/
+static cJSON* create_trace_json()
+{
+  cJSON* trace_json = cJSON_CreateObject();
+  cJSON* boundaries_json;
+  cJSON* boundary_json;
+  struct trace_boundary* boundaries;
+  guint count;
+  guint i;
+
+  g_mutex_lock(&_trace_mutex);
+  count = _trace_boundaries->len;
+  boundaries = g_new(struct trace_boundary, MAX(count, 1));
+  for (i = 0; i < count; i++) {
+    boundaries[i] = *(struct trace_boundary*)g_ptr_array_index(_trace_boundaries, i);
+  }
+  g_mutex_unlock(&_trace_mutex);
+
+  qsort(boundaries, count, sizeof(struct trace_boundary), compare_trace_boundary);
+
+  cJSON_AddNumberToObject(trace_json, "sampleInterval", _trace_sample_interval);
+  boundaries_json = cJSON_AddArrayToObject(trace_json, "boundaries");
+
+  for (i = 0; i < count; i++) {
+    boundary_json = cJSON_CreateObject();
+    cJSON_AddStringToObject(boundary_json, "name", boundaries[i].name);
+    cJSON_AddNumberToObject(boundary_json, "samples", (double)boundaries[i].samples);
+
+    if (boundaries[i].samples > 0) {
+      cJSON_AddNumberToObject(boundary_json, "meanMs", (double)boundaries[i].latency_sum / boundaries[i].samples / 1000.0);
+      cJSON_AddNumberToObject(boundary_json, "maxMs", boundaries[i].latency_max / 1000.0);
+    }
+
+    if (boundaries[i].is_queue) {
+      cJSON_AddNumberToObject(boundary_json, "queueLevelMean",
+        boundaries[i].samples > 0 ? (double)boundaries[i].queue_level_sum / boundaries[i].samples : 0);
+      cJSON_AddNumberToObject(boundary_json, "queueLevelMax", boundaries[i].queue_level_max);
+      cJSON_AddNumberToObject(boundary_json, "overruns", (double)boundaries[i].overruns);
+    }
+
+    cJSON_AddItemToArray(boundaries_json, boundary_json);
+  }
+
+  g_free(boundaries);
+
+  return trace_json;
+}
+
+static void on_trace_dump_timer(evutil_socket_t fd, short events, void* arg)
+{
+  cJSON* trace_json = create_trace_json();
+  char* trace_text = cJSON_PrintUnformatted(trace_json);
+
+  printf("Trace: %s\n", trace_text);
+
+  cJSON_free(trace_text);
+  cJSON_Delete(trace_json);
+}
+
+/**
+* Parses an encoder profile, the name of one from the table optionally
+* followed by settings to override, e.g. vp8-fast,threads=4,bitrate=1500.
+* @@Returns FALSE if the profile or a setting isn't known.
+*/
+static gboolean parse_encoder_profile(const char* spec, struct encoder_profile* profile)
+{
+  gchar** options = g_strsplit(spec, ",", -1);
+  gboolean is_ok = FALSE;
+  gchar** option;
+  gchar* value;
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS(_encoder_profiles) && !is_ok; i++) {
+    if (options[0] != NULL && strcmp(options[0], _encoder_profiles[i].name) == 0) {
+      *profile = _encoder_profiles[i];
+      is_ok = TRUE;
+    }
+  }
+
+  for (option = options + 1; is_ok && *option != NULL; option++) {
+    value = strchr(*option, '=');
+    if (value == NULL) {
+      is_ok = FALSE;
+      break;
+    }
+    *value++ = '\0';
+
+    if (strcmp(*option, "threads") == 0) {
+      profile->threads = atoi(value);
+    }
+    else if (strcmp(*option, "token-partitions") == 0) {
+      profile->token_partitions = atoi(value);
+    }
+    else if (strcmp(*option, "cpu-used") == 0) {
+      profile->cpu_used = atoi(value);
+    }
+    else if (strcmp(*option, "keyframe-interval") == 0) {
+      profile->keyframe_interval = atoi(value);
+    }
+    else if (strcmp(*option, "bitrate") == 0) {
+      profile->target_bitrate = atoi(value);
+    }
+    else {
+      is_ok = FALSE;
+    }
+  }
+
+  g_strfreev(options);
+
+  return is_ok;
+}
+
+/**
+* Builds the encoder element of a pipeline for a profile.
+* @@Returns the launch string, to be freed with g_free.
+*/
+static gchar* build_encoder(const struct encoder_profile* profile)
+{
+  GString* launch = g_string_new(NULL);
+
+  if (strcmp(profile->codec, "H264") == 0) {
+    g_string_append(launch, "openh264enc");
+    if (profile->threads >= 0) {
+      g_string_append_printf(launch, " multi-thread=%d", profile->threads);
+    }
+    if (profile->cpu_used >= 0) {
+      g_string_append_printf(launch, " complexity=%d", profile->cpu_used);
+    }
+    if (profile->keyframe_interval >= 0) {
+      g_string_append_printf(launch, " gop-size=%d", profile->keyframe_interval);
+    }
+    if (profile->target_bitrate >= 0) {
+      g_string_append_printf(launch, " bitrate=%d", profile->target_bitrate * 1000);
+    }
+  }
+  else {
+    g_string_append_printf(launch, "%s deadline=1", strcmp(profile->codec, "VP9") == 0 ? "vp9enc" : "vp8enc");
+    if (profile->threads >= 0) {
+      g_string_append_printf(launch, " threads=%d", profile->threads);
+    }
+    if (profile->token_partitions >= 0 && strcmp(profile->codec, "VP8") == 0) {
+      g_string_append_printf(launch, " token-partitions=%d", profile->token_partitions);
+    }
+    if (profile->cpu_used >= 0) {
+      g_string_append_printf(launch, " cpu-used=%d", profile->cpu_used);
+    }
+    if (profile->keyframe_interval >= 0) {
+      g_string_append_printf(launch, " keyframe-max-dist=%d", profile->keyframe_interval);
+    }
+    if (profile->target_bitrate >= 0) {
+      g_string_append_printf(launch, " target-bitrate=%d", profile->target_bitrate * 1000);
+    }
+  }
+
+  return g_string_free(launch, FALSE);
+}
+
+/**
+* Builds the encoder and payloader part of a pipeline for a profile.
+* @@Returns the launch string, to be freed with g_free.
+*/
+static gchar* build_encoder_launch(const struct encoder_profile* profile)
+{
+  gchar* encoder = build_encoder(profile);
+  gchar* launch = g_strdup_printf("%s ! %s", encoder, get_encoder_payloader(profile));
+
+  g_free(encoder);
+
+  return launch;
+}
+
+static const char* get_encoder_payloader(const struct encoder_profile* profile)
+{
+  if (strcmp(profile->codec, "H264") == 0) {
+    return "rtph264pay config-interval=-1";
+  }
+  else if (strcmp(profile->codec, "VP9") == 0) {
+    return "rtpvp9pay";
+  }
+  return "rtpvp8pay";
+}
+
+/**
+* The caps of the encoder's output, for the appsrc that takes a simulcast layer's frames.
+*/
+static const char* get_encoder_caps(const struct encoder_profile* profile)
+{
+  if (strcmp(profile->codec, "H264") == 0) {
+    return "video/x-h264,stream-format=byte-stream,alignment=au";
+  }
+  else if (strcmp(profile->codec, "VP9") == 0) {
+    return "video/x-vp9";
+  }
+  return "video/x-vp8";
+}
+
+static const char* get_encoder_rtp_caps(const struct encoder_profile* profile)
+{
+  if (strcmp(profile->codec, "H264") == 0) {
+    return RTP_CAPS_H264;
+  }
+  else if (strcmp(profile->codec, "VP9") == 0) {
+    return RTP_CAPS_VP9;
+  }
+  return RTP_CAPS_VP8;
+}
+
+/**
+* CPU time used by every thread in the process, in microseconds.
+*/
+static gint64 get_process_cpu_time()
+{
+#ifdef _WIN32
+  FILETIME creation_time, exit_time, kernel_time, user_time;
+  ULARGE_INTEGER kernel, user;
+
+  GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time);
+  kernel.LowPart = kernel_time.dwLowDateTime;
+  kernel.HighPart = kernel_time.dwHighDateTime;
+  user.LowPart = user_time.dwLowDateTime;
+  user.HighPart = user_time.dwHighDateTime;
+
+  /* FILETIMEs count 100ns intervals. */
+  return (gint64)((kernel.QuadPart + user.QuadPart) / 10);
+#else
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return (gint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+    usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+}
+
+/**
+* Encodes BENCHMARK_FRAMES frames of the test pattern with a profile as fast
+* as it will go. The CPU use includes drawing the pattern, which is the same
+* for every profile.
+* @@Returns FALSE if the pipeline couldn't be built or failed.
+*/
+static gboolean benchmark_encoder(const struct encoder_profile* profile, gint width, gint height,
+  double* fps, double* cpu_percent)
+{
+  GstElement* pipeline;
+  GstBus* bus;
+  GstMessage* msg;
+  GError* error = NULL;
+  gchar* encoder = build_encoder_launch(profile);
+  gchar* launch;
+  gint64 start_time, start_cpu, elapsed, cpu;
+  gboolean is_ok;
+
+  launch = g_strdup_printf("videotestsrc num-buffers=%d pattern=ball ! "
+    "video/x-raw,format=I420,width=%d,height=%d,framerate=30/1 ! %s ! fakesink",
+    BENCHMARK_FRAMES, width, height, encoder);
+  pipeline = gst_parse_launch(launch, &error);
+  g_free(launch);
+  g_free(encoder);
+
+  if (error) {
+    gst_printerr("Failed to parse benchmark launch: %s\n", error->message);
+    g_error_free(error);
+    if (pipeline != NULL) {
+      gst_object_unref(pipeline);
+    }
+    return FALSE;
+  }
+
+  start_time = g_get_monotonic_time();
+  start_cpu = get_process_cpu_time();
+
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+  bus = gst_element_get_bus(pipeline);
+  msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  is_ok = msg != NULL && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+
+  elapsed = MAX(g_get_monotonic_time() - start_time, 1);
+  cpu = get_process_cpu_time() - start_cpu;
+
+  *fps = BENCHMARK_FRAMES * (double)G_USEC_PER_SEC / elapsed;
+  *cpu_percent = 100.0 * cpu / elapsed;
+
+  if (msg != NULL) {
+    gst_message_unref(msg);
+  }
+  gst_object_unref(bus);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+
+  return is_ok;
+}
+
+/**
+* Benchmarks each profile at 720p and 1080p. CPU is a percentage of one
+* core, a profile using several threads can go over 100.
+* @@Returns 0 if every profile could be benchmarked, -1 otherwise.
+*/
+static int run_encoder_benchmark(const struct encoder_profile* profiles, gsize count)
+{
+  static const gint sizes[][2] = { { 1280, 720 }, { 1920, 1080 } };
+  double fps, cpu_percent;
+  gchar* encoder;
+  int res = 0;
+  gsize i, j;
+
+  for (i = 0; i < count; i++) {
+    encoder = build_encoder_launch(&profiles[i]);
+    printf("%s: %s\n", profiles[i].name, encoder);
+    g_free(encoder);
+
+    for (j = 0; j < G_N_ELEMENTS(sizes); j++) {
+      if (benchmark_encoder(&profiles[i], sizes[j][0], sizes[j][1], &fps, &cpu_percent)) {
+        printf("  %dx%d %.1f fps, %.0f%% CPU.\n", sizes[j][0], sizes[j][1], fps, cpu_percent);
+      }
+      else {
+        printf("  %dx%d failed, the encoder may not be installed.\n", sizes[j][0], sizes[j][1]);
+        res = -1;
+      }
+    }
+  }
+
+  return res;
+}
+
+/**
+* Builds and starts the shared pipeline for broadcast mode. Each layer is
+* picked up from its appsink by on_broadcast_sample. Without simulcast the
+* one layer is RTP, with it each of the SIMULCAST_LAYERS is encoded frames
+* that every peer payloads for itself.
+* @@Returns FALSE if the pipeline couldn't be started.
+*/
+static gboolean start_broadcast()
+{
+  struct encoder_profile layer_profile;
+  GString* launch = g_string_new(NULL);
+  GstBus* bus;
+  GError* error = NULL;
+  gchar* encoder;
+  gchar* name;
+  gint i;
+
+  if (_is_simulcast) {
+    /* The source is scaled and encoded once per layer, however many peers there are. */
+    g_string_append_printf (launch, "videotestsrc is-live=true pattern=ball ! video/x-raw,width=%d,height=%d ! "
+      "videoconvert ! tee name=layers ",
+      _simulcast_layers[SIMULCAST_LAYERS - 1].width, _simulcast_layers[SIMULCAST_LAYERS - 1].height);
+
+    for (i = 0; i < SIMULCAST_LAYERS; i++) {
+      layer_profile = _encoder_profile;
+      layer_profile.target_bitrate = _simulcast_layers[i].bitrate;
+      encoder = build_encoder (&layer_profile);
+      g_string_append_printf (launch, "layers. ! queue ! videoscale ! video/x-raw,width=%d,height=%d ! %s ! "
+        "appsink name=layer%d sync=false emit-signals=true drop=true max-buffers=8 ",
+        _simulcast_layers[i].width, _simulcast_layers[i].height, encoder, i);
+      g_free (encoder);
+    }
+
+    _broadcast_layer_count = SIMULCAST_LAYERS;
+  }
+  else {
+    g_string_append_printf (launch, "videotestsrc is-live=true pattern=ball ! videoconvert ! queue ! %s ! "
+      "%s ! appsink name=layer0 sync=false emit-signals=true drop=true max-buffers=64",
+      _encoder_launch, get_encoder_rtp_caps(&_encoder_profile));
+
+    _broadcast_layer_count = 1;
+  }
+
+  _broadcast_pipeline = gst_parse_launch (launch->str, &error);
+  g_string_free (launch, TRUE);
+
+  if (error) {
+    gst_printerr ("Failed to parse broadcast launch: %s\n", error->message);
     g_error_free (error);
+    return FALSE;
+  }
 
-    //g_main_loop_quit (loop);
-    break;
+  _broadcast_peers = g_ptr_array_new_with_free_func(free_broadcast_peer);
+
+  for (i = 0; i < _broadcast_layer_count; i++) {
+    name = g_strdup_printf ("layer%d", i);
+    _broadcast_sinks[i] = gst_bin_get_by_name (GST_BIN (_broadcast_pipeline), name);
+    g_signal_connect (_broadcast_sinks[i], "new-sample", G_CALLBACK (on_broadcast_sample), GINT_TO_POINTER (i));
+    g_free (name);
   }
-  default:
-    break;
+
+  if (_trace_sample_interval > 0) {
+    trace_pipeline (_broadcast_pipeline);
   }
 
-  return TRUE;
+  bus = gst_element_get_bus (_broadcast_pipeline);
+  gst_bus_add_watch (bus, bus_call, NULL);
+  gst_object_unref (bus);
+
+  return gst_element_set_state (_broadcast_pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE;
+}
+
+static void free_broadcast_peer(gpointer data)
+{
+  struct broadcast_peer* peer = (struct broadcast_peer*)data;
+
+  gst_object_unref(peer->appsrc);
+  gst_object_unref(peer->webrtcbin);
+  g_free(peer);
+}
+
+/**
+* Looks up the peer for a webrtcbin, must be called with _broadcast_mutex held.
+*/
+static struct broadcast_peer* find_broadcast_peer(GstElement* webrtcbin)
+{
+  struct broadcast_peer* peer;
+  guint i;
+
+  for (i = 0; i < _broadcast_peers->len; i++) {
+    peer = g_ptr_array_index(_broadcast_peers, i);
+    if (peer->webrtcbin == webrtcbin) {
+      return peer;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+* Fans a packet, or with simulcast a frame, from one layer out to every peer
+* on that layer. Each peer gets its own buffer so its appsrc can restamp it
+* with its pipeline's running time, the memory is shared rather than copied.
+* A peer switching layers moves at the new layer's first keyframe.
+*/
+static GstFlowReturn on_broadcast_sample(GstAppSink* appsink, gpointer user_data)
+{
+  gint layer = GPOINTER_TO_INT(user_data);
+  GstSample* sample = gst_app_sink_pull_sample(appsink);
+  struct broadcast_peer* peer;
+  GstBuffer* buffer;
+  GstBuffer* peer_buffer;
+  gboolean is_keyframe;
+  guint i;
+
+  if (sample == NULL) {
+    return GST_FLOW_EOS;
+  }
+
+  buffer = gst_sample_get_buffer(sample);
+  is_keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  g_mutex_lock(&_broadcast_mutex);
+  for (i = 0; i < _broadcast_peers->len; i++) {
+    peer = g_ptr_array_index(_broadcast_peers, i);
+
+    if (peer->layer != layer && peer->target_layer == layer && is_keyframe) {
+      peer->layer = layer;
+      peer->low_loss_since = g_get_monotonic_time();
+    }
+
+    if (peer->layer == layer) {
+      peer_buffer = gst_buffer_copy(buffer);
+      GST_BUFFER_PTS(peer_buffer) = GST_CLOCK_TIME_NONE;
+      GST_BUFFER_DTS(peer_buffer) = GST_CLOCK_TIME_NONE;
+      gst_app_src_push_buffer(GST_APP_SRC(peer->appsrc), peer_buffer);
+    }
+  }
+  g_mutex_unlock(&_broadcast_mutex);
+
+  gst_sample_unref(sample);
+
+  return GST_FLOW_OK;
 }
+
+/**
+* Passes a peer's keyframe requests, from its PLIs and FIRs, on to the
+* encoder of the layer it's on or moving to.
+*/
+static GstPadProbeReturn on_broadcast_peer_event(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  if (gst_video_event_is_force_key_unit(GST_PAD_PROBE_INFO_EVENT(info))) {
+    request_broadcast_peer_keyframe((GstElement*)user_data);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/**
+* Starts feeding a peer that has just been handed an offer. Its first keyframe
+* is requested once it connects, anything sent before then is dropped by its
+* webrtcbin. A simulcast peer starts on the smallest layer and moves up while
+* its loss stays low.
+*/
+static void add_broadcast_peer(GstElement* webrtcbin)
+{
+  GstElement* appsrc = gst_bin_get_by_name(GST_BIN(GST_ELEMENT_PARENT(webrtcbin)), "broadcastin");
+  struct broadcast_peer* peer;
+  GstPad* src_pad;
+
+  if (appsrc == NULL) {
+    return;
+  }
+
+  src_pad = gst_element_get_static_pad(appsrc, "src");
+  gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, on_broadcast_peer_event, webrtcbin, NULL);
+  gst_object_unref(src_pad);
+
+  /* The peer keeps the reference from get_by_name. */
+  peer = g_new0(struct broadcast_peer, 1);
+  peer->webrtcbin = gst_object_ref(webrtcbin);
+  peer->appsrc = appsrc;
+  peer->layer = _is_simulcast ? -1 : 0;
+  peer->target_layer = 0;
+  peer->low_loss_since = g_get_monotonic_time();
+
+  g_mutex_lock(&_broadcast_mutex);
+  g_ptr_array_add(_broadcast_peers, peer);
+  g_mutex_unlock(&_broadcast_mutex);
+}
+
+/**
+* Stops feeding a peer, called before its pipeline is shut down. Does nothing
+* if broadcast mode is off or the peer was never added.
+*/
+static void remove_broadcast_peer(GstElement* webrtcbin)
+{
+  struct broadcast_peer* peer;
+
+  if (!_is_broadcast) {
+    return;
+  }
+
+  g_mutex_lock(&_broadcast_mutex);
+  peer = find_broadcast_peer(webrtcbin);
+  if (peer != NULL) {
+    g_ptr_array_remove(_broadcast_peers, peer);
+  }
+  g_mutex_unlock(&_broadcast_mutex);
+}
+
+/**
+* Asks a layer's encoder for a keyframe. The event travels upstream from
+* the layer's appsink to its encoder.
+*/
+static void request_broadcast_keyframe(gint layer)
+{
+  gst_element_send_event(_broadcast_sinks[layer],
+    gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+}
+
+/**
+* Asks for a keyframe on the layer a peer is on or moving to. Does nothing if
+* broadcast mode is off or the webrtcbin isn't a broadcast peer.
+*/
+static void request_broadcast_peer_keyframe(GstElement* webrtcbin)
+{
+  struct broadcast_peer* peer;
+  gint layer = -1;
+
+  if (!_is_broadcast) {
+    return;
+  }
+
+  g_mutex_lock(&_broadcast_mutex);
+  peer = find_broadcast_peer(webrtcbin);
+  if (peer != NULL) {
+    layer = peer->target_layer;
+  }
+  g_mutex_unlock(&_broadcast_mutex);
+
+  if (layer >= 0) {
+    request_broadcast_keyframe(layer);
+  }
+}
+
+/**
+* Asks each simulcast peer's webrtcbin for its stats, on_simulcast_stats
+* picks the peer's layer from the reply.
+*/
+static void on_simulcast_timer(evutil_socket_t fd, short events, void* arg)
+{
+  GPtrArray* webrtcbins = g_ptr_array_new_with_free_func(gst_object_unref);
+  GstElement* webrtcbin;
+  GstPromise* promise;
+  guint i;
+
+  g_mutex_lock(&_broadcast_mutex);
+  for (i = 0; i < _broadcast_peers->len; i++) {
+    g_ptr_array_add(webrtcbins, gst_object_ref(((struct broadcast_peer*)g_ptr_array_index(_broadcast_peers, i))->webrtcbin));
+  }
+  g_mutex_unlock(&_broadcast_mutex);
+
+  /* Outside the lock, the reply can come before the signal returns. */
+  for (i = 0; i < webrtcbins->len; i++) {
+    webrtcbin = g_ptr_array_index(webrtcbins, i);
+    promise = gst_promise_new_with_change_func(on_simulcast_stats, gst_object_ref(webrtcbin), gst_object_unref);
+    g_signal_emit_by_name(webrtcbin, "get-stats", NULL, promise);
+  }
+
+  g_ptr_array_unref(webrtcbins);
+}
+
+static gboolean find_fraction_lost(GQuark field_id, const GValue* value, gpointer user_data)
+{
+  GstWebRTCStatsType type;
+  const GstStructure* stats;
+
+  if (GST_VALUE_HOLDS_STRUCTURE(value)) {
+    stats = gst_value_get_structure(value);
+    if (gst_structure_get(stats, "type", GST_TYPE_WEBRTC_STATS_TYPE, &type, NULL) &&
+      type == GST_WEBRTC_STATS_REMOTE_INBOUND_RTP) {
+      gst_structure_get_double(stats, "fraction-lost", (gdouble*)user_data);
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+* Moves a simulcast peer down a layer when its receiver reports show heavy
+* loss and up one when they've been clean for SIMULCAST_UP_HOLD_SECONDS.
+* The new layer's encoder is asked for a keyframe so the switch is quick.
+*/
+static void on_simulcast_stats(GstPromise* promise, gpointer user_data)
+{
+  GstElement* webrtcbin = (GstElement*)user_data;
+  const GstStructure* reply;
+  struct broadcast_peer* peer;
+  gdouble fraction_lost = -1;
+  gint64 now = g_get_monotonic_time();
+  gint target = -1;
+
+  if (gst_promise_wait(promise) == GST_PROMISE_RESULT_REPLIED && (reply = gst_promise_get_reply(promise)) != NULL) {
+    gst_structure_foreach(reply, find_fraction_lost, &fraction_lost);
+  }
+  gst_promise_unref(promise);
+
+  /* No receiver report yet. */
+  if (fraction_lost < 0) {
+    return;
+  }
+
+  g_mutex_lock(&_broadcast_mutex);
+  peer = find_broadcast_peer(webrtcbin);
+
+  /* Any report at or over the up threshold restarts the hold before a move up. */
+  if (peer != NULL && fraction_lost >= SIMULCAST_LOSS_UP) {
+    peer->low_loss_since = now;
+  }
+
+  /* A peer part way through a switch is left alone until it gets there. */
+  if (peer != NULL && peer->layer == peer->target_layer) {
+    if (fraction_lost > SIMULCAST_LOSS_DOWN && peer->layer > 0) {
+      target = peer->layer - 1;
+    }
+    else if (fraction_lost < SIMULCAST_LOSS_UP && peer->layer < _broadcast_layer_count - 1 &&
+      now - peer->low_loss_since >= (gint64)SIMULCAST_UP_HOLD_SECONDS * G_USEC_PER_SEC) {
+      target = peer->layer + 1;
+    }
+
+    if (target >= 0) {
+      peer->target_layer = target;
+    }
+  }
+  g_mutex_unlock(&_broadcast_mutex);
+
+  if (target >= 0) {
+    printf("Simulcast peer moving to layer %d, %.1f%% loss.\n", target, fraction_lost * 100);
+    request_broadcast_keyframe(target);
+  }
+}
+
+/**
+* Starts answering an offer on a webrtcbin from create_webrtc, the request is
+* parked until the answer is ready. From here each step is started by the
+* previous one's promise: on_offer_set creates the answer, on_answer_created
+* sets it as the local description and on_local_description_set hands the
+* answer back to the libevent thread to reply with.
+* @param[in] req: the HTTP request to reply to with the answer.
+* @param[in] webrtcbin: the webrtcbin to answer the offer with.
+* @param[in] sdp_offer_str: the SDP offer, it needn't be null terminated.
+* @param[in] sdp_offer_len: the length of the SDP offer.
+* @param[in] is_whip: TRUE for a WHIP offer, FALSE for /offer.
+* @param[in] start_time: when the request arrived, for the latency stats.
+*/
+static void answer_offer(struct evhttp_request* req, GstElement* webrtcbin, const gchar* sdp_offer_str,
+  gsize sdp_offer_len, gboolean is_whip, gint64 start_time)
+{
+  struct offer_request* offer;
+  GstWebRTCSessionDescription* remote_offer = NULL;
+  GstPromise* promise;
+  GstSDPMessage* sdp;
+  int ret;
+
+  printf("answer_offer.\n");
+
+  offer = g_new0(struct offer_request, 1);
+  offer->req = req;
+  offer->webrtcbin = gst_object_ref(webrtcbin);
+  offer->is_whip = is_whip;
+  offer->start_time = start_time;
+
+  /* If the client goes before the answer is ready the request is freed with its connection. */
+  evhttp_connection_set_closecb(evhttp_request_get_connection(req), on_offer_connection_closed, offer);
+
+  ret = gst_sdp_message_new (&sdp);
+  g_assert_cmphex (ret, == , GST_SDP_OK);
+  ret = gst_sdp_message_parse_buffer ((const guint8*)sdp_offer_str, (guint)sdp_offer_len, sdp);
+  if (ret != GST_SDP_OK || gst_sdp_message_medias_len (sdp) == 0) {
+    /* Offers now arrive as raw SDP too, a bad one mustn't take the server down. */
+    fprintf(stderr, "Could not parse SDP offer.\n");
+    gst_sdp_message_free (sdp);
+    complete_offer(offer);
+    return;
+  }
+
+  remote_offer = gst_webrtc_session_description_new (GST_WEBRTC_SDP_TYPE_OFFER, sdp);
+  g_assert_nonnull (remote_offer);
+
+  /* Set remote description on our pipeline */
+  promise = gst_promise_new_with_change_func (on_offer_set, offer, NULL);
+  g_signal_emit_by_name (webrtcbin, "set-remote-description", remote_offer, promise);
+  gst_webrtc_session_description_free (remote_offer);
+}
+
+/**
+* Checks a webrtcbin promise in its change callback.
+* @@Returns FALSE if the promise wasn't replied to or its reply is an error.
+*/
+static gboolean is_promise_ok(GstPromise* promise, const char* step)
+{
+  const GstStructure* reply;
+  GError* error = NULL;
+
+  if (gst_promise_wait (promise) != GST_PROMISE_RESULT_REPLIED) {
+    fprintf(stderr, "The webrtcbin didn't reply to %s.\n", step);
+    return FALSE;
+  }
+
+  reply = gst_promise_get_reply (promise);
+  if (reply != NULL && gst_structure_get (reply, "error", G_TYPE_ERROR, &error, NULL)) {
+    fprintf(stderr, "The webrtcbin failed to %s: %s\n", step, error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void on_offer_set (GstPromise* promise, gpointer user_data)
+{
+  struct offer_request* offer = (struct offer_request*)user_data;
+  GstPromise* answer_promise;
+
+  printf("on_offer_set.\n");
+
+  if (!is_promise_ok (promise, "set the remote description")) {
+    gst_promise_unref (promise);
+    queue_offer_completion (offer);
+    return;
+  }
+
+  gst_promise_unref (promise);
+
+  answer_promise = gst_promise_new_with_change_func (on_answer_created, offer, NULL);
+  g_signal_emit_by_name (offer->webrtcbin, "create-answer", NULL, answer_promise);
+}
+
+/* Answer created by our pipeline, to be sent to the peer */
+static void on_answer_created (GstPromise* promise, gpointer user_data)
+{
+  struct offer_request* offer = (struct offer_request*)user_data;
+  GstWebRTCSessionDescription* answer = NULL;
+  GstPromise* set_local_promise;
+
+  printf("on_answer_created.\n");
+
+  if (is_promise_ok (promise, "create the answer")) {
+    gst_structure_get (gst_promise_get_reply (promise), "answer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer, NULL);
+  }
+  gst_promise_unref (promise);
+
+  if (answer == NULL) {
+    queue_offer_completion (offer);
+    return;
+  }
+
+  /* The answer is only returned once it has been applied, so the remote
+  * peer's checks can't arrive before the webrtcbin is ready for them. */
+  offer->answer_sdp = gst_sdp_message_as_text (answer->sdp);
+
+  set_local_promise = gst_promise_new_with_change_func (on_local_description_set, offer, NULL);
+  g_signal_emit_by_name (offer->webrtcbin, "set-local-description", answer, set_local_promise);
+
+  gst_webrtc_session_description_free (answer);
+}
+
+static void on_local_description_set (GstPromise* promise, gpointer user_data)
+{
+  struct offer_request* offer = (struct offer_request*)user_data;
+
+  printf("on_local_description_set.\n");
+
+  if (!is_promise_ok (promise, "set the local description")) {
+    g_free (offer->answer_sdp);
+    offer->answer_sdp = NULL;
+  }
+
+  gst_promise_unref (promise);
+  queue_offer_completion (offer);
+}
+
+/**
+* Hands a finished offer back to the libevent thread. Called from the
+* webrtcbin's threads.
+*/
+static void queue_offer_completion(struct offer_request* offer)
+{
+  g_async_queue_push(_offer_completions, offer);
+
+  /* A full socket buffer already means a wake up is pending. */
+  send(_offer_completion_notify[1], "c", 1, 0);
+}
+
+/**
+* Replies to the offers that have finished since the libevent thread was last woken.
+*/
+static void on_offer_completions(evutil_socket_t fd, short events, void* arg)
+{
+  char drain[64];
+  struct offer_request* offer;
+
+  while (recv(fd, drain, sizeof(drain), 0) > 0) {}
+
+  while ((offer = g_async_queue_try_pop(_offer_completions)) != NULL) {
+    complete_offer(offer);
+  }
+}
+
+/**
+* The client went away while its offer was being answered.
+*/
+static void on_offer_connection_closed(struct evhttp_connection* evcon, void* arg)
+{
+  ((struct offer_request*)arg)->req = NULL;
+}
+
+/**
+* Sends the reply for a finished offer and frees it. A pipeline whose offer
+* failed, or whose client has gone, is shut down. Runs on the libevent thread.
+*/
+static void complete_offer(struct offer_request* offer)
+{
+  if (offer->req != NULL) {
+    evhttp_connection_set_closecb(evhttp_request_get_connection(offer->req), NULL, NULL);
+
+    if (offer->answer_sdp != NULL) {
+      record_offer_latency(offer->start_time);
+    }
+
+    if (offer->is_whip) {
+      send_whip_answer(offer);
+    }
+    else {
+      send_offer_answer(offer);
+    }
+  }
+
+  if (offer->req == NULL || offer->answer_sdp == NULL) {
+    stop_pipeline(offer->webrtcbin);
+  }
+
+  gst_object_unref(offer->webrtcbin);
+  g_free(offer->answer_sdp);
+  g_free(offer);
+}
+
+static void on_negotiation_needed (GstElement* element, gpointer user_data)
+{
+  gchar* name;
+  GstWebRTCSignalingState signalingState = 0;
+  GstWebRTCSessionDescription* remoteDescription = NULL;
+
+  printf("on_negotiation_needed\n");
+
+  g_object_get (G_OBJECT (element), "name", &name, NULL);
+  g_print ("The name of the element is '%s'.\n", name);
+  g_free (name);
+
+  g_object_get (G_OBJECT (element), "signaling-state", &signalingState, NULL);
+  g_print ("The signaling state of the element is '%d'.\n", signalingState);
+
+  g_object_get (G_OBJECT (element), "remote-description", &remoteDescription, NULL);
+  if (remoteDescription == NULL) {
+    g_print("Remote description is not set.\n");
+  }
+  else {
+    g_print("Remote description is set.\n");
+  }
+}
+
+static void send_ice_candidate_message (GstElement* webrtc G_GNUC_UNUSED, guint mlineindex,
+  gchar* candidate, gpointer user_data G_GNUC_UNUSED)
+{
+  //printf("send_ice_candidate_message\n");
+}
+
+static void on_new_transceiver (GstElement* object, GstWebRTCRTPTransceiver* candidate, gpointer udata)
+{
+  g_print("on_new_transceiver.\n");
+}
+
+/**
+* Echoes a peer's incoming video back to it. The first VP8 stream the
+* webrtcbin receives is linked to the echo depayloader, which gives the echo
+* its own SSRC and sequence numbers without touching the frames. Any other
+* stream is discarded.
+*/
+static void on_incoming_pad (GstElement* webrtcbin, GstPad* pad, gpointer user_data)
+{
+  GstElement* pipeline = GST_ELEMENT_PARENT (webrtcbin);
+  GstElement* depay;
+  GstElement* fakesink;
+  GstPad* sink_pad;
+  GstCaps* caps;
+  gboolean is_vp8 = FALSE;
+
+  if (GST_PAD_DIRECTION (pad) != GST_PAD_SRC) {
+    return;
+  }
+
+  caps = gst_pad_get_current_caps (pad);
+  if (caps == NULL) {
+    caps = gst_pad_query_caps (pad, NULL);
+  }
+  if (caps != NULL) {
+    is_vp8 = gst_caps_get_size (caps) > 0 &&
+      g_strcmp0 (gst_structure_get_string (gst_caps_get_structure (caps, 0), "encoding-name"), "VP8") == 0;
+    gst_caps_unref (caps);
+  }
+
+  depay = gst_bin_get_by_name (GST_BIN (pipeline), "echodepay");
+  sink_pad = gst_element_get_static_pad (depay, "sink");
+  gst_object_unref (depay);
+
+  if (is_vp8 && !gst_pad_is_linked (sink_pad) && gst_pad_link (pad, sink_pad) == GST_PAD_LINK_OK) {
+    g_print ("Echoing incoming VP8 stream.\n");
+
+    /* Nothing can be decoded from the echo until the peer sends a keyframe, ask for one now. */
+    gst_pad_push_event (sink_pad, gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE, TRUE, 0));
+  }
+  else {
+    /* An unlinked pad would stop the webrtcbin's other streams. */
+    fakesink = gst_element_factory_make ("fakesink", NULL);
+    g_object_set (fakesink, "async", FALSE, "sync", FALSE, NULL);
+    gst_bin_add (GST_BIN (pipeline), fakesink);
+    gst_element_sync_state_with_parent (fakesink);
+    gst_element_link_pads (webrtcbin, GST_PAD_NAME (pad), fakesink, "sink");
+  }
+
+  gst_object_unref (sink_pad);
+}
+
+static void on_ice_gathering_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data)
+{
+  GstWebRTCICEGatheringState ice_gathering_state = 0;
+  g_object_get (G_OBJECT (webrtcbin), "ice-gathering-state", &ice_gathering_state, NULL);
+  g_print ("on_ice_gathering_state_notify '%d'.\n", ice_gathering_state);
+}
+
+static void on_ice_connection_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data)
+{
+  GstWebRTCICEConnectionState ice_connection_state = 0;
+  g_object_get (G_OBJECT (webrtcbin), "ice-connection-state", &ice_connection_state, NULL);
+  g_print ("on_ice_connection_state_notify '%d'.\n", ice_connection_state);
+}
+
+static void on_connection_state_notify (GstElement* webrtcbin, GParamSpec* pspec, gpointer user_data)
+{
+  GstWebRTCPeerConnectionState connection_state = 0;
+  struct session* session;
+
+  g_object_get (G_OBJECT (webrtcbin), "connection-state", &connection_state, NULL);
+  g_print ("on_connection_state_notify '%d'.\n", connection_state);
+
+  /* The pipeline can't be shut down from one of its own threads, the session
+  * timer does it on the libevent thread. */
+  g_mutex_lock (&_sessions_mutex);
+  session = g_hash_table_lookup (_sessions, webrtcbin);
+  if (session != NULL) {
+    session->connection_state = connection_state;
+    session->state_changed_at = g_get_monotonic_time ();
+  }
+  g_mutex_unlock (&_sessions_mutex);
+
+  /* A broadcast peer joins the stream part way through, it can't decode
+  * anything until the next keyframe. */
+  if (connection_state == GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTED) {
+    request_broadcast_peer_keyframe (webrtcbin);
+  }
+}
+
+static gboolean bus_call (GstBus* bus, GstMessage* msg, gpointer data)
+{
+  //GMainLoop* loop = (GMainLoop*)data;
+
+  //g_print("bus_call %d.\n", GST_MESSAGE_TYPE (msg));
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+
+  case GST_MESSAGE_EOS:
+    g_print ("End of stream\n");
+    //g_main_loop_quit (loop);
+    break;
+
+  case GST_MESSAGE_ERROR: {
+    gchar* debug;
+    GError* error;
+
+    gst_message_parse_error (msg, &error, &debug);
+    g_free (debug);
+
+    g_printerr ("Error: %s\n", error->message);
+    g_error_free (error);
+
+    //g_main_loop_quit (loop);
+    break;
+  }
+  default:
+    break;
+  }
+
+  return TRUE;
+}
+
+/**
+* A pipeline can be stopped by its connection failing or by a WHIP DELETE,
+* only the first caller gets to stop it.
+* @@Returns TRUE if the caller should stop the pipeline.
+*/
+static gboolean claim_pipeline_stop(GstElement* webrtcbin)
+{
+  return g_object_replace_data(G_OBJECT(webrtcbin), "echo-stopped", NULL, GINT_TO_POINTER(1), NULL, NULL);
+}
+
+/**
+* Shuts down a session's pipeline, unless something else already has.
+* Runs on the libevent thread.
+*/
+static void stop_pipeline(GstElement* webrtcbin)
+{
+  if (!claim_pipeline_stop(webrtcbin)) {
+    return;
+  }
+
+  g_mutex_lock(&_sessions_mutex);
+  g_hash_table_remove(_sessions, webrtcbin);
+  g_mutex_unlock(&_sessions_mutex);
+
+  destroy_webrtc(webrtcbin);
+  g_atomic_int_dec_and_test(&_active_pipelines);
+}
+
+/**
+* Adds a pipeline that has just been set playing to the session registry.
+*/
+static void register_session(GstElement* webrtcbin)
+{
+  struct session* session = g_new0(struct session, 1);
+
+  session->webrtcbin = webrtcbin;
+  session->connection_state = GST_WEBRTC_PEER_CONNECTION_STATE_NEW;
+  session->created_at = g_get_monotonic_time();
+  session->state_changed_at = session->created_at;
+
+  g_mutex_lock(&_sessions_mutex);
+  g_hash_table_insert(_sessions, webrtcbin, session);
+  g_mutex_unlock(&_sessions_mutex);
+}
+
+/**
+* Checks whether a new offer would take the server over --max-sessions, and
+* counts it as rejected if so.
+* @@Returns TRUE if the offer should be refused.
+*/
+static gboolean is_at_session_limit()
+{
+  if (_max_sessions > 0 && g_atomic_int_get(&_active_pipelines) >= _max_sessions) {
+    g_atomic_int_inc(&_sessions_rejected);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/**
+* Whether a session is finished with, either by its connection state or by
+* having sat too long without connecting.
+*/
+static gboolean is_session_expired(struct session* session, gint64 now)
+{
+  switch (session->connection_state) {
+  case GST_WEBRTC_PEER_CONNECTION_STATE_FAILED:
+  case GST_WEBRTC_PEER_CONNECTION_STATE_CLOSED:
+    return TRUE;
+  case GST_WEBRTC_PEER_CONNECTION_STATE_DISCONNECTED:
+    /* Disconnected can recover on its own if the peer's network comes back. */
+    return now - session->state_changed_at >= (gint64)SESSION_DISCONNECTED_GRACE_SECONDS * G_USEC_PER_SEC;
+  case GST_WEBRTC_PEER_CONNECTION_STATE_NEW:
+  case GST_WEBRTC_PEER_CONNECTION_STATE_CONNECTING:
+    if (_session_timeout_seconds > 0 && now - session->created_at >= (gint64)_session_timeout_seconds * G_USEC_PER_SEC) {
+      g_atomic_int_inc(&_sessions_timed_out);
+      return TRUE;
+    }
+    return FALSE;
+  default:
+    return FALSE;
+  }
+}
+
+static gboolean is_whip_resource_stopped(gpointer key, gpointer value, gpointer user_data)
+{
+  return g_object_get_data(G_OBJECT(((struct whip_resource*)value)->webrtcbin), "echo-stopped") != NULL;
+}
+
+/**
+* Tears down every session that has ended or timed out, along with any WHIP
+* resources left pointing at them.
+*/
+static void on_session_timer(evutil_socket_t fd, short events, void* arg)
+{
+  GPtrArray* expired = g_ptr_array_new_with_free_func(gst_object_unref);
+  gint64 now = g_get_monotonic_time();
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+
+  g_mutex_lock(&_sessions_mutex);
+  g_hash_table_iter_init(&iter, _sessions);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    if (is_session_expired((struct session*)value, now)) {
+      g_ptr_array_add(expired, gst_object_ref(((struct session*)value)->webrtcbin));
+    }
+  }
+  g_mutex_unlock(&_sessions_mutex);
+
+  for (i = 0; i < expired->len; i++) {
+    printf("Session ended, shutting down pipeline.\n");
+    g_atomic_int_inc(&_sessions_ended);
+    stop_pipeline(g_ptr_array_index(expired, i));
+  }
+
+  if (expired->len > 0) {
+    g_hash_table_foreach_remove(_whip_resources, is_whip_resource_stopped, NULL);
+  }
+
+  g_ptr_array_unref(expired);
+}
+
+/**
+* Tears down whatever sessions are still running at exit.
+*/
+static void stop_all_sessions()
+{
+  GList* webrtcbins;
+  GList* item;
+
+  g_mutex_lock(&_sessions_mutex);
+  webrtcbins = g_hash_table_get_keys(_sessions);
+  g_mutex_unlock(&_sessions_mutex);
+
+  for (item = webrtcbins; item != NULL; item = item->next) {
+    stop_pipeline(item->data);
+  }
+
+  g_list_free(webrtcbins);
+}
+
+/**
+* Reads a numeric field, such as Threads or VmRSS (in KB), from /proc/self/status.
+* @@Returns the field's value or -1 if it isn't available.
+*/
+static gint64 read_process_status(const char* field)
+{
+  FILE* status = fopen("/proc/self/status", "r");
+  size_t field_len = strlen(field);
+  gint64 value = -1;
+  char line[256];
+
+  if (status == NULL) {
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), status) != NULL) {
+    if (strncmp(line, field, field_len) == 0 && line[field_len] == ':') {
+      value = g_ascii_strtoll(line + field_len + 1, NULL, 10);
+      break;
+    }
+  }
+
+  fclose(status);
+  return value;
+}
+
+static void free_whip_resource(gpointer data)
+{
+  struct whip_resource* resource = (struct whip_resource*)data;
+
+  gst_object_unref(resource->webrtcbin);
+  g_free(resource->etag);
+  g_free(resource);
+}
+
+static gboolean has_content_type(struct evhttp_request* req, const char* content_type)
+{
+  const char* header = evhttp_find_header(req->input_headers, "Content-Type");
+  size_t length = strlen(content_type);
+
+  /* Any parameters after the media type are ignored. */
+  return header != NULL && g_ascii_strncasecmp(header, content_type, length) == 0 &&
+    (header[length] == '\0' || header[length] == ';' || header[length] == ' ');
+}
+
+static gchar* copy_request_body(struct evhttp_request* req)
+{
+  struct evbuffer* http_req_body = evhttp_request_get_input_buffer(req);
+  size_t http_req_body_len = evbuffer_get_length(http_req_body);
+  gchar* body = g_malloc(http_req_body_len + 1);
+
+  evbuffer_copyout(http_req_body, body, http_req_body_len);
+  body[http_req_body_len] = '\0';
+
+  return body;
+}
+
+static void send_text_reply(struct evhttp_request* req, int code, const char* reason, const char* text)
+{
+  struct evbuffer* resp_buffer = evbuffer_new();
+
+  evbuffer_add_printf(resp_buffer, "%s", text);
+  evhttp_send_reply(req, code, reason, resp_buffer);
+  evbuffer_free(resp_buffer);
+}
+
+/**
+* The handler function for a WHIP offer. The body is the raw SDP offer and the
+* response the raw SDP answer, along with the URL of the new session's resource.
+* @param[in] req: the HTTP request received from the remote client.
+* @param[in] arg: not used.
+*/
+static void on_whip_request_cb(struct evhttp_request* req, void* arg)
+{
+  gchar* offer_sdp;
+  GstElement* webrtcbin;
+  gint64 start_time = g_get_monotonic_time();
+
+  printf("Received WHIP request for %s.\n", evhttp_request_get_uri(req));
+
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+
+  if (req->type == EVHTTP_REQ_OPTIONS) {
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Methods", "POST, OPTIONS");
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Headers", "content-type");
+    evhttp_add_header(req->output_headers, "Accept-Post", SDP_CONTENT_TYPE);
+    evhttp_send_reply(req, 204, "No Content", NULL);
+    return;
+  }
+
+  if (req->type != EVHTTP_REQ_POST) {
+    evhttp_add_header(req->output_headers, "Allow", "POST, OPTIONS");
+    evhttp_send_reply(req, 405, "Method Not Allowed", NULL);
+    return;
+  }
+
+  if (g_atomic_int_get(&_is_draining)) {
+    evhttp_add_header(req->output_headers, "Retry-After", DRAIN_RETRY_AFTER_SECONDS);
+    evhttp_add_header(req->output_headers, "Connection", "close");
+    evhttp_send_reply(req, 503, "Service Unavailable", NULL);
+    return;
+  }
+
+  if (is_at_session_limit()) {
+    evhttp_add_header(req->output_headers, "Retry-After", SESSION_LIMIT_RETRY_AFTER_SECONDS);
+    evhttp_send_reply(req, 503, "Service Unavailable", NULL);
+    return;
+  }
+
+  if (!has_content_type(req, SDP_CONTENT_TYPE)) {
+    send_text_reply(req, 415, "Unsupported Media Type", "Content type must be " SDP_CONTENT_TYPE ".");
+    return;
+  }
+
+  offer_sdp = copy_request_body(req);
+
+  if (offer_sdp[0] == '\0') {
+    send_text_reply(req, 400, "Bad Request", "Request was missing the SDP offer.");
+    g_free(offer_sdp);
+    return;
+  }
+
+  webrtcbin = create_webrtc();
+  if (webrtcbin == NULL) {
+    send_text_reply(req, 500, "Internal Server Error", "Failed to initialise webrtc peer connection.");
+    g_free(offer_sdp);
+    return;
+  }
+
+  /* The reply is sent by send_whip_answer once the answer is ready. */
+  answer_offer(req, webrtcbin, offer_sdp, strlen(offer_sdp), TRUE, start_time);
+  g_free(offer_sdp);
+}
+
+/**
+* Replies to a /offer request with its JSON answer, written straight into the
+* response buffer.
+*/
+static void send_offer_answer(struct offer_request* offer)
+{
+  struct evhttp_request* req = offer->req;
+  struct evbuffer* resp_buffer;
+
+  if (offer->answer_sdp == NULL) {
+    send_text_reply(req, 501, "Internal Server Error", "Failed to get webrtc SDP answer.");
+    return;
+  }
+
+  if (_is_verbose) {
+    printf("Return SDP answer to client: %s.\n", offer->answer_sdp);
+  }
+  else {
+    printf("Return SDP answer to client, length %zu.\n", strlen(offer->answer_sdp));
+  }
+
+  resp_buffer = evbuffer_new();
+  evbuffer_add(resp_buffer, "{\"type\":\"answer\",\"sdp\":", strlen("{\"type\":\"answer\",\"sdp\":"));
+  add_json_string(resp_buffer, offer->answer_sdp);
+  evbuffer_add(resp_buffer, "}", 1);
+
+  evhttp_add_header(req->output_headers, "Content-type", "application/json");
+  evhttp_send_reply(req, 200, "OK", resp_buffer);
+  evbuffer_free(resp_buffer);
+}
+
+static const char* skip_json_whitespace(const char* pos, const char* end)
+{
+  while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')) {
+    pos++;
+  }
+  return pos;
+}
+
+/**
+* Skips a JSON string starting at its opening quote.
+* @@Returns the position after the closing quote, or NULL if it's unterminated.
+*/
+static const char* skip_json_string(const char* pos, const char* end)
+{
+  for (pos++; pos < end; pos++) {
+    if (*pos == '\\') {
+      pos++;
+    }
+    else if (*pos == '"') {
+      return pos + 1;
+    }
+  }
+  return NULL;
+}
+
+/**
+* Skips any JSON value. Nested objects and arrays are only checked for
+* balanced brackets, they're never needed.
+* @@Returns the position after the value, or NULL if it's malformed.
+*/
+static const char* skip_json_value(const char* pos, const char* end)
+{
+  int depth = 0;
+
+  do {
+    if (pos >= end) {
+      return NULL;
+    }
+    else if (*pos == '"') {
+      pos = skip_json_string(pos, end);
+      if (pos == NULL) {
+        return NULL;
+      }
+    }
+    else if (*pos == '{' || *pos == '[') {
+      depth++;
+      pos++;
+    }
+    else if (*pos == '}' || *pos == ']') {
+      if (--depth < 0) {
+        return NULL;
+      }
+      pos++;
+    }
+    else if (depth > 0) {
+      pos++;
+    }
+    else {
+      /* A number, true, false or null. */
+      while (pos < end && *pos != ',' && *pos != '}' && *pos != ']' &&
+        *pos != ' ' && *pos != '\t' && *pos != '\r' && *pos != '\n') {
+        pos++;
+      }
+    }
+  } while (depth > 0);
+
+  return pos;
+}
+
+static int parse_hex4(const char* pos)
+{
+  int value = 0;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    value <<= 4;
+    if (pos[i] >= '0' && pos[i] <= '9') {
+      value |= pos[i] - '0';
+    }
+    else if (pos[i] >= 'a' && pos[i] <= 'f') {
+      value |= pos[i] - 'a' + 10;
+    }
+    else if (pos[i] >= 'A' && pos[i] <= 'F') {
+      value |= pos[i] - 'A' + 10;
+    }
+    else {
+      return -1;
+    }
+  }
+
+  return value;
+}
+
+/**
+* Unescapes the JSON string starting at the opening quote at pos, in place.
+* An escape is never shorter than what it stands for, so the output never
+* overtakes the input.
+* @@Returns the start of the unescaped string and sets its length, or NULL if
+* the string is malformed.
+*/
+static char* unescape_json_string(char* pos, const char* end, size_t* value_len)
+{
+  char* start = pos + 1;
+  char* out = start;
+  int code_point, low;
+
+  for (pos = start; pos < end && *pos != '"'; pos++) {
+    if (*pos != '\\') {
+      *out++ = *pos;
+      continue;
+    }
+
+    if (++pos >= end) {
+      return NULL;
+    }
+
+    switch (*pos) {
+    case '"': *out++ = '"'; break;
+    case '\\': *out++ = '\\'; break;
+    case '/': *out++ = '/'; break;
+    case 'b': *out++ = '\b'; break;
+    case 'f': *out++ = '\f'; break;
+    case 'n': *out++ = '\n'; break;
+    case 'r': *out++ = '\r'; break;
+    case 't': *out++ = '\t'; break;
+    case 'u':
+      if (end - pos < 5 || (code_point = parse_hex4(pos + 1)) < 0) {
+        return NULL;
+      }
+      pos += 4;
+
+      /* A surrogate pair is two escapes, 12 characters for at most 4 bytes of UTF-8. */
+      if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+        if (end - pos < 7 || pos[1] != '\\' || pos[2] != 'u' || (low = parse_hex4(pos + 3)) < 0xDC00 || low > 0xDFFF) {
+          return NULL;
+        }
+        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        pos += 6;
+      }
+
+      out += g_unichar_to_utf8((gunichar)code_point, out);
+      break;
+    default:
+      return NULL;
+    }
+  }
+
+  if (pos >= end) {
+    return NULL;
+  }
+
+  *value_len = (size_t)(out - start);
+  return start;
+}
+
+/**
+* Finds a string member of a top level JSON object, such as the sdp of an
+* offer, and unescapes it in place in a single pass over the JSON. Other
+* members are skipped without being parsed.
+* @param[in] json: the JSON, which is modified. It needn't be null terminated.
+* @param[in] json_len: the length of the JSON.
+* @param[in] key: the member's name, it can't contain escapes.
+* @param[out] value_len: the length of the unescaped string.
+* @@Returns the unescaped string, not null terminated, or NULL if there's no
+* such string member or the JSON is malformed.
+*/
+static char* extract_json_string(char* json, size_t json_len, const char* key, size_t* value_len)
+{
+  const char* end = json + json_len;
+  const char* pos;
+  const char* name;
+  size_t key_len = strlen(key);
+  gboolean is_key;
+
+  if (json == NULL) {
+    return NULL;
+  }
+
+  pos = skip_json_whitespace(json, end);
+  if (pos >= end || *pos != '{') {
+    return NULL;
+  }
+
+  pos = skip_json_whitespace(pos + 1, end);
+  if (pos < end && *pos == '}') {
+    return NULL;
+  }
+
+  while (pos < end && *pos == '"') {
+    name = pos + 1;
+    pos = skip_json_string(pos, end);
+    if (pos == NULL) {
+      return NULL;
+    }
+    is_key = (size_t)(pos - 1 - name) == key_len && memcmp(name, key, key_len) == 0;
+
+    pos = skip_json_whitespace(pos, end);
+    if (pos >= end || *pos != ':') {
+      return NULL;
+    }
+    pos = skip_json_whitespace(pos + 1, end);
+
+    if (is_key) {
+      return pos < end && *pos == '"' ? unescape_json_string(json + (pos - json), end, value_len) : NULL;
+    }
+
+    pos = skip_json_value(pos, end);
+    if (pos == NULL) {
+      return NULL;
+    }
+
+    pos = skip_json_whitespace(pos, end);
+    if (pos >= end || *pos != ',') {
+      return NULL;
+    }
+    pos = skip_json_whitespace(pos + 1, end);
+  }
+
+  return NULL;
+}
+
+/**
+* Writes a string to a buffer as a quoted JSON string. Runs of characters that
+* don't need escaping are added in one go.
+*/
+static void add_json_string(struct evbuffer* buffer, const char* str)
+{
+  const char* run = str;
+  const char* pos;
+
+  evbuffer_add(buffer, "\"", 1);
+
+  for (pos = str; *pos != '\0'; pos++) {
+    if (*pos != '"' && *pos != '\\' && (unsigned char)*pos >= 0x20) {
+      continue;
+    }
+
+    evbuffer_add(buffer, run, pos - run);
+    run = pos + 1;
+
+    switch (*pos) {
+    case '"': evbuffer_add(buffer, "\\\"", 2); break;
+    case '\\': evbuffer_add(buffer, "\\\\", 2); break;
+    case '\n': evbuffer_add(buffer, "\\n", 2); break;
+    case '\r': evbuffer_add(buffer, "\\r", 2); break;
+    case '\t': evbuffer_add(buffer, "\\t", 2); break;
+    default: evbuffer_add_printf(buffer, "\\u%04x", (unsigned char)*pos); break;
+    }
+  }
+
+  evbuffer_add(buffer, run, pos - run);
+  evbuffer_add(buffer, "\"", 1);
+}
+
+/**
+* Replies to a WHIP offer with its raw SDP answer and creates the session's resource.
+*/
+static void send_whip_answer(struct offer_request* offer)
+{
+  struct evhttp_request* req = offer->req;
+  struct whip_resource* resource;
+  struct evbuffer* resp_buffer;
+  gchar* location;
+  gchar* id;
+
+  if (offer->answer_sdp == NULL) {
+    send_text_reply(req, 400, "Bad Request", "Failed to answer the SDP offer.");
+    return;
+  }
+
+  id = g_uuid_string_random();
+  resource = g_new0(struct whip_resource, 1);
+  resource->webrtcbin = gst_object_ref(offer->webrtcbin);
+  resource->etag = g_strdup_printf("\"%08x%08x\"", g_random_int(), g_random_int());
+  g_hash_table_insert(_whip_resources, id, resource);
+
+  location = g_strdup_printf("%s/%s", HTTP_WHIP_URL, id);
+
+  evhttp_add_header(req->output_headers, "Content-Type", SDP_CONTENT_TYPE);
+  evhttp_add_header(req->output_headers, "Location", location);
+  evhttp_add_header(req->output_headers, "ETag", resource->etag);
+  evhttp_add_header(req->output_headers, "Access-Control-Expose-Headers", "Location, ETag");
+
+  resp_buffer = evbuffer_new();
+  evbuffer_add(resp_buffer, offer->answer_sdp, strlen(offer->answer_sdp));
+  evhttp_send_reply(req, 201, "Created", resp_buffer);
+  evbuffer_free(resp_buffer);
+
+  g_free(location);
+}
+
+/**
+* Checks whether an SDP fragment carries ICE credentials different from the
+* remote description's, which would make it an ICE restart.
+*/
+static gboolean is_ice_restart(GstElement* webrtcbin, const gchar* fragment_ufrag)
+{
+  GstWebRTCSessionDescription* remote_description = NULL;
+  const gchar* remote_ufrag = NULL;
+  gboolean is_restart;
+
+  g_object_get(G_OBJECT(webrtcbin), "remote-description", &remote_description, NULL);
+  if (remote_description == NULL) {
+    return FALSE;
+  }
+
+  remote_ufrag = gst_sdp_message_get_attribute_val(remote_description->sdp, "ice-ufrag");
+  if (remote_ufrag == NULL && gst_sdp_message_medias_len(remote_description->sdp) > 0) {
+    remote_ufrag = gst_sdp_media_get_attribute_val(gst_sdp_message_get_media(remote_description->sdp, 0), "ice-ufrag");
+  }
+
+  is_restart = remote_ufrag != NULL && strcmp(remote_ufrag, fragment_ufrag) != 0;
+  gst_webrtc_session_description_free(remote_description);
+
+  return is_restart;
+}
+
+/**
+* Passes the candidates in a trickle ICE SDP fragment (RFC 8840) to the webrtcbin.
+* @@Returns 204 on success, otherwise the HTTP status to reply with.
+*/
+static int add_remote_candidates(GstElement* webrtcbin, const gchar* fragment)
+{
+  gchar** lines = g_strsplit(fragment, "\n", -1);
+  guint mline_index = 0;
+  gint mline_count = 0;
+  int status = 204;
+  gchar** line;
+
+  for (line = lines; *line != NULL && status == 204; line++) {
+    g_strchomp(*line);
+
+    if (g_str_has_prefix(*line, "m=")) {
+      mline_index = mline_count++;
+    }
+    else if (g_str_has_prefix(*line, "a=ice-ufrag:") && is_ice_restart(webrtcbin, *line + strlen("a=ice-ufrag:"))) {
+      status = 501;
+    }
+    else if (g_str_has_prefix(*line, "a=candidate:")) {
+      g_signal_emit_by_name(webrtcbin, "add-ice-candidate", mline_index, *line + strlen("a="));
+    }
+  }
+
+  g_strfreev(lines);
+
+  return status;
+}
+
+/**
+* The handler function for requests on a WHIP session's resource, and for any
+* other path the server doesn't know. A PATCH trickles the remote candidates
+* in its SDP fragment, a DELETE shuts the session's pipeline down.
+* @param[in] req: the HTTP request received from the remote client.
+* @param[in] arg: not used.
+*/
+static void on_whip_resource_request_cb(struct evhttp_request* req, void* arg)
+{
+  const char* path = evhttp_uri_get_path(evhttp_request_get_evhttp_uri(req));
+  struct whip_resource* resource = NULL;
+  const char* if_match;
+  gchar* fragment;
+  int status;
+
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+
+  if (path != NULL && g_str_has_prefix(path, HTTP_WHIP_URL "/")) {
+    resource = g_hash_table_lookup(_whip_resources, path + strlen(HTTP_WHIP_URL "/"));
+  }
+
+  if (resource == NULL) {
+    evhttp_send_reply(req, 404, "Not Found", NULL);
+  }
+  else if (req->type == EVHTTP_REQ_OPTIONS) {
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Methods", "PATCH, DELETE, OPTIONS");
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Headers", "content-type, if-match");
+    evhttp_add_header(req->output_headers, "Accept-Patch", TRICKLE_CONTENT_TYPE);
+    evhttp_send_reply(req, 204, "No Content", NULL);
+  }
+  else if (req->type == EVHTTP_REQ_DELETE) {
+    printf("WHIP session deleted, shutting down pipeline.\n");
+    stop_pipeline(resource->webrtcbin);
+
+    g_hash_table_remove(_whip_resources, path + strlen(HTTP_WHIP_URL "/"));
+    evhttp_send_reply(req, 200, "OK", NULL);
+  }
+  else if (req->type == EVHTTP_REQ_PATCH) {
+    if_match = evhttp_find_header(req->input_headers, "If-Match");
+
+    if (if_match != NULL && strcmp(if_match, "*") != 0 && strcmp(if_match, resource->etag) != 0) {
+      evhttp_send_reply(req, 412, "Precondition Failed", NULL);
+    }
+    else if (!has_content_type(req, TRICKLE_CONTENT_TYPE)) {
+      send_text_reply(req, 415, "Unsupported Media Type", "Content type must be " TRICKLE_CONTENT_TYPE ".");
+    }
+    else {
+      fragment = copy_request_body(req);
+      status = add_remote_candidates(resource->webrtcbin, fragment);
+      g_free(fragment);
+
+      if (status == 204) {
+        evhttp_send_reply(req, 204, "No Content", NULL);
+      }
+      else {
+        send_text_reply(req, 501, "Not Implemented", "ICE restarts are not supported.");
+      }
+    }
+  }
+  else {
+    evhttp_add_header(req->output_headers, "Allow", "PATCH, DELETE, OPTIONS");
+    evhttp_send_reply(req, 405, "Method Not Allowed", NULL);
+  }
+}
+
+static void begin_drain(struct event_base* base)
+{
+  struct timeval interval = { 1, 0 };
+
+  if (g_atomic_int_get(&_is_draining)) {
+    return;
+  }
+
+  g_atomic_int_set(&_is_draining, 1);
+  _drain_deadline = g_get_monotonic_time() + (gint64)_drain_timeout_seconds * G_USEC_PER_SEC;
+
+  printf("Draining, new offers will be refused for up to %ds.\n", _drain_timeout_seconds);
+
+  event_add(_drain_timer, &interval);
+}
+
+static void on_term_signal(evutil_socket_t sig, short events, void* arg)
+{
+  printf("Caught a terminate signal; draining.\n");
+  begin_drain((struct event_base*)arg);
+}
+
+static void on_drain_timer(evutil_socket_t fd, short events, void* arg)
+{
+  struct event_base* base = (struct event_base*)arg;
+  gint active = g_atomic_int_get(&_active_pipelines);
+
+  if (active <= 0) {
+    printf("Drain complete, no active pipelines.\n");
+    event_base_loopexit(base, NULL);
+  }
+  else if (g_get_monotonic_time() >= _drain_deadline) {
+    printf("Drain timed out with %d active pipelines.\n", active);
+    event_base_loopexit(base, NULL);
+  }
+}
+
+/**
+* A replacement server has connected to the handoff socket. Once it has taken
+* the listening socket this server stops accepting and drains.
+*/
+static void on_handoff_request(evutil_socket_t fd, short events, void* arg)
+{
+  if (_bound_socket == NULL) {
+    return;
+  }
+
+  if (send_listen_socket(fd, evhttp_bound_socket_get_fd(_bound_socket))) {
+    printf("Listening socket handed to the replacement server.\n");
+
+    evhttp_del_accept_socket(_http_svr, _bound_socket);
+    _bound_socket = NULL;
+    event_del(_handoff_event);
+
+    begin_drain((struct event_base*)arg);
+  }
+}
+
+#ifndef _WIN32
+
+static int to_unix_address(const char* path, struct sockaddr_un* addr)
+{
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    fprintf(stderr, "Handoff socket path %s is too long.\n", path);
+    return 0;
+  }
+
+  strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+  return 1;
+}
+
+/**
+* Connects to the handoff socket of a running server, receives its listening
+* socket and starts accepting on it before acknowledging.
+* @@Returns the bound socket or NULL if no server handed one over.
+*/
+static struct evhttp_bound_socket* receive_listen_socket(const char* handoff_path, struct evhttp* http_svr)
+{
+  struct sockaddr_un addr;
+  struct timeval timeout = { HANDOFF_ACK_TIMEOUT_SECONDS, 0 };
+  struct evhttp_bound_socket* bound_socket = NULL;
+  union { struct cmsghdr align; char buf[CMSG_SPACE(sizeof(int))]; } control;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  char data = 0;
+  char ack = HANDOFF_ACK;
+  int listen_socket = -1;
+  int conn;
+
+  if (!to_unix_address(handoff_path, &addr)) {
+    return NULL;
+  }
+
+  conn = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (conn < 0) {
+    return NULL;
+  }
+
+  /* Nothing running is the normal case for the first instance. */
+  if (connect(conn, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(conn);
+    return NULL;
+  }
+
+  setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  iov.iov_base = &data;
+  iov.iov_len = 1;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  if (recvmsg(conn, &msg, 0) > 0) {
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      memcpy(&listen_socket, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+
+  if (listen_socket >= 0) {
+    evutil_make_socket_nonblocking(listen_socket);
+    bound_socket = evhttp_accept_socket_with_handle(http_svr, listen_socket);
+
+    if (bound_socket == NULL) {
+      close(listen_socket);
+    }
+    else if (send(conn, &ack, 1, 0) != 1) {
+      fprintf(stderr, "Failed to acknowledge listening socket handoff, %s.\n", strerror(errno));
+    }
+  }
+  else {
+    fprintf(stderr, "Running server at %s didn't hand over its listening socket.\n", handoff_path);
+  }
+
+  close(conn);
+  return bound_socket;
+}
+
+static evutil_socket_t create_handoff_socket(const char* handoff_path)
+{
+  struct sockaddr_un addr;
+  int handoff_socket;
+
+  if (!to_unix_address(handoff_path, &addr)) {
+    return -1;
+  }
+
+  handoff_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (handoff_socket < 0) {
+    return -1;
+  }
+
+  /* Either stale or belonging to the server this one just took over from. */
+  unlink(handoff_path);
+
+  if (bind(handoff_socket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(handoff_socket, 1) != 0) {
+    fprintf(stderr, "Failed to listen on handoff socket %s, %s.\n", handoff_path, strerror(errno));
+    close(handoff_socket);
+    return -1;
+  }
+
+  evutil_make_socket_nonblocking(handoff_socket);
+  evutil_make_socket_closeonexec(handoff_socket);
+
+  return handoff_socket;
+}
+
+/**
+* Sends the listening socket to a replacement server and waits for it to
+* acknowledge that it's accepting on it.
+* @@Returns 1 if the replacement took the socket, 0 otherwise.
+*/
+static int send_listen_socket(evutil_socket_t handoff_socket, evutil_socket_t listen_socket)
+{
+  struct timeval timeout = { HANDOFF_ACK_TIMEOUT_SECONDS, 0 };
+  union { struct cmsghdr align; char buf[CMSG_SPACE(sizeof(int))]; } control;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr* cmsg;
+  char data = 0;
+  char ack = 0;
+  int is_acked;
+  int conn;
+
+  conn = accept(handoff_socket, NULL, NULL);
+  if (conn < 0) {
+    return 0;
+  }
+
+  iov.iov_base = &data;
+  iov.iov_len = 1;
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &listen_socket, sizeof(int));
+
+  if (sendmsg(conn, &msg, 0) != 1) {
+    fprintf(stderr, "Failed to send listening socket to replacement server, %s.\n", strerror(errno));
+    close(conn);
+    return 0;
+  }
+
+  /* Blocks the event loop, but only for as long as the replacement takes to start accepting. */
+  setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  is_acked = recv(conn, &ack, 1, 0) == 1 && ack == HANDOFF_ACK;
+  close(conn);
+
+  if (!is_acked) {
+    fprintf(stderr, "Replacement server didn't acknowledge the listening socket handoff.\n");
+  }
+
+  return is_acked;
+}
+
+#else
+
+static struct evhttp_bound_socket* receive_listen_socket(const char* handoff_path, struct evhttp* http_svr)
+{
+  return NULL;
+}
+
+static evutil_socket_t create_handoff_socket(const char* handoff_path)
+{
+  fprintf(stderr, "Listening socket handoff is not supported on Windows.\n");
+  return -1;
+}
+
+static int send_listen_socket(evutil_socket_t handoff_socket, evutil_socket_t listen_socket)
+{
+  return 0;
+}
+
+#endif
@@ -0,0 +1,379 @@
+/******************************************************************************
+* Filename: AnswerCache.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "AnswerCache.h"
+
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+
+#define PLACEHOLDER_SESSION_ID "{{session-id}}"
+#define PLACEHOLDER_ICE_UFRAG "{{ice-ufrag}}"
+#define PLACEHOLDER_ICE_PWD "{{ice-pwd}}"
+#define PLACEHOLDER_CNAME "{{cname}}"
+#define PLACEHOLDER_TRACK_PREFIX "{{track:"
+#define PLACEHOLDER_SSRC_PREFIX "{{ssrc:"
+#define PLACEHOLDER_STREAM_PREFIX "{{stream:"
+
+/* Offer lines that differ from one session to the next and don't change the answer. */
+static const char* const kPerSessionOfferLines[] = {
+  "o=",
+  "c=",
+  "a=ice-ufrag:",
+  "a=ice-pwd:",
+  "a=fingerprint:",
+  "a=candidate:",
+  "a=end-of-candidates",
+  "a=msid:",
+  "a=msid-semantic:",
+  "a=ssrc:",
+  "a=rtcp:"
+};
+
+static bool StartsWith(const std::string& line, const char* prefix)
+{
+  return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static std::vector<std::string> SplitLines(const std::string& sdp)
+{
+  std::vector<std::string> lines;
+  std::istringstream stm(sdp);
+  std::string line;
+
+  while (std::getline(stm, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (!line.empty()) {
+      lines.push_back(line);
+    }
+  }
+
+  return lines;
+}
+
+/* Replaces the space separated field at index with value. */
+static std::string ReplaceField(const std::string& line, size_t index, const std::string& value)
+{
+  size_t start = 0;
+  for (size_t i = 0; i < index && start != std::string::npos; i++) {
+    start = line.find(' ', start);
+    if (start != std::string::npos) {
+      start++;
+    }
+  }
+
+  if (start == std::string::npos) {
+    return line;
+  }
+
+  size_t end = line.find(' ', start);
+  return line.substr(0, start) + value + (end == std::string::npos ? "" : line.substr(end));
+}
+
+/* Connection addresses and ports only reflect whatever candidates had been gathered. */
+static std::string NormalizeAddressLine(const std::string& line)
+{
+  if (StartsWith(line, "m=")) {
+    return ReplaceField(line, 1, "9");
+  }
+  else if (StartsWith(line, "c=")) {
+    return "c=IN IP4 0.0.0.0";
+  }
+  else if (StartsWith(line, "a=rtcp:")) {
+    return "a=rtcp:9 IN IP4 0.0.0.0";
+  }
+  return line;
+}
+
+static void ReplaceAll(std::string& str, const std::string& from, const std::string& to)
+{
+  for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())) {
+    str.replace(pos, from.size(), to);
+  }
+}
+
+static void ReplaceTracks(std::string& line, const MidTracks& midTracks)
+{
+  for (size_t i = 0; i < midTracks.size(); i++) {
+    if (!midTracks[i].second.empty()) {
+      ReplaceAll(line, midTracks[i].second, PLACEHOLDER_TRACK_PREFIX + std::to_string(i) + "}}");
+    }
+  }
+}
+
+/* The indexed placeholder for value, the same value always gets the same index. */
+static std::string IndexedPlaceholder(const char* prefix, std::vector<std::string>& values, const std::string& value)
+{
+  size_t index = std::find(values.begin(), values.end(), value) - values.begin();
+  if (index == values.size()) {
+    values.push_back(value);
+  }
+  return prefix + std::to_string(index) + "}}";
+}
+
+/* Replaces the stream id starting at start. An msid of "-" means no stream and
+* "*" in msid-semantic means all of them, neither is per-session. */
+static std::string TemplateStreamId(const std::string& str, size_t start, std::vector<std::string>& streamIds)
+{
+  size_t end = str.find(' ', start);
+  std::string streamId = str.substr(start, end == std::string::npos ? std::string::npos : end - start);
+
+  if (streamId.empty() || streamId == "-" || streamId == "*") {
+    return str;
+  }
+
+  return str.substr(0, start) + IndexedPlaceholder(PLACEHOLDER_STREAM_PREFIX, streamIds, streamId) +
+    (end == std::string::npos ? "" : str.substr(end));
+}
+
+AnswerCache::AnswerCache() :
+  _isEnabled(false),
+  _hits(0),
+  _misses(0),
+  _fallbacks(0)
+{ }
+
+std::string AnswerCache::NormalizeOffer(const std::string& offerSdp)
+{
+  std::string normalized;
+  normalized.reserve(offerSdp.size());
+
+  for (auto& line : SplitLines(offerSdp)) {
+    bool isPerSession = false;
+    for (auto prefix : kPerSessionOfferLines) {
+      if (StartsWith(line, prefix)) {
+        isPerSession = true;
+        break;
+      }
+    }
+
+    if (isPerSession) {
+      continue;
+    }
+    else if (StartsWith(line, "a=ssrc-group:")) {
+      /* Keep the grouping semantics, e.g. FID for RTX, but not the SSRCs. */
+      normalized += line.substr(0, line.find(' ')) + "\n";
+    }
+    else {
+      normalized += NormalizeAddressLine(line) + "\n";
+    }
+  }
+
+  return normalized;
+}
+
+std::shared_ptr<const AnswerTemplate> AnswerCache::Lookup(const std::string& normalizedOffer)
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+
+  auto match = _templates.find(normalizedOffer);
+  if (match == _templates.end()) {
+    _misses++;
+    return nullptr;
+  }
+
+  return match->second;
+}
+
+void AnswerCache::Store(const std::string& normalizedOffer, const std::string& answerSdp, const MidTracks& midTracks)
+{
+  auto answerTemplate = std::make_shared<AnswerTemplate>();
+  answerTemplate->midTracks = midTracks;
+
+  std::string expected;
+  AnswerSessionValues values;
+
+  for (auto& line : SplitLines(answerSdp)) {
+    if (StartsWith(line, "a=candidate:") || StartsWith(line, "a=end-of-candidates")) {
+      continue;
+    }
+
+    std::string normalized = NormalizeAddressLine(line);
+    std::string templated = normalized;
+
+    if (StartsWith(line, "o=")) {
+      std::istringstream fields(line);
+      std::string origin;
+      fields >> origin >> values.sessionId;
+      templated = ReplaceField(line, 1, PLACEHOLDER_SESSION_ID);
+    }
+    else if (StartsWith(line, "a=ice-ufrag:")) {
+      values.iceUfrag = line.substr(strlen("a=ice-ufrag:"));
+      templated = "a=ice-ufrag:" PLACEHOLDER_ICE_UFRAG;
+    }
+    else if (StartsWith(line, "a=ice-pwd:")) {
+      values.icePwd = line.substr(strlen("a=ice-pwd:"));
+      templated = "a=ice-pwd:" PLACEHOLDER_ICE_PWD;
+    }
+    else if (StartsWith(line, "a=ssrc-group:")) {
+      /* a=ssrc-group:<semantics> <ssrc>... */
+      std::istringstream fields(line);
+      std::string ssrc;
+      fields >> templated;
+      while (fields >> ssrc) {
+        templated += " " + IndexedPlaceholder(PLACEHOLDER_SSRC_PREFIX, values.ssrcs, ssrc);
+      }
+    }
+    else if (StartsWith(line, "a=ssrc:")) {
+      /* a=ssrc:<ssrc> <attribute>:<value> */
+      size_t space = line.find(' ');
+      std::string ssrc = line.substr(strlen("a=ssrc:"), space == std::string::npos ? std::string::npos : space - strlen("a=ssrc:"));
+      std::string attribute = (space == std::string::npos) ? "" : line.substr(space);
+
+      if (StartsWith(attribute, " cname:")) {
+        values.cname = attribute.substr(strlen(" cname:"));
+        attribute = " cname:" PLACEHOLDER_CNAME;
+      }
+      else if (StartsWith(attribute, " msid:") || StartsWith(attribute, " mslabel:")) {
+        attribute = TemplateStreamId(attribute, attribute.find(':') + 1, values.streamIds);
+      }
+
+      templated = "a=ssrc:" + IndexedPlaceholder(PLACEHOLDER_SSRC_PREFIX, values.ssrcs, ssrc) + attribute;
+      ReplaceTracks(templated, midTracks);
+    }
+    else if (StartsWith(line, "a=msid:")) {
+      templated = TemplateStreamId(line, strlen("a=msid:"), values.streamIds);
+      ReplaceTracks(templated, midTracks);
+    }
+    else if (StartsWith(line, "a=msid-semantic:")) {
+      /* a=msid-semantic: WMS <stream id>... */
+      std::istringstream fields(line);
+      std::string semantic;
+      std::string streamId;
+      fields >> templated >> semantic;
+      templated += " " + semantic;
+      while (fields >> streamId) {
+        templated += " " + TemplateStreamId(streamId, 0, values.streamIds);
+      }
+    }
+    else {
+      ReplaceTracks(templated, midTracks);
+    }
+
+    expected += normalized + "\r\n";
+    answerTemplate->sdp += templated + "\r\n";
+  }
+
+  answerTemplate->ssrcCount = values.ssrcs.size();
+  answerTemplate->streamIdCount = values.streamIds.size();
+
+  /* Guard against anything the placeholders didn't capture, the template has
+  * to reproduce the answer it came from. */
+  std::string roundTrip;
+  if (values.sessionId.empty() || values.iceUfrag.empty() || values.icePwd.empty() ||
+    (answerTemplate->ssrcCount > 0 && values.cname.empty()) ||
+    !Fill(*answerTemplate, midTracks, values, roundTrip) || roundTrip != expected) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lck(_mtx);
+  if (_templates.size() < ANSWER_CACHE_MAX_ENTRIES) {
+    _templates.emplace(normalizedOffer, answerTemplate);
+  }
+}
+
+bool AnswerCache::Fill(const AnswerTemplate& answerTemplate, const MidTracks& midTracks,
+  const AnswerSessionValues& values, std::string& answerSdp)
+{
+  const MidTracks& templateTracks = answerTemplate.midTracks;
+
+  if (midTracks.size() != templateTracks.size()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < midTracks.size(); i++) {
+    if (midTracks[i].first != templateTracks[i].first ||
+      midTracks[i].second.empty() != templateTracks[i].second.empty()) {
+      return false;
+    }
+  }
+
+  const std::string& sdp = answerTemplate.sdp;
+  answerSdp.clear();
+  answerSdp.reserve(sdp.size() + 128);
+
+  size_t pos = 0;
+  while (pos < sdp.size()) {
+    size_t start = sdp.find("{{", pos);
+    if (start == std::string::npos) {
+      answerSdp.append(sdp, pos, std::string::npos);
+      break;
+    }
+
+    size_t end = sdp.find("}}", start);
+    if (end == std::string::npos) {
+      return false;
+    }
+
+    answerSdp.append(sdp, pos, start - pos);
+    std::string placeholder = sdp.substr(start, end + 2 - start);
+
+    if (placeholder == PLACEHOLDER_SESSION_ID) {
+      answerSdp += values.sessionId;
+    }
+    else if (placeholder == PLACEHOLDER_ICE_UFRAG) {
+      answerSdp += values.iceUfrag;
+    }
+    else if (placeholder == PLACEHOLDER_ICE_PWD) {
+      answerSdp += values.icePwd;
+    }
+    else if (placeholder == PLACEHOLDER_CNAME) {
+      answerSdp += values.cname;
+    }
+    else if (StartsWith(placeholder, PLACEHOLDER_TRACK_PREFIX)) {
+      size_t index = std::stoul(placeholder.substr(strlen(PLACEHOLDER_TRACK_PREFIX)));
+      if (index >= midTracks.size()) {
+        return false;
+      }
+      answerSdp += midTracks[index].second;
+    }
+    else if (StartsWith(placeholder, PLACEHOLDER_SSRC_PREFIX)) {
+      size_t index = std::stoul(placeholder.substr(strlen(PLACEHOLDER_SSRC_PREFIX)));
+      if (index >= values.ssrcs.size()) {
+        return false;
+      }
+      answerSdp += values.ssrcs[index];
+    }
+    else if (StartsWith(placeholder, PLACEHOLDER_STREAM_PREFIX)) {
+      size_t index = std::stoul(placeholder.substr(strlen(PLACEHOLDER_STREAM_PREFIX)));
+      if (index >= values.streamIds.size()) {
+        return false;
+      }
+      answerSdp += values.streamIds[index];
+    }
+    else {
+      return false;
+    }
+
+    pos = end + 2;
+  }
+
+  return true;
+}
+
+void AnswerCache::RecordFallback(const std::string& normalizedOffer)
+{
+  _fallbacks++;
+
+  std::lock_guard<std::mutex> lck(_mtx);
+  _templates.erase(normalizedOffer);
+}
+
+AnswerCacheStats AnswerCache::GetStats()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return { _hits.load(), _misses.load(), _fallbacks.load(), _templates.size() };
+}
@@ -0,0 +1,113 @@
+/******************************************************************************
+* Filename: AnswerCache.h
+*
+* Description:
+* Cache of SDP answers keyed by a normalised form of the offer they answer.
+* Clients of the same browser build send offers that only differ in their
+* per-session fields, ICE credentials, DTLS fingerprint, candidates, SSRCs
+* and msids, and those are exactly the lines normalisation strips out. The
+* first answer for an offer shape is turned into a template with the answer's
+* own per-session fields replaced by placeholders. Later offers with the same
+* shape get an answer by filling in a new session id, new ICE credentials,
+* new SSRCs, CNAME and stream ids, and the new connection's track ids rather
+* than by a full CreateAnswer. The senders take their SSRCs and stream ids
+* from the answer when it's set as the local description.
+*
+* The answers only stay valid while every peer connection uses the same DTLS
+* certificate, PcFactory shares one for that reason.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __ANSWER_CACHE__
+#define __ANSWER_CACHE__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Once full no more shapes are added, a fleet only has a handful. */
+#define ANSWER_CACHE_MAX_ENTRIES 64
+
+/* The mid of each transceiver and the id of the track its sender is echoing. */
+typedef std::vector<std::pair<std::string, std::string>> MidTracks;
+
+struct AnswerTemplate
+{
+  std::string sdp;
+  MidTracks midTracks;
+  size_t ssrcCount = 0;
+  size_t streamIdCount = 0;
+};
+
+/* The per-session values filled into a template, one SSRC and stream id for
+* each of the template's. */
+struct AnswerSessionValues
+{
+  std::string sessionId;
+  std::string iceUfrag;
+  std::string icePwd;
+  std::string cname;
+  std::vector<std::string> ssrcs;
+  std::vector<std::string> streamIds;
+};
+
+struct AnswerCacheStats
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t fallbacks;
+  size_t entries;
+};
+
+class AnswerCache
+{
+public:
+  AnswerCache();
+
+  void SetEnabled(bool isEnabled) { _isEnabled = isEnabled; }
+  bool IsEnabled() const { return _isEnabled; }
+
+  /* The offer with its per-session lines removed, used as the cache key. */
+  static std::string NormalizeOffer(const std::string& offerSdp);
+
+  std::shared_ptr<const AnswerTemplate> Lookup(const std::string& normalizedOffer);
+
+  /* Turns a freshly created answer into a template. The template is only kept
+  * if filling it back in with the answer's own values reproduces the answer. */
+  void Store(const std::string& normalizedOffer, const std::string& answerSdp, const MidTracks& midTracks);
+
+  /* Fills in the per-session fields for a new connection. Returns false if the
+  * connection's transceivers don't line up with the template's. */
+  static bool Fill(const AnswerTemplate& answerTemplate, const MidTracks& midTracks,
+    const AnswerSessionValues& values, std::string& answerSdp);
+
+  /* A filled in answer was applied, only then does a lookup count as a hit. */
+  void RecordHit() { _hits++; }
+
+  /* A filled in answer was rejected, the template is dropped. */
+  void RecordFallback(const std::string& normalizedOffer);
+
+  AnswerCacheStats GetStats();
+
+private:
+  std::atomic<bool> _isEnabled;
+  std::mutex _mtx;
+  std::unordered_map<std::string, std::shared_ptr<const AnswerTemplate>> _templates;
+  std::atomic<uint64_t> _hits;
+  std::atomic<uint64_t> _misses;
+  std::atomic<uint64_t> _fallbacks;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/******************************************************************************
+* Filename: AsyncFileWriter.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "AsyncFileWriter.h"
+#include "Logger.h"
+
+RotatingFile::RotatingFile(const std::string& path, size_t maxFileBytes, size_t maxFiles, const std::string& header) :
+  _path(path),
+  _maxFileBytes(maxFileBytes),
+  _maxFiles(maxFiles),
+  _header(header),
+  _file(nullptr),
+  _fileIndex(0),
+  _fileBytes(0)
+{ }
+
+RotatingFile::~RotatingFile()
+{
+  if (_file != nullptr) {
+    fclose(_file);
+  }
+}
+
+std::string RotatingFile::FilePath(size_t index) const
+{
+  size_t extension = _path.find_last_of("./\\");
+  if (extension == std::string::npos || _path[extension] != '.') {
+    return _path + "." + std::to_string(index);
+  }
+
+  return _path.substr(0, extension) + "." + std::to_string(index) + _path.substr(extension);
+}
+
+bool RotatingFile::Open()
+{
+  std::string filePath = FilePath(_fileIndex);
+
+  _file = fopen(filePath.c_str(), "wb");
+  if (_file == nullptr) {
+    LOG_ERROR("Failed to open " << filePath << " for writing.");
+    return false;
+  }
+
+  if (_fileIndex >= _maxFiles && _maxFiles > 0) {
+    remove(FilePath(_fileIndex - _maxFiles).c_str());
+  }
+
+  fwrite(_header.data(), 1, _header.size(), _file);
+  _fileBytes = _header.size();
+
+  return true;
+}
+
+void RotatingFile::Write(const std::string& data)
+{
+  if (_file != nullptr && _maxFileBytes > 0 && _fileBytes + data.size() > _maxFileBytes) {
+    fclose(_file);
+    _file = nullptr;
+    _fileIndex++;
+  }
+
+  if (_file == nullptr && !Open()) {
+    return;
+  }
+
+  fwrite(data.data(), 1, data.size(), _file);
+  _fileBytes += data.size();
+}
+
+AsyncFileWriter::AsyncFileWriter() :
+  _queuedBytes(0),
+  _running(false),
+  _droppedBytes(0)
+{ }
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+  Stop();
+}
+
+void AsyncFileWriter::Start()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  if (!_running) {
+    _running = true;
+    _writerThread = std::thread(&AsyncFileWriter::Run, this);
+  }
+}
+
+void AsyncFileWriter::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _running = false;
+  }
+  _cv.notify_all();
+
+  if (_writerThread.joinable()) {
+    _writerThread.join();
+  }
+}
+
+bool AsyncFileWriter::Write(std::shared_ptr<RotatingFile> file, std::string data)
+{
+  std::unique_lock<std::mutex> lck(_mtx);
+
+  if (!_running || _queuedBytes + data.size() > ASYNC_FILE_WRITER_MAX_QUEUED_BYTES) {
+    _droppedBytes += data.size();
+    return false;
+  }
+
+  bool wasEmpty = _queue.empty();
+  _queuedBytes += data.size();
+  _queue.emplace_back(std::move(file), std::move(data));
+  lck.unlock();
+
+  if (wasEmpty) {
+    _cv.notify_one();
+  }
+
+  return true;
+}
+
+void AsyncFileWriter::Run()
+{
+  WriteQueue writes;
+  std::unique_lock<std::mutex> lck(_mtx);
+
+  while (_running || !_queue.empty()) {
+    _cv.wait(lck, [this] { return !_running || !_queue.empty(); });
+
+    /* Swap the queue out so the lock isn't held while writing. */
+    writes.swap(_queue);
+    _queuedBytes = 0;
+    lck.unlock();
+
+    for (auto& write : writes) {
+      write.first->Write(write.second);
+    }
+
+    /* Files no longer referenced by their owners get closed here, off the callers' threads. */
+    writes.clear();
+
+    lck.lock();
+  }
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+* Filename: AsyncFileWriter.h
+*
+* Description:
+* Bounded asynchronous writer for diagnostic files. Callers queue data against
+* a RotatingFile and a single background thread does the file I/O, so the
+* media and network threads producing the data never block on the disk. When
+* the queue is full data is dropped and counted rather than letting memory
+* grow or applying back pressure to the caller.
+*
+* A RotatingFile for name.ext writes to name.0.ext, name.1.ext, ... starting a
+* new file once the current one passes its size limit and removing the oldest
+* beyond its file limit. Its header, e.g. a pcap global header, starts every
+* file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __ASYNC_FILE_WRITER__
+#define __ASYNC_FILE_WRITER__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* Data queued beyond this is dropped. */
+#define ASYNC_FILE_WRITER_MAX_QUEUED_BYTES (32 * 1024 * 1024)
+
+class RotatingFile
+{
+public:
+  RotatingFile(const std::string& path, size_t maxFileBytes, size_t maxFiles, const std::string& header = "");
+  ~RotatingFile();
+
+  /* Only called from the writer thread. */
+  void Write(const std::string& data);
+
+private:
+  std::string _path;
+  size_t _maxFileBytes;
+  size_t _maxFiles;
+  std::string _header;
+  FILE* _file;
+  size_t _fileIndex;
+  size_t _fileBytes;
+
+  bool Open();
+  std::string FilePath(size_t index) const;
+};
+
+class AsyncFileWriter
+{
+public:
+  AsyncFileWriter();
+  ~AsyncFileWriter();
+
+  void Start();
+  void Stop();
+
+  /* Returns false if the data was dropped because the queue is full or the
+  * writer isn't running. */
+  bool Write(std::shared_ptr<RotatingFile> file, std::string data);
+
+  uint64_t GetDroppedBytes() const { return _droppedBytes; }
+
+private:
+  typedef std::vector<std::pair<std::shared_ptr<RotatingFile>, std::string>> WriteQueue;
+
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  WriteQueue _queue;
+  size_t _queuedBytes;
+  std::thread _writerThread;
+  bool _running;
+  std::atomic<uint64_t> _droppedBytes;
+
+  void Run();
+};
+
+#endif
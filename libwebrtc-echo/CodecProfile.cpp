@@ -0,0 +1,332 @@
+/******************************************************************************
+* Filename: CodecProfile.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "CodecProfile.h"
+#include "PassthroughVideoCodec.h"
+
+#include <absl/strings/match.h>
+#include <api/audio_codecs/audio_decoder_factory_template.h>
+#include <api/audio_codecs/audio_encoder_factory_template.h>
+#include <api/audio_codecs/g711/audio_decoder_g711.h>
+#include <api/audio_codecs/g711/audio_encoder_g711.h>
+#include <api/audio_codecs/opus/audio_decoder_opus.h>
+#include <api/audio_codecs/opus/audio_encoder_opus.h>
+#include <api/video_codecs/builtin_video_decoder_factory.h>
+#include <api/video_codecs/video_encoder.h>
+#include <media/base/media_constants.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+* Opus encoder factory that applies the profile's complexity, anything else is
+* left to the wrapped factory.
+*/
+class ProfileAudioEncoderFactory :
+  public webrtc::AudioEncoderFactory
+{
+public:
+  ProfileAudioEncoderFactory(rtc::scoped_refptr<webrtc::AudioEncoderFactory> encoderFactory, int opusComplexity) :
+    _encoderFactory(encoderFactory),
+    _opusComplexity(opusComplexity)
+  { }
+
+  std::vector<webrtc::AudioCodecSpec> GetSupportedEncoders() override
+  {
+    return _encoderFactory->GetSupportedEncoders();
+  }
+
+  absl::optional<webrtc::AudioCodecInfo> QueryAudioEncoder(const webrtc::SdpAudioFormat& format) override
+  {
+    return _encoderFactory->QueryAudioEncoder(format);
+  }
+
+  std::unique_ptr<webrtc::AudioEncoder> MakeAudioEncoder(int payloadType, const webrtc::SdpAudioFormat& format,
+    absl::optional<webrtc::AudioCodecPairId> codecPairId) override
+  {
+    if (_opusComplexity >= 0 && absl::EqualsIgnoreCase(format.name, "opus")) {
+      auto config = webrtc::AudioEncoderOpus::SdpToConfig(format);
+      if (config) {
+        config->complexity = _opusComplexity;
+        config->low_rate_complexity = _opusComplexity;
+        return webrtc::AudioEncoderOpus::MakeAudioEncoder(*config, payloadType, codecPairId);
+      }
+    }
+
+    return _encoderFactory->MakeAudioEncoder(payloadType, format, codecPairId);
+  }
+
+private:
+  rtc::scoped_refptr<webrtc::AudioEncoderFactory> _encoderFactory;
+  int _opusComplexity;
+};
+
+/* Applies a codec's thread count and complexity to the wrapped encoder's settings. */
+class ProfileVideoEncoder :
+  public webrtc::VideoEncoder
+{
+public:
+  ProfileVideoEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder, const VideoCodecSettings& settings) :
+    _encoder(std::move(encoder)),
+    _settings(settings)
+  { }
+
+  void SetFecControllerOverride(webrtc::FecControllerOverride* fecControllerOverride) override
+  {
+    _encoder->SetFecControllerOverride(fecControllerOverride);
+  }
+
+  int InitEncode(const webrtc::VideoCodec* codecSettings, const webrtc::VideoEncoder::Settings& settings) override
+  {
+    webrtc::VideoCodec codec = *codecSettings;
+    if (codec.codecType == webrtc::kVideoCodecVP8) {
+      codec.VP8()->complexity = _settings.complexity;
+    }
+
+    webrtc::VideoEncoder::Settings encoderSettings(settings.capabilities,
+      _settings.threads > 0 ? _settings.threads : settings.number_of_cores, settings.max_payload_size);
+
+    return _encoder->InitEncode(&codec, encoderSettings);
+  }
+
+  int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override
+  {
+    return _encoder->RegisterEncodeCompleteCallback(callback);
+  }
+
+  int32_t Release() override
+  {
+    return _encoder->Release();
+  }
+
+  int32_t Encode(const webrtc::VideoFrame& frame, const std::vector<webrtc::VideoFrameType>* frameTypes) override
+  {
+    return _encoder->Encode(frame, frameTypes);
+  }
+
+  void SetRates(const webrtc::VideoEncoder::RateControlParameters& parameters) override
+  {
+    _encoder->SetRates(parameters);
+  }
+
+  void OnPacketLossRateUpdate(float packetLossRate) override
+  {
+    _encoder->OnPacketLossRateUpdate(packetLossRate);
+  }
+
+  void OnRttUpdate(int64_t rttMs) override
+  {
+    _encoder->OnRttUpdate(rttMs);
+  }
+
+  void OnLossNotification(const webrtc::VideoEncoder::LossNotification& lossNotification) override
+  {
+    _encoder->OnLossNotification(lossNotification);
+  }
+
+  webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override
+  {
+    return _encoder->GetEncoderInfo();
+  }
+
+private:
+  std::unique_ptr<webrtc::VideoEncoder> _encoder;
+  VideoCodecSettings _settings;
+};
+
+/* Restricts and orders the wrapped factory's formats to the profile's video codecs. */
+class ProfileVideoEncoderFactory :
+  public webrtc::VideoEncoderFactory
+{
+public:
+  ProfileVideoEncoderFactory(const std::vector<VideoCodecSettings>& codecs,
+    std::unique_ptr<webrtc::VideoEncoderFactory> encoderFactory) :
+    _codecs(codecs),
+    _encoderFactory(std::move(encoderFactory))
+  { }
+
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override
+  {
+    auto available = _encoderFactory->GetSupportedFormats();
+    std::vector<webrtc::SdpVideoFormat> formats;
+
+    for (auto& codec : _codecs) {
+      for (auto& format : available) {
+        if (absl::EqualsIgnoreCase(format.name, codec.name)) {
+          formats.push_back(format);
+        }
+      }
+    }
+
+    return formats;
+  }
+
+  std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(const webrtc::SdpVideoFormat& format) override
+  {
+    auto encoder = _encoderFactory->CreateVideoEncoder(format);
+
+    for (auto& codec : _codecs) {
+      if (encoder && absl::EqualsIgnoreCase(format.name, codec.name)) {
+        return std::make_unique<ProfileVideoEncoder>(std::move(encoder), codec);
+      }
+    }
+
+    return encoder;
+  }
+
+private:
+  std::vector<VideoCodecSettings> _codecs;
+  std::unique_ptr<webrtc::VideoEncoderFactory> _encoderFactory;
+};
+
+static bool ParseVideoCodecs(const std::string& value, std::vector<VideoCodecSettings>& codecs)
+{
+  std::istringstream codecStm(value);
+  std::string codecSpec;
+
+  while (std::getline(codecStm, codecSpec, ',')) {
+    std::istringstream specStm(codecSpec);
+    std::string field;
+    VideoCodecSettings settings;
+
+    std::getline(specStm, settings.name, ':');
+    if (absl::EqualsIgnoreCase(settings.name, "vp8")) {
+      settings.name = cricket::kVp8CodecName;
+    }
+    else if (absl::EqualsIgnoreCase(settings.name, "vp9")) {
+      settings.name = cricket::kVp9CodecName;
+    }
+    else if (absl::EqualsIgnoreCase(settings.name, "h264")) {
+      settings.name = cricket::kH264CodecName;
+    }
+    else {
+      return false;
+    }
+
+    while (std::getline(specStm, field, ':')) {
+      if (field.compare(0, 8, "threads=") == 0) {
+        settings.threads = atoi(field.c_str() + 8);
+      }
+      else if (field == "complexity=normal") {
+        settings.complexity = webrtc::VideoCodecComplexity::kComplexityNormal;
+      }
+      else if (field == "complexity=high") {
+        settings.complexity = webrtc::VideoCodecComplexity::kComplexityHigh;
+      }
+      else if (field == "complexity=higher") {
+        settings.complexity = webrtc::VideoCodecComplexity::kComplexityHigher;
+      }
+      else if (field == "complexity=max") {
+        settings.complexity = webrtc::VideoCodecComplexity::kComplexityMax;
+      }
+      else {
+        return false;
+      }
+    }
+
+    codecs.push_back(settings);
+  }
+
+  return !codecs.empty();
+}
+
+bool ParseCodecProfileOption(int argc, char* argv[], int& i, CodecProfile& profile)
+{
+  bool hasValue = i + 1 < argc;
+
+  if (strcmp(argv[i], "--apm") == 0) {
+    profile.audioProcessing = true;
+  }
+  else if (strcmp(argv[i], "--no-transcode") == 0) {
+    profile.noTranscode = true;
+  }
+  else if (strcmp(argv[i], "--audio-codec") == 0 && hasValue) {
+    std::string codec = argv[++i];
+    if (absl::EqualsIgnoreCase(codec, "opus")) {
+      profile.audioCodec = "opus";
+    }
+    else if (absl::EqualsIgnoreCase(codec, "g711")) {
+      profile.audioCodec = "G711";
+    }
+    else {
+      return false;
+    }
+  }
+  else if (strcmp(argv[i], "--opus-complexity") == 0 && hasValue) {
+    profile.opusComplexity = atoi(argv[++i]);
+    return profile.opusComplexity >= 0 && profile.opusComplexity <= 10;
+  }
+  else if (strcmp(argv[i], "--video-codecs") == 0 && hasValue) {
+    profile.videoCodecs.clear();
+    return ParseVideoCodecs(argv[++i], profile.videoCodecs);
+  }
+  else {
+    return false;
+  }
+
+  return true;
+}
+
+rtc::scoped_refptr<webrtc::AudioEncoderFactory> CreateProfileAudioEncoderFactory(const CodecProfile& profile)
+{
+  if (profile.audioCodec != "opus") {
+    return webrtc::CreateAudioEncoderFactory<webrtc::AudioEncoderG711>();
+  }
+
+  auto encoderFactory = webrtc::CreateAudioEncoderFactory<webrtc::AudioEncoderOpus, webrtc::AudioEncoderG711>();
+  if (profile.opusComplexity < 0) {
+    return encoderFactory;
+  }
+
+  return new rtc::RefCountedObject<ProfileAudioEncoderFactory>(encoderFactory, profile.opusComplexity);
+}
+
+rtc::scoped_refptr<webrtc::AudioDecoderFactory> CreateProfileAudioDecoderFactory(const CodecProfile& profile)
+{
+  if (profile.audioCodec != "opus") {
+    return webrtc::CreateAudioDecoderFactory<webrtc::AudioDecoderG711>();
+  }
+
+  return webrtc::CreateAudioDecoderFactory<webrtc::AudioDecoderOpus, webrtc::AudioDecoderG711>();
+}
+
+rtc::scoped_refptr<webrtc::AudioProcessing> CreateProfileAudioProcessing(const CodecProfile& profile)
+{
+  return profile.audioProcessing ? webrtc::AudioProcessingBuilder().Create() : nullptr;
+}
+
+std::unique_ptr<webrtc::VideoEncoderFactory> CreateProfileVideoEncoderFactory(const CodecProfile& profile,
+  std::unique_ptr<webrtc::VideoEncoderFactory> encoderFactory)
+{
+  if (profile.noTranscode) {
+    return std::make_unique<PassthroughVideoEncoderFactory>();
+  }
+
+  if (profile.videoCodecs.empty()) {
+    return encoderFactory;
+  }
+
+  return std::make_unique<ProfileVideoEncoderFactory>(profile.videoCodecs, std::move(encoderFactory));
+}
+
+std::unique_ptr<webrtc::VideoDecoderFactory> CreateProfileVideoDecoderFactory(const CodecProfile& profile)
+{
+  if (profile.noTranscode) {
+    return std::make_unique<PassthroughVideoDecoderFactory>();
+  }
+
+  return webrtc::CreateBuiltinVideoDecoderFactory();
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+* Filename: CodecProfile.h
+*
+* Description:
+* Runtime selection of the codecs a PcFactory negotiates and how their
+* encoders are configured. The audio codec is Opus or G.711 with an optional
+* Opus complexity, the video codecs are any of VP8, VP9 and H.264 in order
+* of preference, each with an optional encoder thread count and, for VP8, a
+* complexity level. Audio processing can be switched on, and for echo-only
+* deployments the no-transcode option forwards received VP8 frames to the
+* sender without decoding or re-encoding them.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __CODEC_PROFILE__
+#define __CODEC_PROFILE__
+
+#include <api/audio_codecs/audio_decoder_factory.h>
+#include <api/audio_codecs/audio_encoder_factory.h>
+#include <api/scoped_refptr.h>
+#include <api/video_codecs/video_codec.h>
+#include <api/video_codecs/video_decoder_factory.h>
+#include <api/video_codecs/video_encoder_factory.h>
+#include <modules/audio_processing/include/audio_processing.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define CODEC_PROFILE_USAGE \
+  "[--audio-codec opus|g711] [--opus-complexity 0-10] " \
+  "[--video-codecs vp8[:threads=N][:complexity=normal|high|higher|max],vp9,h264] " \
+  "[--apm] [--no-transcode]"
+
+struct VideoCodecSettings
+{
+  /* SDP codec name, VP8, VP9 or H264. */
+  std::string name;
+
+  /* Passed to the encoder as its core count, which the libvpx and OpenH264
+  * wrappers use to pick their thread count. 0 leaves the machine's count. */
+  int threads = 0;
+
+  /* Only the VP8 encoder takes a complexity setting in this WebRTC version. */
+  webrtc::VideoCodecComplexity complexity = webrtc::VideoCodecComplexity::kComplexityNormal;
+};
+
+struct CodecProfile
+{
+  /* "opus" or "G711", G.711 is always offered as the fallback. */
+  std::string audioCodec = "G711";
+
+  /* 0 to 10, -1 leaves the Opus encoder's default. */
+  int opusComplexity = -1;
+
+  /* In order of preference, empty allows every builtin video codec. */
+  std::vector<VideoCodecSettings> videoCodecs;
+
+  bool audioProcessing = false;
+
+  /* Echo received VP8 frames without transcoding them, restricts video to VP8. */
+  bool noTranscode = false;
+};
+
+/* Consumes the codec option at argv[i] and its value. Returns false if argv[i]
+* isn't a codec option or the value is invalid. */
+bool ParseCodecProfileOption(int argc, char* argv[], int& i, CodecProfile& profile);
+
+rtc::scoped_refptr<webrtc::AudioEncoderFactory> CreateProfileAudioEncoderFactory(const CodecProfile& profile);
+rtc::scoped_refptr<webrtc::AudioDecoderFactory> CreateProfileAudioDecoderFactory(const CodecProfile& profile);
+rtc::scoped_refptr<webrtc::AudioProcessing> CreateProfileAudioProcessing(const CodecProfile& profile);
+
+/* Wraps the encoder factory to restrict and order its formats and apply the codec settings. */
+std::unique_ptr<webrtc::VideoEncoderFactory> CreateProfileVideoEncoderFactory(const CodecProfile& profile,
+  std::unique_ptr<webrtc::VideoEncoderFactory> encoderFactory);
+
+std::unique_ptr<webrtc::VideoDecoderFactory> CreateProfileVideoDecoderFactory(const CodecProfile& profile);
+
+#endif
@@ -0,0 +1,284 @@
+/******************************************************************************
+* Filename: CpuPlacement.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "CpuPlacement.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* From numaif.h, which needs libnuma's headers. */
+#define MPOL_PREFERRED_MODE 1
+
+static bool ReadFirstLine(const std::string& path, std::string& line)
+{
+  std::ifstream file(path);
+  return static_cast<bool>(std::getline(file, line));
+}
+
+/* Parses the whole of str as an int, unlike atoi which takes "1x" as 1 and "abc" as 0. */
+static bool ParseInt(const std::string& str, int& value)
+{
+  const char* start = str.c_str();
+  char* end = nullptr;
+
+  errno = 0;
+  long parsed = strtol(start, &end, 10);
+
+  if (end == start || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) {
+    return false;
+  }
+
+  value = static_cast<int>(parsed);
+  return true;
+}
+
+static bool NumaNodeExists(int numaNode)
+{
+  return std::ifstream("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist").good();
+}
+
+PlacementOptionResult ParseCpuPlacementOption(int argc, char* argv[], int& i, CpuPlacementConfig& config)
+{
+  bool hasValue = i + 1 < argc;
+
+  if (strcmp(argv[i], "--numa-nic") == 0 && hasValue) {
+    config.nicInterface = argv[i + 1];
+  }
+  else if (strcmp(argv[i], "--numa-node") == 0 && hasValue) {
+    int numaNode = -1;
+    if (!ParseInt(argv[i + 1], numaNode) || numaNode < 0 || !NumaNodeExists(numaNode)) {
+      return PlacementOptionResult::InvalidValue;
+    }
+    config.numaNode = numaNode;
+  }
+  else if (strcmp(argv[i], "--cpus") == 0 && hasValue) {
+    if (!ParseCpuList(argv[i + 1], config.cpus) || config.cpus.empty()) {
+      return PlacementOptionResult::InvalidValue;
+    }
+  }
+  else {
+    return PlacementOptionResult::NotPlacementOption;
+  }
+
+  i++;
+  return PlacementOptionResult::Ok;
+}
+
+bool ParseCpuList(const std::string& cpuList, std::vector<int>& cpus)
+{
+  std::istringstream ranges(cpuList);
+  std::string range;
+
+  cpus.clear();
+
+  while (std::getline(ranges, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+
+    int first = 0, last = 0;
+    char dash = 0;
+    std::istringstream bounds(range);
+
+    if (!(bounds >> first) || first < 0) {
+      return false;
+    }
+    if (bounds >> dash) {
+      if (dash != '-' || !(bounds >> last) || last < first) {
+        return false;
+      }
+    }
+    else {
+      last = first;
+    }
+
+    /* Anything after the range, e.g. the x in 1-3x, makes the list invalid. */
+    char extra = 0;
+    if (bounds >> extra) {
+      return false;
+    }
+
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return true;
+}
+
+int GetNetworkInterfaceNumaNode(const std::string& interfaceName)
+{
+  std::string line;
+  int numaNode = -1;
+  if (!ReadFirstLine("/sys/class/net/" + interfaceName + "/device/numa_node", line) ||
+    !ParseInt(line, numaNode) || numaNode < 0) {
+    return -1;
+  }
+  return numaNode;
+}
+
+std::vector<int> GetNumaNodeCpus(int numaNode)
+{
+  std::string cpuList;
+  std::vector<int> cpus;
+
+  if (ReadFirstLine("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist", cpuList)) {
+    ParseCpuList(cpuList, cpus);
+  }
+
+  return cpus;
+}
+
+CpuPlacementPlan PlanCpuPlacement(const CpuPlacementConfig& config)
+{
+  CpuPlacementPlan plan;
+
+  if (!config.IsEnabled()) {
+    return plan;
+  }
+
+  int numaNode = config.numaNode;
+  if (numaNode < 0 && !config.nicInterface.empty()) {
+    numaNode = GetNetworkInterfaceNumaNode(config.nicInterface);
+    if (numaNode < 0) {
+      LOG_INFO("No NUMA node found for network interface " << config.nicInterface << ".");
+    }
+  }
+
+  std::vector<int> cpus = (numaNode >= 0) ? GetNumaNodeCpus(numaNode) : std::vector<int>();
+  if (!config.cpus.empty()) {
+    if (cpus.empty()) {
+      cpus = config.cpus;
+    }
+    else {
+      std::vector<int> allowed;
+      std::set_intersection(cpus.begin(), cpus.end(), config.cpus.begin(), config.cpus.end(),
+        std::back_inserter(allowed));
+      cpus = allowed;
+    }
+  }
+
+  if (cpus.empty()) {
+    LOG_ERROR("No cores to place the factory threads on, they'll be left to the scheduler.");
+    return plan;
+  }
+
+  plan.process = { numaNode, cpus };
+  plan.network = plan.process;
+  plan.worker = plan.process;
+  plan.signaling = plan.process;
+
+  /* With enough cores the network and worker threads get one each, nothing
+  * else is scheduled there. */
+  if (cpus.size() >= 3) {
+    plan.network.cpus = { cpus[0] };
+    plan.worker.cpus = { cpus[1] };
+    plan.process.cpus.assign(cpus.begin() + 2, cpus.end());
+    plan.signaling.cpus = plan.process.cpus;
+  }
+
+  return plan;
+}
+
+bool ApplyThreadPlacement(const ThreadPlacement& placement)
+{
+#ifdef __linux__
+  bool isOk = true;
+
+  if (!placement.cpus.empty()) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu : placement.cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpuSet);
+      }
+    }
+
+    if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+      LOG_ERROR("Failed to set CPU affinity, " << strerror(errno) << ".");
+      isOk = false;
+    }
+  }
+
+  if (placement.numaNode >= 0) {
+    /* Preferred rather than bound, allocations fall back to other nodes
+    * instead of failing when the node runs out. */
+    unsigned long nodeMask[4] = { 0 };
+    const unsigned long maskBits = sizeof(nodeMask) * 8;
+
+    if (static_cast<unsigned long>(placement.numaNode) < maskBits) {
+      nodeMask[placement.numaNode / (sizeof(unsigned long) * 8)] |= 1UL << (placement.numaNode % (sizeof(unsigned long) * 8));
+
+      if (syscall(SYS_set_mempolicy, MPOL_PREFERRED_MODE, nodeMask, maskBits + 1) != 0) {
+        LOG_ERROR("Failed to set the memory policy for NUMA node " << placement.numaNode << ", " << strerror(errno) << ".");
+        isOk = false;
+      }
+    }
+  }
+
+  return isOk;
+#else
+  return placement.cpus.empty() && placement.numaNode < 0;
+#endif
+}
+
+std::map<int, uint64_t> GetProcessNumaMemoryKb()
+{
+  std::map<int, uint64_t> memoryKb;
+  std::ifstream numaMaps("/proc/self/numa_maps");
+  std::string line;
+
+  /* Each mapping is a line like:
+  * 7f1c2a000000 default anon=512 dirty=512 N0=384 N1=128 kernelpagesize_kB=4 */
+  while (std::getline(numaMaps, line)) {
+    std::istringstream fields(line);
+    std::string field;
+    std::vector<std::pair<int, uint64_t>> nodePages;
+    uint64_t pageSizeKb = 4;
+
+    while (fields >> field) {
+      if (field.size() > 1 && field[0] == 'N' && isdigit(field[1])) {
+        size_t equals = field.find('=');
+        if (equals != std::string::npos) {
+          nodePages.push_back({ atoi(field.c_str() + 1), strtoull(field.c_str() + equals + 1, nullptr, 10) });
+        }
+      }
+      else if (field.compare(0, 18, "kernelpagesize_kB=") == 0) {
+        pageSizeKb = strtoull(field.c_str() + 18, nullptr, 10);
+      }
+    }
+
+    for (auto& pages : nodePages) {
+      memoryKb[pages.first] += pages.second * pageSizeKb;
+    }
+  }
+
+  return memoryKb;
+}
@@ -0,0 +1,100 @@
+/******************************************************************************
+* Filename: CpuPlacement.h
+*
+* Description:
+* Pins the PcFactory's threads to the cores of one NUMA node, by default the
+* node that owns the network interface the media arrives on. Left to the
+* scheduler the network and worker threads migrate between sockets under
+* load and their packet buffers, SRTP contexts and codec state end up on the
+* wrong node.
+*
+* The network and worker threads each get a core of their own, the signaling
+* thread and everything else in the process share the node's remaining
+* cores. Each placed thread also prefers memory from the node, so what it
+* allocates is local. Threads inherit the placement of the thread that starts
+* them, which keeps the encoder and task queue threads on the node as well.
+*
+* Placement uses sched_setaffinity and set_mempolicy and only works on Linux.
+* Thread migrations and the process's resident memory per node are reported
+* by the StatsCollector to show whether it's working.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __CPU_PLACEMENT__
+#define __CPU_PLACEMENT__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define CPU_PLACEMENT_USAGE "[--numa-nic IFACE] [--numa-node N] [--cpus LIST]"
+
+struct CpuPlacementConfig
+{
+  /* Place the threads on the NUMA node this network interface is attached to. */
+  std::string nicInterface;
+
+  /* Place the threads on this NUMA node, overrides the interface. */
+  int numaNode = -1;
+
+  /* Restrict placement to these cores, e.g. 0-7,16-23. Defaults to all of the node's. */
+  std::vector<int> cpus;
+
+  bool IsEnabled() const { return !nicInterface.empty() || numaNode >= 0 || !cpus.empty(); }
+};
+
+/* The cores a thread may run on and the node it takes memory from, either can be empty. */
+struct ThreadPlacement
+{
+  int numaNode = -1;
+  std::vector<int> cpus;
+};
+
+struct CpuPlacementPlan
+{
+  /* For the thread creating the factory, and so every thread it starts. */
+  ThreadPlacement process;
+  ThreadPlacement network;
+  ThreadPlacement worker;
+  ThreadPlacement signaling;
+};
+
+enum class PlacementOptionResult
+{
+  Ok,
+  NotPlacementOption,
+  InvalidValue
+};
+
+/* Parses one of the CPU_PLACEMENT_USAGE options at argv[i]. i is only moved
+* past the option's value if it's valid. A --numa-node has to be a whole
+* number naming a node under /sys/devices/system/node. */
+PlacementOptionResult ParseCpuPlacementOption(int argc, char* argv[], int& i, CpuPlacementConfig& config);
+
+/* Works out which cores each thread gets. The plan is empty, and nothing is
+* pinned, if placement isn't enabled or the node's cores can't be found. */
+CpuPlacementPlan PlanCpuPlacement(const CpuPlacementConfig& config);
+
+/* Applies a placement to the calling thread. An empty placement is a no-op. */
+bool ApplyThreadPlacement(const ThreadPlacement& placement);
+
+/* -1 if the interface isn't attached to a particular node. */
+int GetNetworkInterfaceNumaNode(const std::string& interfaceName);
+
+std::vector<int> GetNumaNodeCpus(int numaNode);
+
+/* Parses a kernel CPU list such as 0-3,8,10-11. */
+bool ParseCpuList(const std::string& cpuList, std::vector<int>& cpus);
+
+/* Resident memory of the process in KB keyed by NUMA node, from /proc/self/numa_maps. */
+std::map<int, uint64_t> GetProcessNumaMemoryKb();
+
+#endif
@@ -0,0 +1,137 @@
+/******************************************************************************
+* Filename: DataChannelEcho.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "DataChannelEcho.h"
+#include "Logger.h"
+
+#include <rtc_base/time_utils.h>
+
+DataChannelEcho::DataChannelEcho(rtc::scoped_refptr<webrtc::DataChannelInterface> dataChannel) :
+  _dataChannel(dataChannel),
+  _backlogBytes(0)
+{
+  _dataChannel->RegisterObserver(this);
+
+  if (_dataChannel->state() == webrtc::DataChannelInterface::kOpen) {
+    _openedAtUs = rtc::TimeMicros();
+  }
+}
+
+DataChannelEcho::~DataChannelEcho()
+{
+  _dataChannel->UnregisterObserver();
+}
+
+void DataChannelEcho::OnStateChange()
+{
+  auto state = _dataChannel->state();
+
+  LOG_VERBOSE("Data channel " << _dataChannel->label() << " state "
+    << webrtc::DataChannelInterface::DataStateString(state) << ".");
+
+  if (state == webrtc::DataChannelInterface::kOpen) {
+    _openedAtUs = rtc::TimeMicros();
+  }
+  else if (state == webrtc::DataChannelInterface::kClosed) {
+    auto stats = GetStats();
+    LOG_INFO("Data channel " << _dataChannel->label() << " echoed " << stats.messages
+      << " messages, " << stats.bytes << " bytes, " << stats.dropped << " dropped, "
+      << stats.messagesPerSecond << " msg/s, " << stats.bytesPerSecond << " bytes/s, "
+      << "avg echo turnaround " << stats.turnaroundAvgUs << "us.");
+
+    _backlog.clear();
+    _backlogBytes = 0;
+  }
+}
+
+void DataChannelEcho::OnMessage(const webrtc::DataBuffer& buffer)
+{
+  int64_t nowUs = rtc::TimeMicros();
+
+  _messages++;
+  _bytes += buffer.size();
+
+  if (_backlog.empty() &&
+    _dataChannel->buffered_amount() + buffer.size() <= DATA_CHANNEL_ECHO_HIGH_WATER_MARK) {
+    Echo(buffer, nowUs);
+  }
+  else if (_backlogBytes + buffer.size() <= DATA_CHANNEL_ECHO_MAX_BACKLOG) {
+    /* Copying the DataBuffer only takes a reference on its CopyOnWriteBuffer. */
+    _backlog.push_back({ buffer, nowUs });
+    _backlogBytes += buffer.size();
+  }
+  else {
+    _dropped++;
+  }
+}
+
+void DataChannelEcho::OnBufferedAmountChange(uint64_t sent_data_size)
+{
+  if (!_backlog.empty() && _dataChannel->buffered_amount() <= DATA_CHANNEL_ECHO_LOW_WATER_MARK) {
+    DrainBacklog();
+  }
+}
+
+DataChannelEchoStats DataChannelEcho::GetStats() const
+{
+  DataChannelEchoStats stats{};
+
+  stats.messages = _messages.load();
+  stats.bytes = _bytes.load();
+  stats.dropped = _dropped.load();
+  stats.turnaroundSamples = _turnaroundSamples.load();
+  stats.turnaroundMaxUs = _turnaroundMaxUs.load();
+
+  if (stats.turnaroundSamples > 0) {
+    stats.turnaroundAvgUs = static_cast<double>(_turnaroundTotalUs.load()) / stats.turnaroundSamples;
+  }
+
+  int64_t openedAtUs = _openedAtUs.load();
+  int64_t elapsedUs = rtc::TimeMicros() - openedAtUs;
+
+  if (openedAtUs != 0 && elapsedUs > 0) {
+    stats.messagesPerSecond = stats.messages * 1000000.0 / elapsedUs;
+    stats.bytesPerSecond = stats.bytes * 1000000.0 / elapsedUs;
+  }
+
+  return stats;
+}
+
+void DataChannelEcho::Echo(const webrtc::DataBuffer& buffer, int64_t receivedAtUs)
+{
+  if (!_dataChannel->Send(buffer)) {
+    _dropped++;
+    return;
+  }
+
+  int64_t turnaroundUs = rtc::TimeMicros() - receivedAtUs;
+
+  _turnaroundSamples++;
+  _turnaroundTotalUs += turnaroundUs;
+
+  if (turnaroundUs > _turnaroundMaxUs.load()) {
+    _turnaroundMaxUs = turnaroundUs;
+  }
+}
+
+void DataChannelEcho::DrainBacklog()
+{
+  while (!_backlog.empty() &&
+    _dataChannel->buffered_amount() + _backlog.front().buffer.size() <= DATA_CHANNEL_ECHO_HIGH_WATER_MARK) {
+    auto& pending = _backlog.front();
+    _backlogBytes -= pending.buffer.size();
+    Echo(pending.buffer, pending.receivedAtUs);
+    _backlog.pop_front();
+  }
+}
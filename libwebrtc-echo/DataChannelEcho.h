@@ -0,0 +1,90 @@
+/******************************************************************************
+* Filename: DataChannelEcho.h
+*
+* Description:
+* Observer that echoes every message received on a data channel straight back
+* to the sender. The received buffer is re-sent as is, the underlying
+* rtc::CopyOnWriteBuffer is shared rather than copied. If the channel's
+* buffered amount goes above a high water mark messages are parked until the
+* SCTP send buffer drains.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __DATA_CHANNEL_ECHO__
+#define __DATA_CHANNEL_ECHO__
+
+#include <api/data_channel_interface.h>
+#include <api/scoped_refptr.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+
+/* Above this amount of buffered data echoes are queued rather than sent. */
+#define DATA_CHANNEL_ECHO_HIGH_WATER_MARK (1024 * 1024)
+
+/* Once a backlog exists it's only drained when the buffered amount falls below this. */
+#define DATA_CHANNEL_ECHO_LOW_WATER_MARK (256 * 1024)
+
+/* Messages received while the backlog is at this size are dropped. */
+#define DATA_CHANNEL_ECHO_MAX_BACKLOG (8 * 1024 * 1024)
+
+struct DataChannelEchoStats
+{
+  uint64_t messages;
+  uint64_t bytes;
+  uint64_t dropped;
+  double messagesPerSecond;
+  double bytesPerSecond;
+  /* Echo turnaround, the time from a message arriving to its echo being handed
+  * to SCTP. It's the server's share of the round trip a client measures, not a
+  * network round trip time. */
+  uint64_t turnaroundSamples;
+  double turnaroundAvgUs;
+  int64_t turnaroundMaxUs;
+};
+
+class DataChannelEcho :
+  public webrtc::DataChannelObserver
+{
+public:
+  DataChannelEcho(rtc::scoped_refptr<webrtc::DataChannelInterface> dataChannel);
+  ~DataChannelEcho();
+
+  void OnStateChange() override;
+  void OnMessage(const webrtc::DataBuffer& buffer) override;
+  void OnBufferedAmountChange(uint64_t sent_data_size) override;
+
+  DataChannelEchoStats GetStats() const;
+
+private:
+  struct PendingEcho
+  {
+    webrtc::DataBuffer buffer;
+    int64_t receivedAtUs;
+  };
+
+  rtc::scoped_refptr<webrtc::DataChannelInterface> _dataChannel;
+  std::deque<PendingEcho> _backlog;
+  uint64_t _backlogBytes;
+
+  std::atomic<int64_t> _openedAtUs{ 0 };
+  std::atomic<uint64_t> _messages{ 0 };
+  std::atomic<uint64_t> _bytes{ 0 };
+  std::atomic<uint64_t> _dropped{ 0 };
+  std::atomic<uint64_t> _turnaroundSamples{ 0 };
+  std::atomic<int64_t> _turnaroundTotalUs{ 0 };
+  std::atomic<int64_t> _turnaroundMaxUs{ 0 };
+
+  void Echo(const webrtc::DataBuffer& buffer, int64_t receivedAtUs);
+  void DrainBacklog();
+};
+
+#endif
@@ -0,0 +1,60 @@
+/******************************************************************************
+* Filename: EchoFrameTransformer.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "EchoFrameTransformer.h"
+
+void EchoFrameTransformer::Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame)
+{
+  rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback;
+
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto it = _sinkCallbacks.find(frame->GetSsrc());
+    callback = (it != _sinkCallbacks.end()) ? it->second : _callback;
+  }
+
+  if (callback) {
+    _forwardedBytes += frame->GetData().size();
+    _forwardedFrames++;
+
+    /* No transformation, the encoded frame goes straight to the packetiser. */
+    callback->OnTransformedFrame(std::move(frame));
+  }
+}
+
+void EchoFrameTransformer::RegisterTransformedFrameCallback(
+  rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback)
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _callback = callback;
+}
+
+void EchoFrameTransformer::RegisterTransformedFrameSinkCallback(
+  rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback, uint32_t ssrc)
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _sinkCallbacks[ssrc] = callback;
+}
+
+void EchoFrameTransformer::UnregisterTransformedFrameCallback()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _callback = nullptr;
+}
+
+void EchoFrameTransformer::UnregisterTransformedFrameSinkCallback(uint32_t ssrc)
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _sinkCallbacks.erase(ssrc);
+}
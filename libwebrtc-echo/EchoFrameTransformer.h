@@ -0,0 +1,56 @@
+/******************************************************************************
+* Filename: EchoFrameTransformer.h
+*
+* Description:
+* Encoded frame transformer that sits between the encoder and the packetiser
+* of an echo sender, each sender needs its own. Frames are handed straight
+* back to the packetiser unmodified and the number of forwarded bytes and
+* frames is recorded so that the per-connection echo bitrate can be reported.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __ECHO_FRAME_TRANSFORMER__
+#define __ECHO_FRAME_TRANSFORMER__
+
+#include <api/frame_transformer_interface.h>
+#include <api/scoped_refptr.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+class EchoFrameTransformer :
+  public webrtc::FrameTransformerInterface
+{
+public:
+  void Transform(std::unique_ptr<webrtc::TransformableFrameInterface> frame) override;
+
+  /* Audio senders register a single callback, video senders register one per SSRC. */
+  void RegisterTransformedFrameCallback(
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback) override;
+  void RegisterTransformedFrameSinkCallback(
+    rtc::scoped_refptr<webrtc::TransformedFrameCallback> callback, uint32_t ssrc) override;
+  void UnregisterTransformedFrameCallback() override;
+  void UnregisterTransformedFrameSinkCallback(uint32_t ssrc) override;
+
+  uint64_t GetForwardedBytes() const { return _forwardedBytes.load(); }
+  uint64_t GetForwardedFrames() const { return _forwardedFrames.load(); }
+
+private:
+  std::mutex _mtx;
+  rtc::scoped_refptr<webrtc::TransformedFrameCallback> _callback;
+  std::map<uint32_t, rtc::scoped_refptr<webrtc::TransformedFrameCallback>> _sinkCallbacks;
+  std::atomic<uint64_t> _forwardedBytes{ 0 };
+  std::atomic<uint64_t> _forwardedFrames{ 0 };
+};
+
+#endif
@@ -0,0 +1,257 @@
+/******************************************************************************
+* Filename: EventLogCapture.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "EventLogCapture.h"
+#include "Logger.h"
+
+#include <api/rtc_event_log_output.h>
+#include <logging/rtc_event_log/events/rtc_event_rtp_packet_incoming.h>
+#include <logging/rtc_event_log/events/rtc_event_rtp_packet_outgoing.h>
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <string.h>
+
+#define PCAP_LINKTYPE_IPV4 228
+#define PCAP_SNAPLEN 65535
+#define PCAP_LOCAL_ADDRESS 0x0a000001 /* 10.0.0.1, the echo server. */
+#define PCAP_REMOTE_ADDRESS 0x0a000002 /* 10.0.0.2, the remote peer. */
+#define PCAP_LOCAL_PORT 5000
+#define PCAP_REMOTE_PORT 5001
+#define IPV4_UDP_HEADERS_LENGTH 28
+
+/* Packets are batched per connection to keep the writer's queue entries large. */
+#define PCAP_FLUSH_BYTES (32 * 1024)
+
+/* Hands the event log's encoded output to the async writer. */
+class EventLogFileOutput :
+  public webrtc::RtcEventLogOutput
+{
+public:
+  EventLogFileOutput(std::shared_ptr<AsyncFileWriter> writer, std::shared_ptr<RotatingFile> file) :
+    _writer(writer),
+    _file(file)
+  { }
+
+  bool IsActive() const override { return true; }
+
+  bool Write(const std::string& output) override
+  {
+    /* Dropped output is counted by the writer, returning false would stop the log. */
+    _writer->Write(_file, output);
+    return true;
+  }
+
+private:
+  std::shared_ptr<AsyncFileWriter> _writer;
+  std::shared_ptr<RotatingFile> _file;
+};
+
+static void AppendBigEndian(std::string& out, uint32_t value, size_t bytes)
+{
+  for (size_t i = bytes; i > 0; i--) {
+    out.push_back(static_cast<char>((value >> ((i - 1) * 8)) & 0xff));
+  }
+}
+
+template<typename T>
+static void AppendNative(std::string& out, T value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static std::string PcapGlobalHeader()
+{
+  std::string header;
+  AppendNative<uint32_t>(header, 0xa1b2c3d4);
+  AppendNative<uint16_t>(header, 2);
+  AppendNative<uint16_t>(header, 4);
+  AppendNative<int32_t>(header, 0);
+  AppendNative<uint32_t>(header, 0);
+  AppendNative<uint32_t>(header, PCAP_SNAPLEN);
+  AppendNative<uint32_t>(header, PCAP_LINKTYPE_IPV4);
+  return header;
+}
+
+/**
+* Event log that passes every event on to the real one and also records the
+* RTP packet events in a pcap.
+*/
+class CaptureEventLog :
+  public webrtc::RtcEventLog
+{
+public:
+  CaptureEventLog(std::unique_ptr<webrtc::RtcEventLog> eventLog, std::shared_ptr<AsyncFileWriter> writer,
+    std::shared_ptr<RotatingFile> pcapFile) :
+    _eventLog(std::move(eventLog)),
+    _writer(writer),
+    _pcapFile(pcapFile),
+    _utcOffsetUs(rtc::TimeUTCMicros() - rtc::TimeMicros())
+  {
+    _pcapBuffer.reserve(PCAP_FLUSH_BYTES + PCAP_SNAPLEN);
+  }
+
+  ~CaptureEventLog() override
+  {
+    std::lock_guard<std::mutex> lck(_pcapMtx);
+    if (!_pcapBuffer.empty()) {
+      _writer->Write(_pcapFile, std::move(_pcapBuffer));
+    }
+  }
+
+  bool StartLogging(std::unique_ptr<webrtc::RtcEventLogOutput> output, int64_t outputPeriodMs) override
+  {
+    return _eventLog->StartLogging(std::move(output), outputPeriodMs);
+  }
+
+  void StopLogging() override
+  {
+    _eventLog->StopLogging();
+  }
+
+  void StopLogging(std::function<void()> callback) override
+  {
+    _eventLog->StopLogging(std::move(callback));
+  }
+
+  void Log(std::unique_ptr<webrtc::RtcEvent> event) override
+  {
+    if (event->GetType() == webrtc::RtcEvent::Type::RtpPacketIncoming) {
+      auto packet = static_cast<const webrtc::RtcEventRtpPacketIncoming*>(event.get());
+      WritePacket(event->timestamp_us(), packet->RawHeader(), packet->packet_length(), true);
+    }
+    else if (event->GetType() == webrtc::RtcEvent::Type::RtpPacketOutgoing) {
+      auto packet = static_cast<const webrtc::RtcEventRtpPacketOutgoing*>(event.get());
+      WritePacket(event->timestamp_us(), packet->RawHeader(), packet->packet_length(), false);
+    }
+
+    _eventLog->Log(std::move(event));
+  }
+
+private:
+  std::unique_ptr<webrtc::RtcEventLog> _eventLog;
+  std::shared_ptr<AsyncFileWriter> _writer;
+  std::shared_ptr<RotatingFile> _pcapFile;
+  int64_t _utcOffsetUs;
+  std::mutex _pcapMtx;
+  std::string _pcapBuffer;
+
+  void WritePacket(int64_t timestampUs, rtc::ArrayView<const uint8_t> header, size_t packetLength, bool isIncoming)
+  {
+    int64_t utcUs = timestampUs + _utcOffsetUs;
+    size_t capturedLength = IPV4_UDP_HEADERS_LENGTH + header.size();
+    size_t originalLength = IPV4_UDP_HEADERS_LENGTH + packetLength;
+    uint16_t ipLength = static_cast<uint16_t>(std::min<size_t>(originalLength, 0xffff));
+    uint32_t srcAddress = isIncoming ? PCAP_REMOTE_ADDRESS : PCAP_LOCAL_ADDRESS;
+    uint32_t dstAddress = isIncoming ? PCAP_LOCAL_ADDRESS : PCAP_REMOTE_ADDRESS;
+
+    std::string ipHeader;
+    AppendBigEndian(ipHeader, 0x4500, 2);
+    AppendBigEndian(ipHeader, ipLength, 2);
+    AppendBigEndian(ipHeader, 0, 2);
+    AppendBigEndian(ipHeader, 0x4000, 2); /* Don't fragment. */
+    AppendBigEndian(ipHeader, 0x4011, 2); /* TTL 64, UDP. */
+    AppendBigEndian(ipHeader, 0, 2);
+    AppendBigEndian(ipHeader, srcAddress, 4);
+    AppendBigEndian(ipHeader, dstAddress, 4);
+
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < ipHeader.size(); i += 2) {
+      checksum += (static_cast<uint8_t>(ipHeader[i]) << 8) | static_cast<uint8_t>(ipHeader[i + 1]);
+    }
+    checksum = (checksum & 0xffff) + (checksum >> 16);
+    checksum = ~(checksum + (checksum >> 16)) & 0xffff;
+    ipHeader[10] = static_cast<char>(checksum >> 8);
+    ipHeader[11] = static_cast<char>(checksum & 0xff);
+
+    std::lock_guard<std::mutex> lck(_pcapMtx);
+
+    AppendNative<uint32_t>(_pcapBuffer, static_cast<uint32_t>(utcUs / 1000000));
+    AppendNative<uint32_t>(_pcapBuffer, static_cast<uint32_t>(utcUs % 1000000));
+    AppendNative<uint32_t>(_pcapBuffer, static_cast<uint32_t>(capturedLength));
+    AppendNative<uint32_t>(_pcapBuffer, static_cast<uint32_t>(originalLength));
+
+    _pcapBuffer += ipHeader;
+    AppendBigEndian(_pcapBuffer, isIncoming ? PCAP_REMOTE_PORT : PCAP_LOCAL_PORT, 2);
+    AppendBigEndian(_pcapBuffer, isIncoming ? PCAP_LOCAL_PORT : PCAP_REMOTE_PORT, 2);
+    AppendBigEndian(_pcapBuffer, static_cast<uint16_t>(std::min<size_t>(8 + packetLength, 0xffff)), 2);
+    AppendBigEndian(_pcapBuffer, 0, 2);
+    _pcapBuffer.append(reinterpret_cast<const char*>(header.data()), header.size());
+
+    if (_pcapBuffer.size() >= PCAP_FLUSH_BYTES) {
+      _writer->Write(_pcapFile, std::move(_pcapBuffer));
+      _pcapBuffer.clear();
+      _pcapBuffer.reserve(PCAP_FLUSH_BYTES + PCAP_SNAPLEN);
+    }
+  }
+};
+
+CaptureEventLogFactory::CaptureEventLogFactory(const EventLogConfig& config, webrtc::TaskQueueFactory* taskQueueFactory) :
+  _config(config),
+  _eventLogFactory(taskQueueFactory),
+  _writer(std::make_shared<AsyncFileWriter>()),
+  _filePrefix(_config.directory + "/echo-" + std::to_string(rtc::TimeUTCMillis() / 1000) + "-"),
+  _createdCount(0)
+{
+  if (!_config.directory.empty()) {
+    _writer->Start();
+  }
+}
+
+CaptureEventLogFactory::~CaptureEventLogFactory()
+{
+  _writer->Stop();
+
+  if (_writer->GetDroppedBytes() > 0) {
+    LOG_INFO("Event log writer dropped " << _writer->GetDroppedBytes() << " bytes.");
+  }
+}
+
+bool CaptureEventLogFactory::IsSampled(uint64_t index) const
+{
+  /* Spreads the sampled connections evenly rather than picking at random. */
+  return std::floor((index + 1) * _config.samplePercent / 100.0) > std::floor(index * _config.samplePercent / 100.0);
+}
+
+std::unique_ptr<webrtc::RtcEventLog> CaptureEventLogFactory::CreateRtcEventLog(
+  webrtc::RtcEventLog::EncodingType encodingType)
+{
+  auto eventLog = _eventLogFactory.CreateRtcEventLog(encodingType);
+
+  uint64_t index = _createdCount++;
+  if (_config.directory.empty() || !IsSampled(index)) {
+    return eventLog;
+  }
+
+  std::string path = _filePrefix + std::to_string(index);
+
+  auto eventLogFile = std::make_shared<RotatingFile>(path + ".rtclog", _config.maxFileBytes, _config.maxFiles);
+  if (!eventLog->StartLogging(std::make_unique<EventLogFileOutput>(_writer, eventLogFile), EVENT_LOG_OUTPUT_PERIOD_MS)) {
+    LOG_ERROR("Failed to start event log " << path << ".");
+  }
+
+  LOG_VERBOSE("Event log started for peer connection " << index << " at " << path << ".");
+
+  if (!_config.rtpHeaderPcap) {
+    return eventLog;
+  }
+
+  auto pcapFile = std::make_shared<RotatingFile>(path + ".pcap", _config.maxFileBytes, _config.maxFiles,
+    PcapGlobalHeader());
+
+  return std::make_unique<CaptureEventLog>(std::move(eventLog), _writer, pcapFile);
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+* Filename: EventLogCapture.h
+*
+* Description:
+* Opt-in per peer connection diagnostics for offline analysis of bandwidth
+* estimation and jitter. A sampled percentage of peer connections get an
+* RtcEventLog, readable with WebRTC's rtc_event_log_visualizer, and
+* optionally a pcap of the decrypted RTP headers they send and receive.
+*
+* Everything goes through one AsyncFileWriter so no media or network thread
+* ever waits on the disk, and files rotate by size. The pcap packets are
+* synthesised IPv4/UDP datagrams carrying just the RTP header, the captured
+* length is the header while the original length is the full packet. Use
+* Wireshark's "Decode As RTP" on UDP port 5000 to read them.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __EVENT_LOG_CAPTURE__
+#define __EVENT_LOG_CAPTURE__
+
+#include "AsyncFileWriter.h"
+
+#include <api/rtc_event_log/rtc_event_log.h>
+#include <api/rtc_event_log/rtc_event_log_factory.h>
+#include <api/rtc_event_log/rtc_event_log_factory_interface.h>
+#include <api/task_queue/task_queue_factory.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#define EVENT_LOG_OUTPUT_PERIOD_MS 5000
+
+struct EventLogConfig
+{
+  /* Directory the logs are written to, logging is off while it's empty. */
+  std::string directory;
+
+  /* Percentage of peer connections that are logged. */
+  double samplePercent = 100;
+
+  /* Also write a pcap of the decrypted RTP headers. */
+  bool rtpHeaderPcap = false;
+
+  size_t maxFileBytes = 16 * 1024 * 1024;
+  size_t maxFiles = 4;
+};
+
+/**
+* Event log factory handed to the peer connection factory, which asks it for
+* an event log for every peer connection. Sampled connections get logging
+* started straight away, the rest get an event log that's never started.
+*/
+class CaptureEventLogFactory :
+  public webrtc::RtcEventLogFactoryInterface
+{
+public:
+  CaptureEventLogFactory(const EventLogConfig& config, webrtc::TaskQueueFactory* taskQueueFactory);
+  ~CaptureEventLogFactory() override;
+
+  std::unique_ptr<webrtc::RtcEventLog> CreateRtcEventLog(webrtc::RtcEventLog::EncodingType encodingType) override;
+
+private:
+  EventLogConfig _config;
+  webrtc::RtcEventLogFactory _eventLogFactory;
+  std::shared_ptr<AsyncFileWriter> _writer;
+  std::string _filePrefix;
+  std::atomic<uint64_t> _createdCount;
+
+  bool IsSampled(uint64_t index) const;
+};
+
+#endif
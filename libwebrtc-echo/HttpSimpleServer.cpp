@@ -13,13 +13,35 @@
 /******************************************************************************/
 
 #include "HttpSimpleServer.h"
+#include "ListenSocketHandoff.h"
+#include "Logger.h"
+#include "SignalingJson.h"
+
+#include <event2/keyvalq_struct.h>
+#include <rtc_base/helpers.h>
 
 #include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define HTTP_DEFAULT_DRAIN_TIMEOUT_SECONDS 60
 
 PcFactory* HttpSimpleServer::_pcFactory = nullptr;
+StatsCollector* HttpSimpleServer::_statsCollector = nullptr;
 
 HttpSimpleServer::HttpSimpleServer() :
-  _isDisposed(false)
+  _termSignalEvent(nullptr),
+  _drainTimerEvent(nullptr),
+  _handoffEvent(nullptr),
+  _boundSocket(nullptr),
+  _handoffSocket(-1),
+  _isDisposed(false),
+  _isDraining(false),
+  _drainTimeoutSeconds(HTTP_DEFAULT_DRAIN_TIMEOUT_SECONDS)
 {
 #ifdef _WIN32
   evthread_use_windows_threads();
@@ -45,7 +67,27 @@ HttpSimpleServer::HttpSimpleServer() :
 
   int addResult = event_add(_signalEvent, NULL);
   if (addResult < 0) {
-    std::cerr << "Failed to add signal event handler." << std::endl;
+    LOG_ERROR("Failed to add signal event handler.");
+  }
+
+  _termSignalEvent = evsignal_new(_evtBase, SIGTERM, HttpSimpleServer::OnTermSignal, this);
+  if (!_termSignalEvent) {
+    throw std::runtime_error("HttpSimpleServer couldn't create an event instance for SIGTERM.");
+  }
+
+  if (event_add(_termSignalEvent, NULL) < 0) {
+    LOG_ERROR("Failed to add SIGTERM event handler.");
+  }
+
+  _drainTimerEvent = event_new(_evtBase, -1, EV_PERSIST, HttpSimpleServer::OnDrainTimer, this);
+  if (!_drainTimerEvent) {
+    throw std::runtime_error("HttpSimpleServer couldn't create the drain timer event.");
+  }
+
+  /* evhttp_send_reply drains the buffer so a single one serves every response. */
+  _responseBuffer = evbuffer_new();
+  if (!_responseBuffer) {
+    throw std::runtime_error("HttpSimpleServer couldn't create the HTTP response buffer.");
   }
 }
 
@@ -55,30 +97,91 @@ HttpSimpleServer::~HttpSimpleServer() {
     event_base_loopexit(_evtBase, nullptr);
     evhttp_free(_httpSvr);
     event_free(_signalEvent);
+    event_free(_termSignalEvent);
+    event_free(_drainTimerEvent);
+    if (_handoffEvent != nullptr) {
+      event_free(_handoffEvent);
+    }
+    if (_handoffSocket >= 0) {
+      evutil_closesocket(_handoffSocket);
+#ifndef _WIN32
+      /* Once handed off the path belongs to the replacement server. */
+      if (_boundSocket != nullptr) {
+        unlink(_handoffPath.c_str());
+      }
+#endif
+    }
+    evbuffer_free(_responseBuffer);
     event_base_free(_evtBase);
   }
 }
 
-void HttpSimpleServer::Init(const char* httpServerAddress, int httpServerPort, const char* offerPath) {
+void HttpSimpleServer::Init(const char* httpServerAddress, int httpServerPort, const char* offerPath, const char* statsPath,
+  const char* whipPath, const char* handoffPath) {
 
-  int res = evhttp_bind_socket(_httpSvr, httpServerAddress, httpServerPort);
-  if (res != 0) {
-    throw std::runtime_error("HttpSimpleServer failed to start HTTP server on " +
-      std::string(httpServerAddress) + ":" + std::to_string(httpServerPort) + ".");
+  if (handoffPath != nullptr) {
+    _handoffPath = handoffPath;
+
+    bool isHandedOff = ReceiveListenSocket(_handoffPath, [this](evutil_socket_t listenSocket) {
+      evutil_make_socket_nonblocking(listenSocket);
+      _boundSocket = evhttp_accept_socket_with_handle(_httpSvr, listenSocket);
+      return _boundSocket != nullptr;
+    });
+
+    if (isHandedOff) {
+      LOG_INFO("Took over the listening socket from the server running at " << _handoffPath << ".");
+    }
   }
 
+  if (_boundSocket == nullptr) {
+    _boundSocket = evhttp_bind_socket_with_handle(_httpSvr, httpServerAddress, httpServerPort);
+    if (_boundSocket == nullptr) {
+      throw std::runtime_error("HttpSimpleServer failed to start HTTP server on " +
+        std::string(httpServerAddress) + ":" + std::to_string(httpServerPort) + ".");
+    }
+  }
+
+  if (!_handoffPath.empty()) {
+    _handoffSocket = CreateHandoffSocket(_handoffPath);
+    if (_handoffSocket >= 0) {
+      _handoffEvent = event_new(_evtBase, _handoffSocket, EV_READ | EV_PERSIST, HttpSimpleServer::OnHandoffRequest, this);
+      if (_handoffEvent == nullptr || event_add(_handoffEvent, NULL) < 0) {
+        LOG_ERROR("Failed to add handoff socket event handler.");
+      }
+    }
+  }
+
+  int res = 0;
+
   evhttp_set_allowed_methods(_httpSvr,
     EVHTTP_REQ_GET |
     EVHTTP_REQ_POST |
+    EVHTTP_REQ_PATCH |
+    EVHTTP_REQ_DELETE |
     EVHTTP_REQ_OPTIONS);
 
-  std::cout << "Waiting for SDP offer on http://"
-    + std::string(httpServerAddress) + ":" + std::to_string(httpServerPort) + offerPath << std::endl;
+  LOG_INFO("Waiting for SDP offer on http://" << httpServerAddress << ":" << httpServerPort << offerPath);
 
-  res = evhttp_set_cb(_httpSvr, offerPath, HttpSimpleServer::OnHttpRequest, NULL);
+  res = evhttp_set_cb(_httpSvr, offerPath, HttpSimpleServer::OnHttpRequest, this);
   if (res != 0) {
     throw std::runtime_error("HttpSimpleServer failed to set request callback.");
   }
+
+  res = evhttp_set_cb(_httpSvr, statsPath, HttpSimpleServer::OnStatsRequest, this);
+  if (res != 0) {
+    throw std::runtime_error("HttpSimpleServer failed to set stats request callback.");
+  }
+
+  LOG_INFO("Waiting for WHIP offer on http://" << httpServerAddress << ":" << httpServerPort << whipPath);
+
+  _whipPath = whipPath;
+  res = evhttp_set_cb(_httpSvr, whipPath, HttpSimpleServer::OnWhipRequest, this);
+  if (res != 0) {
+    throw std::runtime_error("HttpSimpleServer failed to set WHIP request callback.");
+  }
+
+  /* WHIP resource URLs carry the resource id so they can't have a fixed callback. */
+  evhttp_set_gencb(_httpSvr, HttpSimpleServer::OnWhipResourceRequest, this);
 }
 
 void HttpSimpleServer::Run() {
@@ -89,70 +192,374 @@ void HttpSimpleServer::Stop() {
   this->~HttpSimpleServer();
 }
 
+void HttpSimpleServer::BeginDrain() {
+  if (_isDraining) {
+    return;
+  }
+
+  _isDraining = true;
+  _drainDeadline = std::chrono::steady_clock::now() + std::chrono::seconds(_drainTimeoutSeconds);
+
+  LOG_INFO("Draining, new offers will be refused for up to " << _drainTimeoutSeconds << "s.");
+
+  timeval interval{ HTTP_DRAIN_CHECK_INTERVAL_MS / 1000, (HTTP_DRAIN_CHECK_INTERVAL_MS % 1000) * 1000 };
+  event_add(_drainTimerEvent, &interval);
+}
+
+/* The request's spans are recorded once the peer connection id, which is the trace id, is known. */
+static void TraceSignalingRequest(SetupTracer& setupTracer, const std::string& peerConnectionId,
+  int64_t requestStartUs, int64_t parsedUs)
+{
+  uint64_t traceId = strtoull(peerConnectionId.c_str(), nullptr, 10);
+  setupTracer.Record(traceId, SetupStage::ParseOffer, requestStartUs, parsedUs);
+  setupTracer.Record(traceId, SetupStage::HttpRequest, requestStartUs, SetupTracer::NowUs());
+}
+
 void HttpSimpleServer::SetPeerConnectionFactory(PcFactory* pcFactory) {
   _pcFactory = pcFactory;
 }
 
+void HttpSimpleServer::SetStatsCollector(StatsCollector* statsCollector) {
+  _statsCollector = statsCollector;
+}
+
 /**
 * The handler function for an incoming HTTP request. This is the start of the
 * handling for any WebRTC peer that wishes to establish a connection. The incoming
-* request MUST have an SDP offer in its body.
+* request MUST have an SDP offer in its body. The offer's sdp field is pulled
+* straight out of the request buffer and the answer is escaped straight into
+* the server's response buffer, no JSON DOM is built in either direction.
 * @param[in] req: the HTTP request received from the remote client.
-* @param[in] arg: not used.
+* @param[in] arg: the HttpSimpleServer instance.
 */
 void HttpSimpleServer::OnHttpRequest(struct evhttp_request* req, void* arg)
 {
-  const char* uri = evhttp_request_get_uri(req);
-  evbuffer* http_req_body = nullptr;
-  size_t http_req_body_len{ 0 };
-  char* http_req_buffer = nullptr;
-  struct evbuffer* resp_buffer;
-  int resp_lock = 0;
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+  struct evbuffer* resp_buffer = server->_responseBuffer;
+  int64_t requestStartUs = SetupTracer::NowUs();
 
-  printf("Received HTTP request for %s.\n", uri);
+  LOG_VERBOSE("Received HTTP request for " << evhttp_request_get_uri(req) << ".");
 
   if (req->type == EVHTTP_REQ_OPTIONS) {
     evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
     evhttp_add_header(req->output_headers, "Access-Control-Allow-Methods", "POST");
     evhttp_add_header(req->output_headers, "Access-Control-Allow-Headers", "content-type");
     evhttp_send_reply(req, 200, "OK", NULL);
+    return;
+  }
+
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+
+  if (server->_isDraining) {
+    /* Closing the connection sends the retry to whichever server now owns the listening socket. */
+    evhttp_add_header(req->output_headers, "Retry-After", std::to_string(HTTP_DRAIN_RETRY_AFTER_SECONDS).c_str());
+    evhttp_add_header(req->output_headers, "Connection", "close");
+    evbuffer_add_printf(resp_buffer, "Server is draining.");
+    evhttp_send_reply(req, 503, "Service Unavailable", resp_buffer);
+    return;
+  }
+
+  evbuffer* http_req_body = evhttp_request_get_input_buffer(req);
+  size_t http_req_body_len = evbuffer_get_length(http_req_body);
+
+  LOG_VERBOSE("HTTP request body length " << http_req_body_len << ".");
+
+  /* Per thread so the string's capacity is reused across offers. */
+  static thread_local std::string offerSdp;
+  static thread_local std::string answerSdp;
+  std::string id;
+
+  bool hasOffer = http_req_body_len > 0 && ExtractJsonStringField(http_req_body, "sdp", offerSdp);
+  int64_t parsedUs = SetupTracer::NowUs();
+
+  if (!hasOffer) {
+    evbuffer_add_printf(resp_buffer, "Request was missing the SDP offer.");
+    evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
+  }
+  else if (_pcFactory == nullptr) {
+    evbuffer_add_printf(resp_buffer, "No handler");
+    evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
+  }
+  else if (!_pcFactory->CreatePeerConnection(offerSdp, answerSdp, &id)) {
+    evbuffer_add_printf(resp_buffer, "Failed to create SDP answer.");
+    evhttp_send_reply(req, 500, "Internal Server Error", resp_buffer);
+  }
+  else if (AppendSdpJson(resp_buffer, "answer", answerSdp) != 0) {
+    LOG_ERROR("Failed to write SDP answer to HTTP response buffer.");
+    evbuffer_drain(resp_buffer, evbuffer_get_length(resp_buffer));
+    evhttp_send_error(req, 500, "Internal Server Error");
   }
   else {
+    evhttp_add_header(req->output_headers, "Content-type", "application/json");
+    evhttp_send_reply(req, 200, "OK", resp_buffer);
+    TraceSignalingRequest(_pcFactory->GetSetupTracer(), id, requestStartUs, parsedUs);
+  }
+}
+
+/**
+* The handler function for a stats request. The response is rendered from the
+* statistics cached by the collector, no GetStats calls are made per request.
+* JSON is returned by default, Prometheus text format if the query string
+* contains format=prometheus. format=chrome-trace returns the connection
+* setup spans in the Chrome trace event format instead.
+* @param[in] req: the HTTP request received from the remote client.
+* @param[in] arg: the HttpSimpleServer instance.
+*/
+void HttpSimpleServer::OnStatsRequest(struct evhttp_request* req, void* arg)
+{
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+  struct evbuffer* resp_buffer = server->_responseBuffer;
+
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
 
-    resp_buffer = evbuffer_new();
-    if (!resp_buffer) {
-      fprintf(stderr, "Failed to create HTTP response buffer.\n");
+  bool isPrometheus = false;
+  bool isChromeTrace = false;
+  const char* query = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(req));
+
+  if (query != nullptr) {
+    struct evkeyvalq params;
+    if (evhttp_parse_query_str(query, &params) == 0) {
+      const char* format = evhttp_find_header(&params, "format");
+      isPrometheus = format != nullptr && strcmp(format, "prometheus") == 0;
+      isChromeTrace = format != nullptr && strcmp(format, "chrome-trace") == 0;
+      evhttp_clear_headers(&params);
     }
+  }
 
-    evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+  if (isChromeTrace && _pcFactory != nullptr) {
+    std::string trace = _pcFactory->GetSetupTracer().GetChromeTraceJson();
+    evhttp_add_header(req->output_headers, "Content-type", "application/json");
+    evbuffer_add(resp_buffer, trace.data(), trace.size());
+    evhttp_send_reply(req, 200, "OK", resp_buffer);
+  }
+  else if (_statsCollector == nullptr) {
+    evbuffer_add_printf(resp_buffer, "Stats collection is not enabled.");
+    evhttp_send_reply(req, 404, "Not Found", resp_buffer);
+  }
+  else {
+    std::string stats;
+    if (isPrometheus) {
+      stats = _statsCollector->GetPrometheus();
+      evhttp_add_header(req->output_headers, "Content-type", "text/plain; version=0.0.4");
+    }
+    else {
+      stats = _statsCollector->GetJson();
+      evhttp_add_header(req->output_headers, "Content-type", "application/json");
+    }
 
-    http_req_body = evhttp_request_get_input_buffer(req);
-    http_req_body_len = evbuffer_get_length(http_req_body);
+    evbuffer_add(resp_buffer, stats.data(), stats.size());
+    evhttp_send_reply(req, 200, "OK", resp_buffer);
+  }
+}
 
-    if (http_req_body_len > 0) {
-      http_req_buffer = static_cast<char*>(calloc(http_req_body_len, sizeof(char)));
+static bool HasContentType(struct evhttp_request* req, const char* contentType)
+{
+  const char* header = evhttp_find_header(req->input_headers, "Content-Type");
+  size_t length = strlen(contentType);
 
-      evbuffer_copyout(http_req_body, http_req_buffer, http_req_body_len);
+  /* Any parameters after the media type are ignored. */
+  return header != nullptr && evutil_ascii_strncasecmp(header, contentType, length) == 0 &&
+    (header[length] == '\0' || header[length] == ';' || header[length] == ' ');
+}
 
-      printf("HTTP request body length %zu.\n", http_req_body_len);
+static void CopyRequestBody(struct evhttp_request* req, std::string& body)
+{
+  evbuffer* reqBody = evhttp_request_get_input_buffer(req);
+  body.resize(evbuffer_get_length(reqBody));
+  if (!body.empty()) {
+    evbuffer_copyout(reqBody, &body[0], body.size());
+  }
+}
 
-      std::string offerJson(http_req_buffer, http_req_body_len);
-      std::cout << offerJson << std::endl;
+/**
+* The handler function for a WHIP offer. The body is the raw SDP offer and the
+* response the raw SDP answer, along with the URL of the new session's resource.
+* @param[in] req: the HTTP request received from the remote client.
+* @param[in] arg: the HttpSimpleServer instance.
+*/
+void HttpSimpleServer::OnWhipRequest(struct evhttp_request* req, void* arg)
+{
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+  struct evbuffer* resp_buffer = server->_responseBuffer;
+  int64_t requestStartUs = SetupTracer::NowUs();
 
-      if (_pcFactory != nullptr) {
-        std::string answer = _pcFactory->CreatePeerConnection(http_req_buffer, http_req_body_len);
-        evhttp_add_header(req->output_headers, "Content-type", "application/json");
-        evbuffer_add_printf(resp_buffer, answer.c_str());
-        evhttp_send_reply(req, 200, "OK", resp_buffer);
-      }
-      else {
-        evbuffer_add_printf(resp_buffer, "No handler");
-        evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
-      }
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+
+  if (req->type == EVHTTP_REQ_OPTIONS) {
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Methods", "POST, OPTIONS");
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Headers", "content-type");
+    evhttp_add_header(req->output_headers, "Accept-Post", HTTP_SDP_CONTENT_TYPE);
+    evhttp_send_reply(req, 204, "No Content", NULL);
+    return;
+  }
+
+  if (req->type != EVHTTP_REQ_POST) {
+    evhttp_add_header(req->output_headers, "Allow", "POST, OPTIONS");
+    evhttp_send_reply(req, 405, "Method Not Allowed", NULL);
+    return;
+  }
+
+  if (server->_isDraining) {
+    evhttp_add_header(req->output_headers, "Retry-After", std::to_string(HTTP_DRAIN_RETRY_AFTER_SECONDS).c_str());
+    evhttp_add_header(req->output_headers, "Connection", "close");
+    evbuffer_add_printf(resp_buffer, "Server is draining.");
+    evhttp_send_reply(req, 503, "Service Unavailable", resp_buffer);
+    return;
+  }
+
+  if (!HasContentType(req, HTTP_SDP_CONTENT_TYPE)) {
+    evbuffer_add_printf(resp_buffer, "Content type must be %s.", HTTP_SDP_CONTENT_TYPE);
+    evhttp_send_reply(req, 415, "Unsupported Media Type", resp_buffer);
+    return;
+  }
+
+  static thread_local std::string offerSdp;
+  static thread_local std::string answerSdp;
+  std::string id;
+
+  CopyRequestBody(req, offerSdp);
+  int64_t parsedUs = SetupTracer::NowUs();
+
+  if (offerSdp.empty()) {
+    evbuffer_add_printf(resp_buffer, "Request was missing the SDP offer.");
+    evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
+  }
+  else if (_pcFactory == nullptr) {
+    evbuffer_add_printf(resp_buffer, "No handler");
+    evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
+  }
+  else if (!_pcFactory->CreatePeerConnection(offerSdp, answerSdp, &id)) {
+    evbuffer_add_printf(resp_buffer, "Failed to create SDP answer.");
+    evhttp_send_reply(req, 500, "Internal Server Error", resp_buffer);
+  }
+  else {
+    server->PruneWhipResources();
+
+    std::string resourceId = rtc::CreateRandomString(HTTP_WHIP_RESOURCE_ID_LENGTH);
+    std::string etag = "\"" + rtc::CreateRandomString(HTTP_ETAG_LENGTH) + "\"";
+    std::string location = server->_whipPath + "/" + resourceId;
+    server->_whipResources[resourceId] = { id, etag };
+
+    evhttp_add_header(req->output_headers, "Content-Type", HTTP_SDP_CONTENT_TYPE);
+    evhttp_add_header(req->output_headers, "Location", location.c_str());
+    evhttp_add_header(req->output_headers, "ETag", etag.c_str());
+    evhttp_add_header(req->output_headers, "Access-Control-Expose-Headers", "Location, ETag");
+    evbuffer_add(resp_buffer, answerSdp.data(), answerSdp.size());
+    evhttp_send_reply(req, 201, "Created", resp_buffer);
+    TraceSignalingRequest(_pcFactory->GetSetupTracer(), id, requestStartUs, parsedUs);
+  }
+}
+
+/**
+* The handler function for requests on a WHIP session's resource, and for any
+* other path the server doesn't know. A PATCH trickles the remote candidates
+* in its SDP fragment, a DELETE ends the session.
+* @param[in] req: the HTTP request received from the remote client.
+* @param[in] arg: the HttpSimpleServer instance.
+*/
+void HttpSimpleServer::OnWhipResourceRequest(struct evhttp_request* req, void* arg)
+{
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+  struct evbuffer* resp_buffer = server->_responseBuffer;
+  std::string prefix = server->_whipPath + "/";
+  const char* path = evhttp_uri_get_path(evhttp_request_get_evhttp_uri(req));
+
+  evhttp_add_header(req->output_headers, "Access-Control-Allow-Origin", "*");
+
+  if (path == nullptr || strncmp(path, prefix.c_str(), prefix.size()) != 0) {
+    evhttp_send_reply(req, 404, "Not Found", NULL);
+    return;
+  }
+
+  auto resource = server->_whipResources.find(path + prefix.size());
+
+  /* The peer connection may have failed or closed without a DELETE. */
+  if (resource != server->_whipResources.end() &&
+    (_pcFactory == nullptr || !_pcFactory->IsPeerConnectionActive(resource->second.peerConnectionId))) {
+    if (_pcFactory != nullptr) {
+      _pcFactory->ClosePeerConnection(resource->second.peerConnectionId);
     }
-    else {
-      evbuffer_add_printf(resp_buffer, "Request was missing the SDP offer.");
+    server->_whipResources.erase(resource);
+    resource = server->_whipResources.end();
+  }
+
+  if (resource == server->_whipResources.end()) {
+    evhttp_send_reply(req, 404, "Not Found", NULL);
+  }
+  else if (req->type == EVHTTP_REQ_OPTIONS) {
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Methods", "PATCH, DELETE, OPTIONS");
+    evhttp_add_header(req->output_headers, "Access-Control-Allow-Headers", "content-type, if-match");
+    evhttp_add_header(req->output_headers, "Accept-Patch", HTTP_TRICKLE_CONTENT_TYPE);
+    evhttp_send_reply(req, 204, "No Content", NULL);
+  }
+  else if (req->type == EVHTTP_REQ_DELETE) {
+    std::string peerConnectionId = resource->second.peerConnectionId;
+    server->_whipResources.erase(resource);
+    _pcFactory->ClosePeerConnection(peerConnectionId);
+    evhttp_send_reply(req, 200, "OK", NULL);
+  }
+  else if (req->type == EVHTTP_REQ_PATCH) {
+    const char* ifMatch = evhttp_find_header(req->input_headers, "If-Match");
+
+    if (ifMatch != nullptr && strcmp(ifMatch, "*") != 0 && resource->second.etag != ifMatch) {
+      evhttp_send_reply(req, 412, "Precondition Failed", NULL);
+      return;
+    }
+
+    if (!HasContentType(req, HTTP_TRICKLE_CONTENT_TYPE)) {
+      evbuffer_add_printf(resp_buffer, "Content type must be %s.", HTTP_TRICKLE_CONTENT_TYPE);
+      evhttp_send_reply(req, 415, "Unsupported Media Type", resp_buffer);
+      return;
+    }
+
+    static thread_local std::string sdpFragment;
+    CopyRequestBody(req, sdpFragment);
+
+    switch (_pcFactory->AddRemoteCandidates(resource->second.peerConnectionId, sdpFragment)) {
+    case TrickleResult::Ok:
+      evhttp_add_header(req->output_headers, "ETag", resource->second.etag.c_str());
+      evhttp_send_reply(req, 204, "No Content", NULL);
+      break;
+    case TrickleResult::NotFound:
+      server->_whipResources.erase(resource);
+      evhttp_send_reply(req, 404, "Not Found", NULL);
+      break;
+    case TrickleResult::IceRestart:
+      evbuffer_add_printf(resp_buffer, "ICE restarts are not supported.");
+      evhttp_send_reply(req, 501, "Not Implemented", resp_buffer);
+      break;
+    default:
+      evbuffer_add_printf(resp_buffer, "Failed to apply the SDP fragment.");
       evhttp_send_reply(req, 400, "Bad Request", resp_buffer);
+      break;
+    }
+  }
+  else {
+    evhttp_add_header(req->output_headers, "Allow", "PATCH, DELETE, OPTIONS");
+    evhttp_send_reply(req, 405, "Method Not Allowed", NULL);
+  }
+}
+
+/**
+* Forgets the WHIP resources whose peer connections have failed, closed or never
+* connected without the client sending a DELETE, and closes those peer
+* connections so the factory lets go of them too.
+*/
+void HttpSimpleServer::PruneWhipResources()
+{
+  if (_whipResources.empty()) {
+    return;
+  }
+
+  auto activeIds = _pcFactory->GetActivePeerConnectionIds();
+
+  for (auto it = _whipResources.begin(); it != _whipResources.end();) {
+    if (activeIds.count(it->second.peerConnectionId) == 0) {
+      _pcFactory->ClosePeerConnection(it->second.peerConnectionId);
+      it = _whipResources.erase(it);
+    }
+    else {
+      it++;
     }
   }
 }
@@ -161,7 +568,54 @@ void HttpSimpleServer::OnSignal(evutil_socket_t sig, short events, void* user_da
 {
   event_base* base = static_cast<event_base*>(user_data);
 
-  std::cout << "Caught an interrupt signal; calling loop exit." << std::endl;
+  LOG_INFO("Caught an interrupt signal; calling loop exit.");
 
   event_base_loopexit(base, nullptr);
 }
+
+void HttpSimpleServer::OnTermSignal(evutil_socket_t sig, short events, void* arg)
+{
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+
+  LOG_INFO("Caught a terminate signal; draining.");
+
+  server->BeginDrain();
+}
+
+void HttpSimpleServer::OnDrainTimer(evutil_socket_t fd, short events, void* arg)
+{
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+  size_t activeCount = _pcFactory != nullptr ? _pcFactory->GetActivePeerConnectionCount() : 0;
+
+  if (activeCount == 0) {
+    LOG_INFO("Drain complete, no active peer connections.");
+    event_base_loopexit(server->_evtBase, nullptr);
+  }
+  else if (std::chrono::steady_clock::now() >= server->_drainDeadline) {
+    LOG_INFO("Drain timed out with " << activeCount << " active peer connections.");
+    event_base_loopexit(server->_evtBase, nullptr);
+  }
+}
+
+/**
+* A replacement server has connected to the handoff socket. Once it has taken
+* the listening socket this server stops accepting and drains.
+*/
+void HttpSimpleServer::OnHandoffRequest(evutil_socket_t fd, short events, void* arg)
+{
+  HttpSimpleServer* server = static_cast<HttpSimpleServer*>(arg);
+
+  if (server->_boundSocket == nullptr) {
+    return;
+  }
+
+  if (SendListenSocket(fd, evhttp_bound_socket_get_fd(server->_boundSocket))) {
+    LOG_INFO("Listening socket handed to the replacement server.");
+
+    evhttp_del_accept_socket(server->_httpSvr, server->_boundSocket);
+    server->_boundSocket = nullptr;
+    event_del(server->_handoffEvent);
+
+    server->BeginDrain();
+  }
+}
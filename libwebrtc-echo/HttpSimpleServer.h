@@ -5,6 +5,18 @@
 * Simple HTTP server that's designed to only process a small number of 
 * expected requests. No attempt is made to behave as a generic HTTP server.
 *
+* SIGTERM puts the server into drain mode: new offers are refused with a 503
+* and the event loop exits once the existing peer connections have closed or
+* the drain timeout passes. Handing the listening socket to a replacement
+* server (see ListenSocketHandoff.h) drains the same way.
+*
+* Alongside the JSON offer endpoint there's a WHIP (RFC 9725) endpoint that
+* takes and returns raw SDP. A POST creates a resource at whipPath/<id>, a
+* PATCH to it with an SDP fragment trickles candidates and a DELETE closes the
+* peer connection. The resource's ETag must match any If-Match on a PATCH.
+* Resource ids are random so one client can't guess and end another's session,
+* a resource goes once its peer connection has closed or failed.
+*
 * Author:
 * Aaron Clauson (aaron@sipsorcery.com)
 *
@@ -18,6 +30,7 @@
 #define __HTTP_SIMPLE_SERVER__
 
 #include "PcFactory.h"
+#include "StatsCollector.h"
 
 #include <event2/buffer.h>
 #include <event2/event.h>
@@ -26,34 +39,82 @@
 #include <event2/thread.h>
 #include <event2/util.h>
 
+#include <chrono>
 #include <exception>
 #include <functional>
 #include <iostream>
 #include <string>
 #include <thread>
+#include <unordered_map>
+
+/* Seconds a refused client is asked to wait before retrying its offer. */
+#define HTTP_DRAIN_RETRY_AFTER_SECONDS 1
+#define HTTP_DRAIN_CHECK_INTERVAL_MS 1000
+
+#define HTTP_SDP_CONTENT_TYPE "application/sdp"
+#define HTTP_TRICKLE_CONTENT_TYPE "application/trickle-ice-sdpfrag"
+#define HTTP_ETAG_LENGTH 16
+#define HTTP_WHIP_RESOURCE_ID_LENGTH 32
+
+struct WhipResource
+{
+  std::string peerConnectionId;
+  std::string etag;
+};
 
 class HttpSimpleServer
 {
 public:
   HttpSimpleServer();
   ~HttpSimpleServer();
-  void Init(const char * httpServerAddress, int httpServerPort, const char * offerPath);
+  /* If handoffPath is set the listening socket is taken over from a server
+  * already running with the same path, and handed on to the next one. */
+  void Init(const char * httpServerAddress, int httpServerPort, const char * offerPath, const char * statsPath,
+    const char* whipPath, const char* handoffPath = nullptr);
   void Run();
   void Stop();
+
+  /* Stops accepting offers, the event loop exits once the existing peer
+  * connections have closed or the drain timeout has passed. */
+  void BeginDrain();
+  void SetDrainTimeout(int drainTimeoutSeconds) { _drainTimeoutSeconds = drainTimeoutSeconds; }
   
   static void SetPeerConnectionFactory(PcFactory* pcFactory);
+  static void SetStatsCollector(StatsCollector* statsCollector);
 
 private:
   event_base* _evtBase;
   evhttp* _httpSvr;
   event* _signalEvent;
+  event* _termSignalEvent;
+  event* _drainTimerEvent;
+  event* _handoffEvent;
+  evhttp_bound_socket* _boundSocket;
+  evutil_socket_t _handoffSocket;
+  std::string _handoffPath;
+  evbuffer* _responseBuffer;
   std::thread _httpSvrThread;
   bool _isDisposed;
+  bool _isDraining;
+  int _drainTimeoutSeconds;
+  std::chrono::steady_clock::time_point _drainDeadline;
+  std::string _whipPath;
+
+  /* WHIP resources keyed by resource id, only used on the event loop thread. */
+  std::unordered_map<std::string, WhipResource> _whipResources;
   
   static PcFactory* _pcFactory;
+  static StatsCollector* _statsCollector;
 
   static void OnHttpRequest(struct evhttp_request* req, void* arg);
+  static void OnStatsRequest(struct evhttp_request* req, void* arg);
+  static void OnWhipRequest(struct evhttp_request* req, void* arg);
+  static void OnWhipResourceRequest(struct evhttp_request* req, void* arg);
+  void PruneWhipResources();
   static void OnSignal(evutil_socket_t sig, short events, void* user_data);
+  static void OnTermSignal(evutil_socket_t sig, short events, void* arg);
+  static void OnDrainTimer(evutil_socket_t fd, short events, void* arg);
+  static void OnHandoffRequest(evutil_socket_t fd, short events, void* arg);
 };
 
 #endif
@@ -0,0 +1,176 @@
+/******************************************************************************
+* Filename: InstrumentedThread.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "InstrumentedThread.h"
+#include "Logger.h"
+
+#include <rtc_base/null_socket_server.h>
+#include <rtc_base/time_utils.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+* Reads the fields of a /proc stat file from the state field (3) on. The
+* command name in the second field can contain spaces so the fields are
+* counted from the ')' that ends it.
+*/
+static bool ReadProcStatFields(const std::string& path, std::vector<std::string>& fields)
+{
+  std::ifstream statFile(path);
+  std::string stat;
+
+  if (!std::getline(statFile, stat)) {
+    return false;
+  }
+
+  size_t commEnd = stat.rfind(')');
+  if (commEnd == std::string::npos) {
+    return false;
+  }
+
+  std::istringstream statFields(stat.substr(commEnd + 1));
+  std::string field;
+  while (statFields >> field) {
+    fields.push_back(field);
+  }
+
+  return true;
+}
+
+/* Field n of a /proc stat file, as numbered in proc(5). */
+#define PROC_STAT_FIELD(fields, n) (fields)[(n) - 3]
+
+/* utime and stime are fields 14 and 15. */
+static int64_t ReadProcCpuTimeUs(const std::string& path)
+{
+#ifdef __linux__
+  std::vector<std::string> fields;
+  if (!ReadProcStatFields(path, fields) || fields.size() < 15 - 2) {
+    return -1;
+  }
+
+  uint64_t userTicks = strtoull(PROC_STAT_FIELD(fields, 14).c_str(), nullptr, 10);
+  uint64_t systemTicks = strtoull(PROC_STAT_FIELD(fields, 15).c_str(), nullptr, 10);
+
+  static const int64_t ticksPerSecond = sysconf(_SC_CLK_TCK);
+  return static_cast<int64_t>(userTicks + systemTicks) * rtc::kNumMicrosecsPerSec / ticksPerSecond;
+#else
+  return -1;
+#endif
+}
+
+std::unique_ptr<InstrumentedThread> InstrumentedThread::Create()
+{
+  return std::make_unique<InstrumentedThread>(std::make_unique<rtc::NullSocketServer>());
+}
+
+std::unique_ptr<InstrumentedThread> InstrumentedThread::CreateWithSocketServer()
+{
+  return std::make_unique<InstrumentedThread>(rtc::SocketServer::CreateDefault());
+}
+
+InstrumentedThread::InstrumentedThread(std::unique_ptr<rtc::SocketServer> socketServer) :
+  rtc::Thread(std::move(socketServer)),
+  _taskLatency(INSTRUMENTED_THREAD_TASK_BOUNDS_US)
+{ }
+
+InstrumentedThread::~InstrumentedThread()
+{
+  /* rtc::Thread requires subclasses to stop the thread before their members go. */
+  Stop();
+}
+
+void InstrumentedThread::Run()
+{
+#ifdef __linux__
+  _nativeThreadId = syscall(SYS_gettid);
+#endif
+
+  if (!ApplyThreadPlacement(_placement)) {
+    LOG_ERROR("Failed to apply the CPU placement for thread " << name() << ".");
+  }
+
+  rtc::Thread::Run();
+}
+
+void InstrumentedThread::Dispatch(rtc::Message* msg)
+{
+  int64_t startUs = rtc::TimeMicros();
+  rtc::Thread::Dispatch(msg);
+  _taskLatency.Add(rtc::TimeMicros() - startUs);
+}
+
+int64_t InstrumentedThread::GetCpuTimeUs() const
+{
+  int64_t nativeThreadId = _nativeThreadId.load();
+  if (nativeThreadId == 0) {
+    return -1;
+  }
+
+  return ReadProcCpuTimeUs("/proc/self/task/" + std::to_string(nativeThreadId) + "/stat");
+}
+
+int64_t InstrumentedThread::GetProcessCpuTimeUs()
+{
+  return ReadProcCpuTimeUs("/proc/self/stat");
+}
+
+int64_t InstrumentedThread::GetProcessCpuTimeUs(int64_t pid)
+{
+  return ReadProcCpuTimeUs("/proc/" + std::to_string(pid) + "/stat");
+}
+
+int InstrumentedThread::GetLastCpu() const
+{
+  int64_t nativeThreadId = _nativeThreadId.load();
+  std::vector<std::string> fields;
+
+  /* processor is field 39. */
+  if (nativeThreadId == 0 ||
+    !ReadProcStatFields("/proc/self/task/" + std::to_string(nativeThreadId) + "/stat", fields) ||
+    fields.size() < 39 - 2) {
+    return -1;
+  }
+
+  return atoi(PROC_STAT_FIELD(fields, 39).c_str());
+}
+
+int64_t InstrumentedThread::GetMigrations() const
+{
+  int64_t nativeThreadId = _nativeThreadId.load();
+  if (nativeThreadId == 0) {
+    return -1;
+  }
+
+  /* Only present with CONFIG_SCHED_DEBUG, which the distribution kernels have. */
+  std::ifstream schedFile("/proc/self/task/" + std::to_string(nativeThreadId) + "/sched");
+  std::string line;
+  while (std::getline(schedFile, line)) {
+    if (line.compare(0, 16, "se.nr_migrations") == 0) {
+      size_t colon = line.find(':');
+      return (colon != std::string::npos) ? strtoll(line.c_str() + colon + 1, nullptr, 10) : -1;
+    }
+  }
+
+  return -1;
+}
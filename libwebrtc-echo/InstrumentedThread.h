@@ -0,0 +1,84 @@
+/******************************************************************************
+* Filename: InstrumentedThread.h
+*
+* Description:
+* rtc::Thread that measures its own load, used for the PcFactory's network,
+* worker and signaling threads. Every message and task it dispatches is timed
+* into a histogram, its queue depth can be read at any time and its CPU time
+* is read from /proc/self/task/<tid>/stat. The StatsCollector samples these to
+* show which of the threads saturates first. A thread can be given a CPU
+* placement before it starts, along with the core it last ran on and how
+* often the scheduler has migrated it.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __INSTRUMENTED_THREAD__
+#define __INSTRUMENTED_THREAD__
+
+#include "CpuPlacement.h"
+#include "LatencyHistogram.h"
+
+#include <rtc_base/socket_server.h>
+#include <rtc_base/thread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#define INSTRUMENTED_THREAD_TASK_BOUNDS_US { 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, \
+  50000, 100000 }
+
+class InstrumentedThread :
+  public rtc::Thread
+{
+public:
+  static std::unique_ptr<InstrumentedThread> Create();
+  static std::unique_ptr<InstrumentedThread> CreateWithSocketServer();
+
+  explicit InstrumentedThread(std::unique_ptr<rtc::SocketServer> socketServer);
+  ~InstrumentedThread() override;
+
+  /* Applied when the thread starts, so must be set before Start. */
+  void SetPlacement(const ThreadPlacement& placement) { _placement = placement; }
+  const ThreadPlacement& GetPlacement() const { return _placement; }
+
+  void Run() override;
+  void Dispatch(rtc::Message* msg) override;
+
+  /* Messages and tasks waiting to be dispatched. */
+  size_t GetQueueDepth() const { return size(); }
+
+  /* Time taken by each dispatched message or task. */
+  const LatencyHistogram& GetTaskLatency() const { return _taskLatency; }
+
+  /* User plus system CPU time used by the thread, -1 until it's running or
+  * where /proc isn't available. */
+  int64_t GetCpuTimeUs() const;
+
+  /* The same for the whole process. */
+  static int64_t GetProcessCpuTimeUs();
+
+  /* The same for another process, -1 if it isn't running or can't be read. */
+  static int64_t GetProcessCpuTimeUs(int64_t pid);
+
+  /* The core the thread last ran on, -1 if unknown. */
+  int GetLastCpu() const;
+
+  /* Times the scheduler has moved the thread to another core, -1 where the
+  * kernel doesn't report it. */
+  int64_t GetMigrations() const;
+
+private:
+  ThreadPlacement _placement;
+  std::atomic<int64_t> _nativeThreadId{ 0 };
+  LatencyHistogram _taskLatency;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/******************************************************************************
+* Filename: LatencyHistogram.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram(const std::vector<int64_t>& boundsUs) :
+  _boundsUs(boundsUs),
+  _buckets(new std::atomic<uint64_t>[boundsUs.size() + 1])
+{
+  for (size_t i = 0; i <= _boundsUs.size(); i++) {
+    _buckets[i].store(0);
+  }
+}
+
+void LatencyHistogram::Add(int64_t valueUs)
+{
+  valueUs = std::max<int64_t>(valueUs, 0);
+  size_t bucket = std::lower_bound(_boundsUs.begin(), _boundsUs.end(), valueUs) - _boundsUs.begin();
+
+  _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  _sumUs.fetch_add(valueUs, std::memory_order_relaxed);
+
+  int64_t maxUs = _maxUs.load(std::memory_order_relaxed);
+  while (valueUs > maxUs && !_maxUs.compare_exchange_weak(maxUs, valueUs)) {}
+}
+
+LatencyHistogramSnapshot LatencyHistogram::GetSnapshot() const
+{
+  LatencyHistogramSnapshot snapshot{};
+
+  for (size_t i = 0; i <= _boundsUs.size(); i++) {
+    snapshot.buckets.push_back(_buckets[i].load(std::memory_order_relaxed));
+    snapshot.count += snapshot.buckets.back();
+  }
+
+  snapshot.sumUs = _sumUs.load(std::memory_order_relaxed);
+  snapshot.maxUs = _maxUs.load(std::memory_order_relaxed);
+
+  if (snapshot.count == 0) {
+    return snapshot;
+  }
+
+  snapshot.meanUs = static_cast<double>(snapshot.sumUs) / snapshot.count;
+
+  auto percentileUs = [&](double percentile) {
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(percentile * snapshot.count + 0.5), 1);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < _boundsUs.size(); i++) {
+      cumulative += snapshot.buckets[i];
+      if (cumulative >= rank) {
+        return static_cast<double>(std::min(_boundsUs[i], snapshot.maxUs));
+      }
+    }
+    return static_cast<double>(snapshot.maxUs);
+  };
+
+  snapshot.p50Us = percentileUs(0.50);
+  snapshot.p95Us = percentileUs(0.95);
+  snapshot.p99Us = percentileUs(0.99);
+
+  return snapshot;
+}
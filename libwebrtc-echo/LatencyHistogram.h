@@ -0,0 +1,59 @@
+/******************************************************************************
+* Filename: LatencyHistogram.h
+*
+* Description:
+* Fixed bucket histogram of durations in microseconds that can be added to
+* from any thread without locking. Each bucket counts the values up to and
+* including its bound, with an overflow bucket after the last bound.
+* Percentiles are estimated from the buckets as the bound of the bucket the
+* percentile falls in.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __LATENCY_HISTOGRAM__
+#define __LATENCY_HISTOGRAM__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct LatencyHistogramSnapshot
+{
+  uint64_t count;
+  uint64_t sumUs;
+  double meanUs;
+  int64_t maxUs;
+  double p50Us;
+  double p95Us;
+  double p99Us;
+
+  /* Per bucket counts, not cumulative, the last is the overflow bucket. */
+  std::vector<uint64_t> buckets;
+};
+
+class LatencyHistogram
+{
+public:
+  explicit LatencyHistogram(const std::vector<int64_t>& boundsUs);
+
+  void Add(int64_t valueUs);
+
+  const std::vector<int64_t>& GetBoundsUs() const { return _boundsUs; }
+  LatencyHistogramSnapshot GetSnapshot() const;
+
+private:
+  std::vector<int64_t> _boundsUs;
+  std::unique_ptr<std::atomic<uint64_t>[]> _buckets;
+  std::atomic<uint64_t> _sumUs{ 0 };
+  std::atomic<int64_t> _maxUs{ 0 };
+};
+
+#endif
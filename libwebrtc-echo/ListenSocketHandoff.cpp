@@ -0,0 +1,199 @@
+/******************************************************************************
+* Filename: ListenSocketHandoff.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "ListenSocketHandoff.h"
+#include "Logger.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define HANDOFF_ACK 'A'
+
+static bool ToUnixAddress(const std::string& path, sockaddr_un& addr)
+{
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof(addr.sun_path)) {
+    LOG_ERROR("Handoff socket path " << path << " is too long.");
+    return false;
+  }
+
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  return true;
+}
+
+bool ReceiveListenSocket(const std::string& handoffPath, std::function<bool(evutil_socket_t)> adopt)
+{
+  sockaddr_un addr;
+  if (!ToUnixAddress(handoffPath, addr)) {
+    return false;
+  }
+
+  int conn = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (conn < 0) {
+    LOG_ERROR("Failed to create handoff socket. " << strerror(errno));
+    return false;
+  }
+
+  if (connect(conn, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    /* Nothing running, the normal case for the first instance. */
+    close(conn);
+    return false;
+  }
+
+  /* Don't hang start up if the running server is wedged. */
+  timeval timeout{ HANDOFF_ACK_TIMEOUT_SECONDS, 0 };
+  setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char data = 0;
+  iovec iov{ &data, 1 };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  int listenSocket = -1;
+  if (recvmsg(conn, &msg, 0) > 0) {
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      memcpy(&listenSocket, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+
+  if (listenSocket < 0) {
+    LOG_ERROR("Running server at " << handoffPath << " didn't hand over its listening socket.");
+    close(conn);
+    return false;
+  }
+
+  if (!adopt(listenSocket)) {
+    close(listenSocket);
+    close(conn);
+    return false;
+  }
+
+  /* Once acknowledged the previous server stops accepting, a failed send leaves
+  * both accepting which is harmless. */
+  char ack = HANDOFF_ACK;
+  if (send(conn, &ack, 1, 0) != 1) {
+    LOG_ERROR("Failed to acknowledge listening socket handoff. " << strerror(errno));
+  }
+
+  close(conn);
+  return true;
+}
+
+evutil_socket_t CreateHandoffSocket(const std::string& handoffPath)
+{
+  sockaddr_un addr;
+  if (!ToUnixAddress(handoffPath, addr)) {
+    return -1;
+  }
+
+  int handoffSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (handoffSocket < 0) {
+    LOG_ERROR("Failed to create handoff socket. " << strerror(errno));
+    return -1;
+  }
+
+  /* Either stale or belonging to the server this one just took over from. */
+  unlink(handoffPath.c_str());
+
+  if (bind(handoffSocket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+    listen(handoffSocket, 1) != 0) {
+    LOG_ERROR("Failed to listen on handoff socket " << handoffPath << ". " << strerror(errno));
+    close(handoffSocket);
+    return -1;
+  }
+
+  evutil_make_socket_nonblocking(handoffSocket);
+  evutil_make_socket_closeonexec(handoffSocket);
+
+  return handoffSocket;
+}
+
+bool SendListenSocket(evutil_socket_t handoffSocket, evutil_socket_t listenSocket)
+{
+  int conn = accept(handoffSocket, nullptr, nullptr);
+  if (conn < 0) {
+    return false;
+  }
+
+  char data = 0;
+  iovec iov{ &data, 1 };
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &listenSocket, sizeof(int));
+
+  if (sendmsg(conn, &msg, 0) != 1) {
+    LOG_ERROR("Failed to send listening socket to replacement server. " << strerror(errno));
+    close(conn);
+    return false;
+  }
+
+  /* Blocks the event loop, but only for the moment it takes the replacement
+  * to start accepting. */
+  timeval timeout{ HANDOFF_ACK_TIMEOUT_SECONDS, 0 };
+  setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char ack = 0;
+  bool isAcked = recv(conn, &ack, 1, 0) == 1 && ack == HANDOFF_ACK;
+  close(conn);
+
+  if (!isAcked) {
+    LOG_ERROR("Replacement server didn't acknowledge the listening socket handoff.");
+  }
+
+  return isAcked;
+}
+
+#else
+
+bool ReceiveListenSocket(const std::string& handoffPath, std::function<bool(evutil_socket_t)> adopt)
+{
+  return false;
+}
+
+evutil_socket_t CreateHandoffSocket(const std::string& handoffPath)
+{
+  LOG_ERROR("Listening socket handoff is not supported on Windows.");
+  return -1;
+}
+
+bool SendListenSocket(evutil_socket_t handoffSocket, evutil_socket_t listenSocket)
+{
+  return false;
+}
+
+#endif
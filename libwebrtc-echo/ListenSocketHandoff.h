@@ -0,0 +1,59 @@
+/******************************************************************************
+* Filename: ListenSocketHandoff.h
+*
+* Description:
+* Passes the HTTP server's listening socket from a running server to its
+* replacement over a Unix domain socket (SCM_RIGHTS). The replacement
+* connects to the running server's handoff socket, receives a duplicate of
+* the listening socket, starts accepting on it and acknowledges. Only then
+* does the running server stop accepting and start draining, so there is no
+* point during a restart where nothing is accepting signaling connections.
+*
+* Only available on POSIX systems, on Windows the functions always fail.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __LISTEN_SOCKET_HANDOFF__
+#define __LISTEN_SOCKET_HANDOFF__
+
+#include <event2/util.h>
+
+#include <functional>
+#include <string>
+
+/* How long the running server waits for the replacement's acknowledgement. */
+#define HANDOFF_ACK_TIMEOUT_SECONDS 5
+
+/**
+* Connects to the handoff socket of a running server and receives its listening
+* socket. The adopt function is given the socket and returns true once it is
+* accepting on it, at which point the running server is told to stop.
+* @param[in] handoffPath: path of the running server's handoff socket.
+* @param[in] adopt: starts accepting on the received socket.
+* @@Returns true if a socket was received and adopted. False if no server is
+* running or the handoff failed, in which case the caller binds as normal.
+*/
+bool ReceiveListenSocket(const std::string& handoffPath, std::function<bool(evutil_socket_t)> adopt);
+
+/**
+* Creates the handoff socket the next server instance will connect to. Any
+* stale socket file at the path is removed first.
+* @@Returns the listening Unix socket or -1 on failure.
+*/
+evutil_socket_t CreateHandoffSocket(const std::string& handoffPath);
+
+/**
+* Accepts a connection on the handoff socket, sends the listening socket and
+* waits up to HANDOFF_ACK_TIMEOUT_SECONDS for the replacement to adopt it.
+* @@Returns true if the replacement is now accepting on the listening socket.
+*/
+bool SendListenSocket(evutil_socket_t handoffSocket, evutil_socket_t listenSocket);
+
+#endif
@@ -0,0 +1,132 @@
+/******************************************************************************
+* Filename: Logger.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "Logger.h"
+
+#include <cstdio>
+
+Logger& Logger::Instance()
+{
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger() :
+  _running(false),
+  _verboseSampleRate(1),
+  _verboseCount(0),
+  _dropped(0)
+{
+  _queue.reserve(LOGGER_MAX_QUEUED_LINES);
+}
+
+Logger::~Logger()
+{
+  Stop();
+}
+
+void Logger::Start()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  if (!_running) {
+    _running = true;
+    _writerThread = std::thread(&Logger::Run, this);
+  }
+}
+
+void Logger::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _running = false;
+  }
+  _cv.notify_all();
+
+  if (_writerThread.joinable()) {
+    _writerThread.join();
+  }
+}
+
+bool Logger::SampleVerbose()
+{
+  unsigned int sampleRate = _verboseSampleRate.load(std::memory_order_relaxed);
+  return sampleRate != 0 && (_verboseCount.fetch_add(1, std::memory_order_relaxed) % sampleRate) == 0;
+}
+
+void Logger::Write(LogLevel level, std::string line)
+{
+  std::unique_lock<std::mutex> lck(_mtx);
+
+  if (!_running) {
+    /* No writer thread, e.g. during start up or shut down, so write directly. */
+    std::vector<LogLine> lines{ { level, std::move(line) } };
+    Flush(lines);
+    return;
+  }
+
+  if (_queue.size() >= LOGGER_MAX_QUEUED_LINES) {
+    _dropped++;
+    return;
+  }
+
+  bool wasEmpty = _queue.empty();
+  _queue.push_back({ level, std::move(line) });
+  lck.unlock();
+
+  if (wasEmpty) {
+    _cv.notify_one();
+  }
+}
+
+void Logger::Run()
+{
+  std::vector<LogLine> lines;
+  lines.reserve(LOGGER_MAX_QUEUED_LINES);
+
+  std::unique_lock<std::mutex> lck(_mtx);
+
+  while (_running || !_queue.empty()) {
+    _cv.wait(lck, [this] { return !_running || !_queue.empty(); });
+
+    /* Swap the queue out so the lock isn't held while writing. */
+    lines.swap(_queue);
+    lck.unlock();
+
+    Flush(lines);
+    lines.clear();
+
+    uint64_t dropped = _dropped.exchange(0);
+    if (dropped > 0) {
+      fprintf(stderr, "Logger dropped %llu lines.\n", static_cast<unsigned long long>(dropped));
+    }
+
+    lck.lock();
+  }
+}
+
+void Logger::Flush(std::vector<LogLine>& lines)
+{
+  bool wroteStdout = false;
+
+  for (auto& line : lines) {
+    FILE* stream = (line.level == LogLevel::Error) ? stderr : stdout;
+    fwrite(line.text.data(), 1, line.text.size(), stream);
+    fputc('\n', stream);
+    wroteStdout |= stream == stdout;
+  }
+
+  if (wroteStdout) {
+    fflush(stdout);
+  }
+}
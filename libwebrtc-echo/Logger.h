@@ -0,0 +1,97 @@
+/******************************************************************************
+* Filename: Logger.h
+*
+* Description:
+* Asynchronous logger. Callers format a line and queue it, a background
+* thread writes queued lines to stdout/stderr in batches so the signaling
+* and WebRTC threads never block on console I/O. Verbose messages are
+* sampled, only one in every N is formatted and queued, so they can be left
+* in the hot paths.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __LOGGER__
+#define __LOGGER__
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Lines queued beyond this are dropped (and counted) rather than growing without bound. */
+#define LOGGER_MAX_QUEUED_LINES 10000
+
+enum class LogLevel
+{
+  Error,
+  Info,
+  Verbose
+};
+
+class Logger
+{
+public:
+  static Logger& Instance();
+
+  void Start();
+  void Stop();
+
+  /* Only 1 in every sampleRate verbose messages gets logged, 0 disables them. */
+  void SetVerboseSampleRate(unsigned int sampleRate) { _verboseSampleRate = sampleRate; }
+  bool SampleVerbose();
+
+  void Write(LogLevel level, std::string line);
+
+private:
+  struct LogLine
+  {
+    LogLevel level;
+    std::string text;
+  };
+
+  Logger();
+  ~Logger();
+
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::vector<LogLine> _queue;
+  std::thread _writerThread;
+  bool _running;
+  std::atomic<unsigned int> _verboseSampleRate;
+  std::atomic<unsigned int> _verboseCount;
+  std::atomic<uint64_t> _dropped;
+
+  void Run();
+  void Flush(std::vector<LogLine>& lines);
+};
+
+#define LOG_AT_LEVEL(level, msg) \
+  do { \
+    std::ostringstream _logStm; \
+    _logStm << msg; \
+    Logger::Instance().Write(level, _logStm.str()); \
+  } while (0)
+
+#define LOG_ERROR(msg) LOG_AT_LEVEL(LogLevel::Error, msg)
+#define LOG_INFO(msg) LOG_AT_LEVEL(LogLevel::Info, msg)
+
+/* The sampling decision is made before the message is formatted. */
+#define LOG_VERBOSE(msg) \
+  do { \
+    if (Logger::Instance().SampleVerbose()) { \
+      LOG_AT_LEVEL(LogLevel::Verbose, msg); \
+    } \
+  } while (0)
+
+#endif
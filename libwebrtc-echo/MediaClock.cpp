@@ -0,0 +1,103 @@
+/******************************************************************************
+* Filename: MediaClock.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "MediaClock.h"
+
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+#include <chrono>
+
+MediaClock& MediaClock::Instance()
+{
+  static MediaClock clock;
+  return clock;
+}
+
+MediaClock::MediaClock() :
+  _running(true),
+  _nextSubscriptionId(0)
+{
+  _clockThread = std::thread(&MediaClock::Run, this);
+}
+
+MediaClock::~MediaClock()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _running = false;
+  }
+  _cv.notify_all();
+  _clockThread.join();
+}
+
+int64_t MediaClock::NowUs()
+{
+  return rtc::TimeMicros();
+}
+
+int MediaClock::Subscribe(int64_t intervalUs, TickCallback callback)
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+
+  int id = ++_nextSubscriptionId;
+  _subscribers.push_back({ id, intervalUs, NowUs(), std::move(callback) });
+  _cv.notify_all();
+
+  return id;
+}
+
+void MediaClock::Unsubscribe(int subscriptionId)
+{
+  /* Callbacks run with the lock held so taking it waits out any tick in progress. */
+  std::lock_guard<std::mutex> lck(_mtx);
+
+  _subscribers.erase(std::remove_if(_subscribers.begin(), _subscribers.end(),
+    [subscriptionId](const Subscriber& sub) { return sub.id == subscriptionId; }),
+    _subscribers.end());
+}
+
+void MediaClock::Run()
+{
+  std::unique_lock<std::mutex> lck(_mtx);
+
+  while (_running) {
+    if (_subscribers.empty()) {
+      _cv.wait(lck);
+      continue;
+    }
+
+    int64_t nowUs = NowUs();
+    int64_t nextWakeUs = INT64_MAX;
+
+    for (auto& sub : _subscribers) {
+      if (sub.nextTickUs <= nowUs) {
+        sub.callback(sub.nextTickUs);
+
+        sub.nextTickUs += sub.intervalUs;
+        if (nowUs - sub.nextTickUs > MEDIA_CLOCK_MAX_CATCH_UP_TICKS * sub.intervalUs) {
+          sub.nextTickUs = nowUs + sub.intervalUs;
+        }
+      }
+
+      nextWakeUs = std::min(nextWakeUs, sub.nextTickUs);
+    }
+
+    /* Subscribers that are still due get picked up straight away on the next pass. */
+    int64_t waitUs = nextWakeUs - NowUs();
+    if (waitUs > 0) {
+      _cv.wait_for(lck, std::chrono::microseconds(waitUs));
+    }
+  }
+}
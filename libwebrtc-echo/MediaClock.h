@@ -0,0 +1,70 @@
+/******************************************************************************
+* Filename: MediaClock.h
+*
+* Description:
+* Shared clock for the synthetic media sources. A single thread ticks every
+* subscriber at its own interval from the steady clock, so any number of
+* fake audio devices and video sources are driven without a timer thread
+* each, and sources with the same interval tick in lock step. Tick times are
+* on the rtc::TimeMicros clock so they can be used directly as capture times.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __MEDIA_CLOCK__
+#define __MEDIA_CLOCK__
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A subscriber that falls further behind than this many intervals skips ahead
+* rather than being ticked in a burst to catch up. */
+#define MEDIA_CLOCK_MAX_CATCH_UP_TICKS 10
+
+class MediaClock
+{
+public:
+  typedef std::function<void(int64_t tickTimeUs)> TickCallback;
+
+  static MediaClock& Instance();
+
+  /* Callbacks run on the clock thread and must not subscribe or unsubscribe. */
+  int Subscribe(int64_t intervalUs, TickCallback callback);
+
+  /* On return the subscriber's callback is not running and won't be called again. */
+  void Unsubscribe(int subscriptionId);
+
+private:
+  struct Subscriber
+  {
+    int id;
+    int64_t intervalUs;
+    int64_t nextTickUs;
+    TickCallback callback;
+  };
+
+  MediaClock();
+  ~MediaClock();
+
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::vector<Subscriber> _subscribers;
+  std::thread _clockThread;
+  bool _running;
+  int _nextSubscriptionId;
+
+  void Run();
+  static int64_t NowUs();
+};
+
+#endif
@@ -0,0 +1,129 @@
+/******************************************************************************
+* Filename: ObjectPool.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "ObjectPool.h"
+#include "Logger.h"
+
+#include <new>
+
+ObjectPool::ObjectPool(const char* name) :
+  _name(name),
+  _blockSize(0),
+  _allocations(0),
+  _heapAllocations(0),
+  _live(0)
+{ }
+
+std::mutex& ObjectPool::RegistryMutex()
+{
+  static std::mutex* mtx = new std::mutex();
+  return *mtx;
+}
+
+std::vector<ObjectPool*>& ObjectPool::Registry()
+{
+  static std::vector<ObjectPool*>* registry = new std::vector<ObjectPool*>();
+  return *registry;
+}
+
+ObjectPool& ObjectPool::Create(const char* name)
+{
+  ObjectPool* pool = new ObjectPool(name);
+
+  std::lock_guard<std::mutex> lck(RegistryMutex());
+  Registry().push_back(pool);
+
+  return *pool;
+}
+
+void* ObjectPool::Allocate(size_t size)
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+
+    _allocations++;
+    _live++;
+
+    /* A pool serves one size, the size of its class. */
+    if (_blockSize == 0) {
+      _blockSize = size;
+    }
+
+    if (size == _blockSize && !_free.empty()) {
+      void* block = _free.back();
+      _free.pop_back();
+      return block;
+    }
+
+    _heapAllocations++;
+  }
+
+  return ::operator new(size);
+}
+
+void ObjectPool::Free(void* block, size_t size)
+{
+  if (block == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+
+    _live--;
+
+    if (size == _blockSize && _free.size() < OBJECT_POOL_MAX_FREE) {
+      _free.push_back(block);
+      return;
+    }
+  }
+
+  ::operator delete(block);
+}
+
+ObjectPoolStats ObjectPool::GetStats()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return { _name, _allocations, _heapAllocations, _live, _free.size() };
+}
+
+std::vector<ObjectPoolStats> ObjectPool::GetAllStats()
+{
+  std::vector<ObjectPool*> pools;
+  {
+    std::lock_guard<std::mutex> lck(RegistryMutex());
+    pools = Registry();
+  }
+
+  std::vector<ObjectPoolStats> stats;
+  for (auto pool : pools) {
+    stats.push_back(pool->GetStats());
+  }
+
+  return stats;
+}
+
+bool ObjectPool::LogLiveObjects()
+{
+  bool isClean = true;
+
+  for (auto& stats : GetAllStats()) {
+    if (stats.live > 0) {
+      LOG_ERROR(stats.live << " " << stats.name << " objects were never freed.");
+      isClean = false;
+    }
+  }
+
+  return isClean;
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+* Filename: ObjectPool.h
+*
+* Description:
+* Free list pools for the small objects created on every offer and stats
+* request, the SDP and stats observers and the peer connection observer.
+* Deriving a class from PooledObject gives it an operator new and delete
+* that reuse blocks from the class's pool, so a server that's been up for
+* days handles a steady stream of offers without churning the heap. Blocks
+* go back on the free list when an object is deleted, the heap only gets
+* involved when the free list is empty or above its limit.
+*
+* Every pool counts its live objects. They're reported in /stats and any
+* still alive once the factory has shut down are logged as leaks.
+*
+* A pooled class needs DECLARE_OBJECT_POOL(Class) after its definition and
+* DEFINE_OBJECT_POOL(Class) in one source file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __OBJECT_POOL__
+#define __OBJECT_POOL__
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Free blocks kept per pool, beyond this they go back to the heap. */
+#define OBJECT_POOL_MAX_FREE 1024
+
+struct ObjectPoolStats
+{
+  std::string name;
+  uint64_t allocations;
+  uint64_t heapAllocations;
+  uint64_t live;
+  size_t free;
+};
+
+class ObjectPool
+{
+public:
+  /* Pools are never destroyed, objects can outlive any static destruction order. */
+  static ObjectPool& Create(const char* name);
+
+  static std::vector<ObjectPoolStats> GetAllStats();
+
+  /* Logs every pool that still has live objects, returns false if any do. */
+  static bool LogLiveObjects();
+
+  void* Allocate(size_t size);
+  void Free(void* block, size_t size);
+
+  ObjectPoolStats GetStats();
+
+private:
+  explicit ObjectPool(const char* name);
+
+  std::mutex _mtx;
+  std::string _name;
+  size_t _blockSize;
+  std::vector<void*> _free;
+  uint64_t _allocations;
+  uint64_t _heapAllocations;
+  uint64_t _live;
+
+  static std::mutex& RegistryMutex();
+  static std::vector<ObjectPool*>& Registry();
+};
+
+template<typename T>
+class PooledObject
+{
+public:
+  static void* operator new(size_t size) { return GetPool().Allocate(size); }
+  static void operator delete(void* block, size_t size) { GetPool().Free(block, size); }
+
+  static ObjectPool& GetPool();
+};
+
+#define DECLARE_OBJECT_POOL(T) template<> ObjectPool& PooledObject<T>::GetPool();
+
+#define DEFINE_OBJECT_POOL(T) \
+  template<> ObjectPool& PooledObject<T>::GetPool() \
+  { \
+    static ObjectPool& pool = ObjectPool::Create(#T); \
+    return pool; \
+  }
+
+#endif
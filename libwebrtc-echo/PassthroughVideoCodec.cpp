@@ -0,0 +1,246 @@
+/******************************************************************************
+* Filename: PassthroughVideoCodec.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "PassthroughVideoCodec.h"
+
+#include <api/video/encoded_image.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame.h>
+#include <api/video/video_frame_buffer.h>
+#include <api/video_codecs/video_decoder.h>
+#include <api/video_codecs/video_encoder.h>
+#include <media/base/media_constants.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include <atomic>
+
+/* Set by the encoder when the remote peer wants a key frame, cleared by the
+* decoder once it's passed the request on to the sending peer. */
+typedef std::shared_ptr<std::atomic<bool>> KeyFrameRequest;
+
+/**
+* Native buffer carrying an encoded frame from the passthrough decoder to the
+* passthrough encoder. Nothing should need the pixels, if anything does ask
+* it gets a black frame.
+*/
+class EncodedFrameBuffer :
+  public webrtc::VideoFrameBuffer
+{
+public:
+  EncodedFrameBuffer(const webrtc::EncodedImage& image, int width, int height, KeyFrameRequest keyFrameRequest) :
+    _image(image),
+    _width(width),
+    _height(height),
+    _keyFrameRequest(keyFrameRequest)
+  {
+    /* The decoder's input is released once Decode returns so the data is copied. */
+    _image.SetEncodedData(webrtc::EncodedImageBuffer::Create(image.data(), image.size()));
+  }
+
+  Type type() const override { return Type::kNative; }
+  int width() const override { return _width; }
+  int height() const override { return _height; }
+
+  rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override
+  {
+    auto buffer = webrtc::I420Buffer::Create(_width, _height);
+    webrtc::I420Buffer::SetBlack(buffer);
+    return buffer;
+  }
+
+  const webrtc::EncodedImage& image() const { return _image; }
+  void RequestKeyFrame() { *_keyFrameRequest = true; }
+
+private:
+  webrtc::EncodedImage _image;
+  int _width;
+  int _height;
+  KeyFrameRequest _keyFrameRequest;
+};
+
+class PassthroughVideoDecoder :
+  public webrtc::VideoDecoder
+{
+public:
+  PassthroughVideoDecoder() :
+    _callback(nullptr),
+    _width(0),
+    _height(0),
+    _keyFrameRequest(std::make_shared<std::atomic<bool>>(false))
+  { }
+
+  int32_t InitDecode(const webrtc::VideoCodec* codecSettings, int32_t numberOfCores) override
+  {
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Decode(const webrtc::EncodedImage& inputImage, bool missingFrames, int64_t renderTimeMs) override
+  {
+    if (_callback == nullptr) {
+      return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    }
+
+    /* Only key frames carry the resolution. */
+    if (inputImage._encodedWidth != 0 && inputImage._encodedHeight != 0) {
+      _width = inputImage._encodedWidth;
+      _height = inputImage._encodedHeight;
+    }
+
+    if (_width == 0 || _height == 0) {
+      return WEBRTC_VIDEO_CODEC_OK_REQUEST_KEYFRAME;
+    }
+
+    auto frame = webrtc::VideoFrame::Builder()
+      .set_video_frame_buffer(new rtc::RefCountedObject<EncodedFrameBuffer>(
+        inputImage, _width, _height, _keyFrameRequest))
+      .set_timestamp_rtp(inputImage.Timestamp())
+      .set_timestamp_ms(renderTimeMs)
+      .set_ntp_time_ms(inputImage.ntp_time_ms_)
+      .set_rotation(inputImage.rotation_)
+      .build();
+
+    _callback->Decoded(frame);
+
+    return _keyFrameRequest->exchange(false) ? WEBRTC_VIDEO_CODEC_OK_REQUEST_KEYFRAME : WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterDecodeCompleteCallback(webrtc::DecodedImageCallback* callback) override
+  {
+    _callback = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override
+  {
+    _callback = nullptr;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  const char* ImplementationName() const override { return "Passthrough"; }
+
+private:
+  webrtc::DecodedImageCallback* _callback;
+  int _width;
+  int _height;
+  KeyFrameRequest _keyFrameRequest;
+};
+
+class PassthroughVideoEncoder :
+  public webrtc::VideoEncoder
+{
+public:
+  PassthroughVideoEncoder() :
+    _callback(nullptr)
+  { }
+
+  int InitEncode(const webrtc::VideoCodec* codecSettings, const webrtc::VideoEncoder::Settings& settings) override
+  {
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override
+  {
+    _callback = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override
+  {
+    _callback = nullptr;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Encode(const webrtc::VideoFrame& frame, const std::vector<webrtc::VideoFrameType>* frameTypes) override
+  {
+    if (_callback == nullptr) {
+      return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    }
+
+    /* Only the passthrough decoder produces native buffers in this application. */
+    if (frame.video_frame_buffer()->type() != webrtc::VideoFrameBuffer::Type::kNative) {
+      return WEBRTC_VIDEO_CODEC_OK;
+    }
+
+    auto encodedFrame = static_cast<EncodedFrameBuffer*>(frame.video_frame_buffer().get());
+
+    if (frameTypes != nullptr) {
+      for (auto frameType : *frameTypes) {
+        if (frameType == webrtc::VideoFrameType::kVideoFrameKey &&
+          encodedFrame->image()._frameType != webrtc::VideoFrameType::kVideoFrameKey) {
+          encodedFrame->RequestKeyFrame();
+        }
+      }
+    }
+
+    webrtc::EncodedImage image = encodedFrame->image();
+    image.SetTimestamp(frame.timestamp());
+    image.capture_time_ms_ = frame.render_time_ms();
+    image.ntp_time_ms_ = frame.ntp_time_ms();
+
+    webrtc::CodecSpecificInfo codecInfo;
+    codecInfo.codecType = webrtc::kVideoCodecVP8;
+    codecInfo.codecSpecific.VP8.nonReference = false;
+    codecInfo.codecSpecific.VP8.temporalIdx = webrtc::kNoTemporalIdx;
+    codecInfo.codecSpecific.VP8.layerSync = false;
+    codecInfo.codecSpecific.VP8.keyIdx = webrtc::kNoKeyIdx;
+
+    _callback->OnEncodedImage(image, &codecInfo);
+
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  void SetRates(const webrtc::VideoEncoder::RateControlParameters& parameters) override
+  {
+    /* The bitrate is whatever the sending peer chose. */
+  }
+
+  webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override
+  {
+    webrtc::VideoEncoder::EncoderInfo info;
+    info.implementation_name = "Passthrough";
+    info.supports_native_handle = true;
+    /* Stops the send stream dropping frames to meet its rate, a dropped frame
+    * would break the forwarded reference chain. */
+    info.has_trusted_rate_controller = true;
+    info.scaling_settings = webrtc::VideoEncoder::ScalingSettings::kOff;
+    return info;
+  }
+
+private:
+  webrtc::EncodedImageCallback* _callback;
+};
+
+std::vector<webrtc::SdpVideoFormat> PassthroughVideoDecoderFactory::GetSupportedFormats() const
+{
+  return { webrtc::SdpVideoFormat(cricket::kVp8CodecName) };
+}
+
+std::unique_ptr<webrtc::VideoDecoder> PassthroughVideoDecoderFactory::CreateVideoDecoder(
+  const webrtc::SdpVideoFormat& format)
+{
+  return std::make_unique<PassthroughVideoDecoder>();
+}
+
+std::vector<webrtc::SdpVideoFormat> PassthroughVideoEncoderFactory::GetSupportedFormats() const
+{
+  return { webrtc::SdpVideoFormat(cricket::kVp8CodecName) };
+}
+
+std::unique_ptr<webrtc::VideoEncoder> PassthroughVideoEncoderFactory::CreateVideoEncoder(
+  const webrtc::SdpVideoFormat& format)
+{
+  return std::make_unique<PassthroughVideoEncoder>();
+}
@@ -0,0 +1,49 @@
+/******************************************************************************
+* Filename: PassthroughVideoCodec.h
+*
+* Description:
+* Decoder and encoder factories for echoing VP8 without transcoding. The
+* passthrough decoder doesn't decode, it wraps a copy of each received frame
+* in a native video frame buffer. That frame travels the normal path from the
+* receiving track to the echo sender, where the passthrough encoder unwraps
+* it and hands the original encoded frame to the packetizer.
+*
+* The echo sender can't produce key frames itself. When the remote peer asks
+* for one the request is passed back through the frame buffer to the decoder,
+* which asks the sending peer for a key frame in turn.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __PASSTHROUGH_VIDEO_CODEC__
+#define __PASSTHROUGH_VIDEO_CODEC__
+
+#include <api/video_codecs/video_decoder_factory.h>
+#include <api/video_codecs/video_encoder_factory.h>
+
+#include <memory>
+#include <vector>
+
+class PassthroughVideoDecoderFactory :
+  public webrtc::VideoDecoderFactory
+{
+public:
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+  std::unique_ptr<webrtc::VideoDecoder> CreateVideoDecoder(const webrtc::SdpVideoFormat& format) override;
+};
+
+class PassthroughVideoEncoderFactory :
+  public webrtc::VideoEncoderFactory
+{
+public:
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+  std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(const webrtc::SdpVideoFormat& format) override;
+};
+
+#endif
@@ -13,7 +13,9 @@
 /******************************************************************************/
 
 #include "PcFactory.h"
-#include "json.hpp"
+#include "EventLogCapture.h"
+#include "Logger.h"
+#include "PreEncodedVideoEncoderFactory.h"
 
 #include "api/audio_codecs/audio_decoder_factory_template.h"
 #include "api/audio_codecs/audio_encoder_factory_template.h"
@@ -21,22 +23,55 @@
 #include <api/audio_codecs/audio_encoder_factory.h>
 #include <api/audio_codecs/builtin_audio_decoder_factory.h>
 #include <api/audio_codecs/builtin_audio_encoder_factory.h>
+#include <api/call/call_factory_interface.h>
 #include "api/audio_codecs/g711/audio_decoder_g711.h"
 #include "api/audio_codecs/g711/audio_encoder_g711.h"
 #include <api/create_peerconnection_factory.h>
+#include <api/jsep.h>
 #include <api/peer_connection_interface.h>
 #include <api/rtc_event_log/rtc_event_log_factory.h>
 #include <api/task_queue/default_task_queue_factory.h>
+#include <api/transport/field_trial_based_config.h>
 #include <api/video_codecs/builtin_video_decoder_factory.h>
 #include <api/video_codecs/builtin_video_encoder_factory.h>
 #include <api/video_codecs/video_decoder_factory.h>
 #include <api/video_codecs/video_encoder_factory.h>
 #include <media/engine/webrtc_media_engine.h>
+#include <p2p/base/p2p_constants.h>
+#include <rtc_base/helpers.h>
+#include <rtc_base/rtc_certificate_generator.h>
+#include <rtc_base/time_utils.h>
 
-#include <iostream>
+#include <set>
 #include <sstream>
+#include <stdexcept>
+
+/* Fresh per-session values for a cached answer. The senders take their SSRCs
+* and stream ids from the answer, so each connection needs its own. */
+static AnswerSessionValues CreateAnswerSessionValues(const AnswerTemplate& answerTemplate) {
+  AnswerSessionValues values;
+  values.sessionId = std::to_string(rtc::CreateRandomId64() & INT64_MAX);
+  values.iceUfrag = rtc::CreateRandomString(cricket::ICE_UFRAG_LENGTH);
+  values.icePwd = rtc::CreateRandomString(cricket::ICE_PWD_LENGTH);
+  values.cname = rtc::CreateRandomString(16);
+
+  std::set<uint32_t> ssrcs;
+  while (ssrcs.size() < answerTemplate.ssrcCount) {
+    uint32_t ssrc = rtc::CreateRandomNonZeroId();
+    if (ssrcs.insert(ssrc).second) {
+      values.ssrcs.push_back(std::to_string(ssrc));
+    }
+  }
+
+  for (size_t i = 0; i < answerTemplate.streamIdCount; i++) {
+    values.streamIds.push_back(rtc::CreateRandomUuid());
+  }
+
+  return values;
+}
 
-PcFactory::PcFactory() :
+PcFactory::PcFactory(const SyntheticMediaConfig& mediaConfig, const CodecProfile& codecProfile,
+  const EventLogConfig& eventLogConfig, const CpuPlacementPlan& placement) :
   _peerConnections()
 {  
   //webrtc::PeerConnectionFactoryDependencies _pcf_deps;
@@ -76,111 +111,534 @@ PcFactory::PcFactory() :
 
   //_peerConnectionFactory = webrtc::CreateModularPeerConnectionFactory(std::move(_pcf_deps));
 
-  _networkThread = rtc::Thread::CreateWithSocketServer();
+  _networkThread = InstrumentedThread::CreateWithSocketServer();
+  _networkThread->SetName("network", nullptr);
+  _networkThread->SetPlacement(placement.network);
   _networkThread->Start();
-  _workerThread = rtc::Thread::Create();
+  _workerThread = InstrumentedThread::Create();
+  _workerThread->SetName("worker", nullptr);
+  _workerThread->SetPlacement(placement.worker);
   _workerThread->Start();
-  _signalingThread = rtc::Thread::Create();
+  _signalingThread = InstrumentedThread::Create();
+  _signalingThread->SetName("signaling", nullptr);
+  _signalingThread->SetPlacement(placement.signaling);
   _signalingThread->Start();
 
-  _fakeAudioCapture = FakeAudioCaptureModule::Create();
+  _audioDevice = new rtc::RefCountedObject<SyntheticAudioDevice>(
+    mediaConfig.audioSampleRate, mediaConfig.audioChannels);
+
+  std::unique_ptr<webrtc::VideoEncoderFactory> videoEncoderFactory;
+  if (mediaConfig.preEncodedVideo) {
+    videoEncoderFactory = std::make_unique<PreEncodedVideoEncoderFactory>(
+      mediaConfig.videoWidth, mediaConfig.videoHeight, mediaConfig.videoFps);
+  }
+  else {
+    videoEncoderFactory = webrtc::CreateBuiltinVideoEncoderFactory();
+  }
+
+  /* Assembled by hand rather than with CreatePeerConnectionFactory, which
+  * replaces a null audio processing module with a default one. Without --apm
+  * there's really no audio processing. */
+  webrtc::PeerConnectionFactoryDependencies pcfDeps;
+  pcfDeps.network_thread = _networkThread.get();
+  pcfDeps.worker_thread = _workerThread.get();
+  pcfDeps.signaling_thread = _signalingThread.get();
+  pcfDeps.task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+  pcfDeps.call_factory = webrtc::CreateCallFactory();
+  pcfDeps.event_log_factory = std::make_unique<CaptureEventLogFactory>(eventLogConfig, pcfDeps.task_queue_factory.get());
+  pcfDeps.trials = std::make_unique<webrtc::FieldTrialBasedConfig>();
+
+  cricket::MediaEngineDependencies mediaDeps;
+  mediaDeps.task_queue_factory = pcfDeps.task_queue_factory.get();
+  mediaDeps.adm = rtc::scoped_refptr<webrtc::AudioDeviceModule>(_audioDevice);
+  mediaDeps.audio_encoder_factory = CreateProfileAudioEncoderFactory(codecProfile);
+  mediaDeps.audio_decoder_factory = CreateProfileAudioDecoderFactory(codecProfile);
+  mediaDeps.audio_processing = CreateProfileAudioProcessing(codecProfile);
+  mediaDeps.video_encoder_factory = CreateProfileVideoEncoderFactory(codecProfile, std::move(videoEncoderFactory));
+  mediaDeps.video_decoder_factory = CreateProfileVideoDecoderFactory(codecProfile);
+  mediaDeps.trials = pcfDeps.trials.get();
+
+  pcfDeps.media_engine = cricket::CreateMediaEngine(std::move(mediaDeps));
+
+  _peerConnectionFactory = webrtc::CreateModularPeerConnectionFactory(std::move(pcfDeps));
+  if (!_peerConnectionFactory) {
+    throw std::runtime_error("Failed to create peer connection factory.");
+  }
 
-  _peerConnectionFactory = webrtc::CreatePeerConnectionFactory(
-    _networkThread.get() /* network_thread */,
-    _workerThread.get() /* worker_thread */,
-    _signalingThread.get() /* signaling_thread */,
-    //nullptr /* default_adm */,
-    //webrtc::AudioDeviceModuleForTest::CreateForTest(webrtc::AudioDeviceModule::AudioLayer::kDummyAudio, webrtc::CreateDefaultTaskQueueFactory().release()),
-    rtc::scoped_refptr<webrtc::AudioDeviceModule>(_fakeAudioCapture),
-    webrtc::CreateAudioEncoderFactory<webrtc::AudioEncoderG711>(),
-    webrtc::CreateAudioDecoderFactory<webrtc::AudioDecoderG711>(),
-    webrtc::CreateBuiltinVideoEncoderFactory(),
-    webrtc::CreateBuiltinVideoDecoderFactory(),
-    nullptr /* audio_mixer */,
-    nullptr); //webrtc::AudioProcessingBuilder().Create() /* audio_processing */);
+  /* One certificate for every peer connection, saves generating a key per
+  * connection and keeps the fingerprint in cached answers valid. */
+  _certificate = rtc::RTCCertificateGenerator::GenerateCertificate(rtc::KeyParams::ECDSA(), absl::nullopt);
+  if (!_certificate) {
+    throw std::runtime_error("Failed to generate DTLS certificate.");
+  }
 }
 
 PcFactory::~PcFactory()
 {
-  for (auto pc : _peerConnections) {
-    pc->Close();
+  std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+  for (auto& entry : _peerConnections) {
+    entry.pc->Close();
   }
   _peerConnections.clear();
   _peerConnectionFactory = nullptr;
 }
 
-std::string PcFactory::CreatePeerConnection(const char* buffer, int length) {
+bool PcFactory::CreatePeerConnection(const std::string& offerSdp, std::string& answerSdp,
+  std::string* peerConnectionId) {
+
+  LOG_VERBOSE("Remote offer:\n" << offerSdp);
 
-  std::string offerStr(buffer, length);
-  auto offerJson = nlohmann::json::parse(offerStr);
+  webrtc::SdpParseError sdpError;
+  auto remoteOffer = webrtc::CreateSessionDescription(webrtc::SdpType::kOffer, offerSdp, &sdpError);
 
-  std::cout << offerJson.dump() << std::endl;
+  if (remoteOffer == nullptr) {
+    LOG_ERROR("Failed to parse remote SDP. " << sdpError.description);
+    return false;
+  }
 
   webrtc::PeerConnectionInterface::RTCConfiguration config;
   config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
   config.enable_dtls_srtp = true;
+  config.certificates.push_back(_certificate);
 
   auto observer = new rtc::RefCountedObject<PcObserver>();
+  int64_t createStartUs = SetupTracer::NowUs();
 
   auto pcOrError = _peerConnectionFactory->CreatePeerConnectionOrError(
     config, webrtc::PeerConnectionDependencies(observer));
 
-  rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc = nullptr;
+  if (!pcOrError.ok()) {
+    LOG_ERROR("Failed to get peer connection from factory. " << pcOrError.error().message());
+    return false;
+  }
+
+  auto pc = pcOrError.MoveValue();
+  uint64_t traceId = ++_nextPeerConnectionId;
+  std::string id = std::to_string(traceId);
+
+  _setupTracer.Record(traceId, SetupStage::CreatePeerConnection, createStartUs, SetupTracer::NowUs());
+  observer->SetSetupTrace(&_setupTracer, traceId);
+
+  /* Registered before setup so a drain counts it, every failure return below
+  * has to close and forget it again. */
+  {
+    std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+    _peerConnections.push_back({ id, pc, observer, rtc::TimeMillis() });
+  }
+
+  if (peerConnectionId != nullptr) {
+    *peerConnectionId = id;
+  }
+
+  if (!_answerCache.IsEnabled()) {
+    LOG_VERBOSE("Setting remote description on peer connection.");
+    auto remoteObs = new rtc::RefCountedObject<SetRemoteSdpObserver>();
+    remoteObs->SetSetupTrace(&_setupTracer, traceId);
+    pc->SetRemoteDescription(std::move(remoteOffer), remoteObs);
+
+    /* The span includes waiting for the remote description queued ahead of it. */
+    int64_t localStartUs = SetupTracer::NowUs();
+    if (!SetLocalDescriptionAndWait(pc)) {
+      LOG_ERROR("Failed to set local description.");
+      ClosePeerConnection(id);
+      return false;
+    }
+
+    _setupTracer.Record(traceId, SetupStage::SetLocalDescription, localStartUs, SetupTracer::NowUs());
+    observer->TraceLocalDescriptionSet();
+
+    pc->local_description()->ToString(&answerSdp);
+
+    LOG_VERBOSE("Create answer complete:\n" << answerSdp);
+
+    return true;
+  }
+
+  /* The echo tracks are attached while the remote description is applied, they
+  * need to be in place before the answer can be filled in. */
+  LOG_VERBOSE("Setting remote description on peer connection.");
+  int64_t remoteStartUs = SetupTracer::NowUs();
+  if (!SetRemoteDescriptionAndWait(pc, std::move(remoteOffer))) {
+    LOG_ERROR("Failed to set remote description.");
+    ClosePeerConnection(id);
+    return false;
+  }
+
+  int64_t localStartUs = SetupTracer::NowUs();
+  _setupTracer.Record(traceId, SetupStage::SetRemoteDescription, remoteStartUs, localStartUs);
+
+  std::string normalizedOffer = AnswerCache::NormalizeOffer(offerSdp);
+  auto answerTemplate = _answerCache.Lookup(normalizedOffer);
+
+  if (answerTemplate != nullptr) {
+    MidTracks midTracks = GetMidTracks(pc);
+
+    if (AnswerCache::Fill(*answerTemplate, midTracks, CreateAnswerSessionValues(*answerTemplate), answerSdp)) {
+
+      auto answer = webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, answerSdp, &sdpError);
+      if (answer != nullptr && SetLocalDescriptionAndWait(pc, std::move(answer))) {
+        _setupTracer.Record(traceId, SetupStage::SetLocalDescription, localStartUs, SetupTracer::NowUs());
+        observer->TraceLocalDescriptionSet();
+        _answerCache.RecordHit();
+
+        LOG_VERBOSE("Cached answer applied:\n" << answerSdp);
+        return true;
+      }
+    }
+
+    LOG_INFO("Cached answer rejected, falling back to creating the answer.");
+    _answerCache.RecordFallback(normalizedOffer);
+  }
+
+  if (!SetLocalDescriptionAndWait(pc)) {
+    LOG_ERROR("Failed to set local description.");
+    ClosePeerConnection(id);
+    return false;
+  }
+
+  _setupTracer.Record(traceId, SetupStage::SetLocalDescription, localStartUs, SetupTracer::NowUs());
+  observer->TraceLocalDescriptionSet();
+
+  pc->local_description()->ToString(&answerSdp);
+  _answerCache.Store(normalizedOffer, answerSdp, GetMidTracks(pc));
+
+  LOG_VERBOSE("Create answer complete:\n" << answerSdp);
+
+  return true;
+}
+
+PeerConnectionEntry PcFactory::CreateOfferPeerConnection(
+  rtc::scoped_refptr<webrtc::VideoTrackSourceInterface> videoSource, std::string& offerSdp) {
+
+  webrtc::PeerConnectionInterface::RTCConfiguration config;
+  config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+  config.enable_dtls_srtp = true;
+  config.certificates.push_back(_certificate);
+
+  /* The offering side must not echo back what it receives. */
+  PeerConnectionEntry entry;
+  entry.id = std::to_string(++_nextPeerConnectionId);
+  entry.createdAtMs = rtc::TimeMillis();
+  entry.observer = new rtc::RefCountedObject<PcObserver>(false);
+
+  auto pcOrError = _peerConnectionFactory->CreatePeerConnectionOrError(
+    config, webrtc::PeerConnectionDependencies(entry.observer.get()));
 
   if (!pcOrError.ok()) {
-    std::cerr << "Failed to get peer connection from factory. " << pcOrError.error().message() << std::endl;
-    return "error";
+    LOG_ERROR("Failed to get peer connection from factory. " << pcOrError.error().message());
+    return entry;
   }
-  else {
-    pc = pcOrError.MoveValue();
 
-    _peerConnections.push_back(pc);
+  auto pc = pcOrError.MoveValue();
+  std::vector<std::string> streamIds{ "stream" + entry.id };
 
-    webrtc::SdpParseError sdpError;
-    auto remoteOffer = webrtc::CreateSessionDescription(webrtc::SdpType::kOffer, offerJson["sdp"], &sdpError);
+  auto audioSource = _peerConnectionFactory->CreateAudioSource(cricket::AudioOptions());
+  auto audioTrack = _peerConnectionFactory->CreateAudioTrack("audio" + entry.id, audioSource.get());
+  if (!pc->AddTrack(audioTrack, streamIds).ok()) {
+    LOG_ERROR("Failed to add audio track.");
+  }
 
-    if (remoteOffer == nullptr) {
-      std::cerr << "Failed to get parse remote SDP." << std::endl;
-      return "error";
+  if (videoSource) {
+    auto videoTrack = _peerConnectionFactory->CreateVideoTrack("video" + entry.id, videoSource.get());
+    if (!pc->AddTrack(videoTrack, streamIds).ok()) {
+      LOG_ERROR("Failed to add video track.");
     }
-    else {
-      std::cout << "Setting remote description on peer connection." << std::endl;
-      auto setRemoteObserver = new rtc::RefCountedObject<SetRemoteSdpObserver>();
-      pc->SetRemoteDescription(remoteOffer->Clone(), setRemoteObserver);
+  }
+
+  if (!SetLocalDescriptionAndWait(pc)) {
+    pc->Close();
+    return entry;
+  }
+
+  pc->local_description()->ToString(&offerSdp);
+  entry.pc = pc;
+
+  {
+    std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+    _peerConnections.push_back(entry);
+  }
+
+  return entry;
+}
+
+bool PcFactory::SetRemoteAnswer(const PeerConnectionEntry& entry, const std::string& answerSdp) {
+  webrtc::SdpParseError sdpError;
+  auto remoteAnswer = webrtc::CreateSessionDescription(webrtc::SdpType::kAnswer, answerSdp, &sdpError);
 
-      std::mutex mtx;
-      std::condition_variable cv;
-      bool isReady = false;
+  if (remoteAnswer == nullptr) {
+    LOG_ERROR("Failed to parse remote SDP answer. " << sdpError.description);
+    return false;
+  }
+
+  entry.pc->SetRemoteDescription(std::move(remoteAnswer), new rtc::RefCountedObject<SetRemoteSdpObserver>());
+  return true;
+}
+
+static std::string GetSdpAttribute(const std::string& sdp, const std::string& name) {
+  std::string prefix = "a=" + name + ":";
+  size_t start = sdp.compare(0, prefix.size(), prefix) == 0 ? 0 : sdp.find("\n" + prefix);
+
+  if (start == std::string::npos) {
+    return "";
+  }
 
-      auto createObs = new rtc::RefCountedObject<CreateSdpObserver>(mtx, cv, isReady);
-      pc->SetLocalDescription(createObs);
+  start += (start == 0 ? 0 : 1) + prefix.size();
+  size_t end = sdp.find_first_of("\r\n", start);
+  return sdp.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
 
-      std::unique_lock<std::mutex> lck(mtx);
+TrickleResult PcFactory::AddRemoteCandidates(const std::string& peerConnectionId, const std::string& sdpFragment) {
+  rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc;
 
-      if (!isReady) {
-        std::cout << "Waiting for create answer to complete..." << std::endl;
-        cv.wait(lck);
+  {
+    std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+    for (auto& entry : _peerConnections) {
+      if (entry.id == peerConnectionId) {
+        pc = entry.pc;
+        break;
       }
+    }
+  }
 
-      auto localDescription = pc->local_description();
+  if (pc == nullptr) {
+    return TrickleResult::NotFound;
+  }
 
-      if (localDescription == nullptr) {
-        return "Failed to set local description.";
+  std::string remoteSdp;
+  if (pc->remote_description() == nullptr || !pc->remote_description()->ToString(&remoteSdp)) {
+    return TrickleResult::Invalid;
+  }
+
+  std::string ufrag = GetSdpAttribute(sdpFragment, "ice-ufrag");
+  if (!ufrag.empty() && ufrag != GetSdpAttribute(remoteSdp, "ice-ufrag")) {
+    return TrickleResult::IceRestart;
+  }
+
+  /* The fragment's m lines follow the order of the offer's, each one's
+  * candidates come after its mid. */
+  int mlineIndex = 0;
+  int mlineCount = 0;
+  std::string mid;
+  std::istringstream lines(sdpFragment);
+  std::string line;
+
+  while (std::getline(lines, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    if (line.compare(0, 2, "m=") == 0) {
+      mlineIndex = mlineCount++;
+      mid.clear();
+    }
+    else if (line.compare(0, 6, "a=mid:") == 0) {
+      mid = line.substr(6);
+    }
+    else if (line.compare(0, 12, "a=candidate:") == 0) {
+      webrtc::SdpParseError sdpError;
+      std::unique_ptr<webrtc::IceCandidateInterface> candidate(
+        webrtc::CreateIceCandidate(mid, mlineIndex, line.substr(2), &sdpError));
+
+      if (candidate == nullptr) {
+        LOG_ERROR("Failed to parse remote candidate. " << sdpError.description);
+        return TrickleResult::Invalid;
       }
-      else {
-        std::cout << "Create answer complete." << std::endl;
 
-        std::string answerSdp;
-        localDescription->ToString(&answerSdp);
+      if (!pc->AddIceCandidate(candidate.get())) {
+        LOG_ERROR("Failed to add remote candidate " << line.substr(2) << ".");
+        return TrickleResult::Invalid;
+      }
+    }
+  }
+
+  return TrickleResult::Ok;
+}
+
+bool PcFactory::ClosePeerConnection(const std::string& peerConnectionId) {
+  PeerConnectionEntry entry;
+
+  {
+    std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+    for (auto it = _peerConnections.begin(); it != _peerConnections.end(); it++) {
+      if (it->id == peerConnectionId) {
+        entry = *it;
+        _peerConnections.erase(it);
+        break;
+      }
+    }
+  }
+
+  if (entry.pc == nullptr) {
+    return false;
+  }
+
+  /* Closed outside the lock, it blocks on the signaling thread. The entry's
+  * observer reference is held until then, the peer connection only has a raw
+  * pointer to it and Close fires its state change callbacks. */
+  entry.pc->Close();
+  return true;
+}
 
-        std::cout << answerSdp << std::endl;
+size_t PcFactory::ReapPeerConnections() {
+  std::vector<PeerConnectionEntry> inactive;
 
-        nlohmann::json answerJson;
-        answerJson["type"] = "answer";
-        answerJson["sdp"] = answerSdp;
+  {
+    std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
 
-        return answerJson.dump();
+    int64_t nowMs = rtc::TimeMillis();
+    for (auto it = _peerConnections.begin(); it != _peerConnections.end();) {
+      if (!IsActive(*it, nowMs)) {
+        inactive.push_back(*it);
+        it = _peerConnections.erase(it);
+      }
+      else {
+        it++;
       }
     }
   }
+
+  /* As in ClosePeerConnection the entries, and their observers, outlive Close. */
+  for (auto& entry : inactive) {
+    LOG_VERBOSE("Reaping peer connection " << entry.id << ".");
+    entry.pc->Close();
+  }
+
+  return inactive.size();
+}
+
+void PcFactory::SetNetworkIgnoreMask(int networkIgnoreMask) {
+  webrtc::PeerConnectionFactoryInterface::Options options;
+  options.network_ignore_mask = networkIgnoreMask;
+  _peerConnectionFactory->SetOptions(options);
+}
+
+bool PcFactory::SetLocalDescriptionAndWait(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc) {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool isReady = false;
+
+  auto createObs = new rtc::RefCountedObject<CreateSdpObserver>(mtx, cv, isReady);
+  pc->SetLocalDescription(createObs);
+
+  std::unique_lock<std::mutex> lck(mtx);
+  cv.wait(lck, [&isReady] { return isReady; });
+
+  return pc->local_description() != nullptr;
+}
+
+bool PcFactory::SetLocalDescriptionAndWait(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+  std::unique_ptr<webrtc::SessionDescriptionInterface> description) {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool isReady = false;
+
+  auto createObs = new rtc::RefCountedObject<CreateSdpObserver>(mtx, cv, isReady);
+  pc->SetLocalDescription(std::move(description), createObs);
+
+  std::unique_lock<std::mutex> lck(mtx);
+  cv.wait(lck, [&isReady] { return isReady; });
+
+  return pc->local_description() != nullptr;
+}
+
+bool PcFactory::SetRemoteDescriptionAndWait(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+  std::unique_ptr<webrtc::SessionDescriptionInterface> description) {
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool isReady = false;
+  bool isOk = false;
+
+  auto remoteObs = new rtc::RefCountedObject<SetRemoteSdpObserver>(mtx, cv, isReady, isOk);
+  pc->SetRemoteDescription(std::move(description), remoteObs);
+
+  std::unique_lock<std::mutex> lck(mtx);
+  cv.wait(lck, [&isReady] { return isReady; });
+
+  return isOk;
+}
+
+MidTracks PcFactory::GetMidTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc) {
+  MidTracks midTracks;
+
+  for (auto& transceiver : pc->GetTransceivers()) {
+    auto track = transceiver->sender()->track();
+    midTracks.push_back({ transceiver->mid().value_or(""), track ? track->id() : "" });
+  }
+
+  return midTracks;
+}
+
+void PcFactory::SetAnswerCacheEnabled(bool isEnabled) {
+  _answerCache.SetEnabled(isEnabled);
+}
+
+AnswerCacheStats PcFactory::GetAnswerCacheStats() {
+  return _answerCache.GetStats();
+}
+
+std::vector<PeerConnectionEntry> PcFactory::GetPeerConnections() {
+  std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+  return _peerConnections;
+}
+
+bool PcFactory::IsActive(const PeerConnectionEntry& entry, int64_t nowMs) {
+  switch (entry.pc->peer_connection_state()) {
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kClosed:
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kFailed:
+    return false;
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kNew:
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kConnecting:
+    /* A client that goes away after getting its answer leaves the peer
+    * connection in one of these for good, it never reaches failed. */
+    return nowMs - entry.createdAtMs < PC_CONNECT_TIMEOUT_MS;
+  default:
+    return true;
+  }
+}
+
+size_t PcFactory::GetActivePeerConnectionCount() {
+  std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+
+  int64_t nowMs = rtc::TimeMillis();
+  size_t activeCount = 0;
+  for (auto& entry : _peerConnections) {
+    if (IsActive(entry, nowMs)) {
+      activeCount++;
+    }
+  }
+
+  return activeCount;
+}
+
+std::unordered_set<std::string> PcFactory::GetActivePeerConnectionIds() {
+  std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+
+  int64_t nowMs = rtc::TimeMillis();
+  std::unordered_set<std::string> activeIds;
+  for (auto& entry : _peerConnections) {
+    if (IsActive(entry, nowMs)) {
+      activeIds.insert(entry.id);
+    }
+  }
+
+  return activeIds;
+}
+
+bool PcFactory::IsPeerConnectionActive(const std::string& peerConnectionId) {
+  std::lock_guard<std::mutex> lck(_peerConnectionsMtx);
+
+  for (auto& entry : _peerConnections) {
+    if (entry.id == peerConnectionId) {
+      return IsActive(entry, rtc::TimeMillis());
+    }
+  }
+
+  return false;
+}
+
+std::vector<std::pair<std::string, InstrumentedThread*>> PcFactory::GetThreads() {
+  return {
+    { "network", _networkThread.get() },
+    { "worker", _workerThread.get() },
+    { "signaling", _signalingThread.get() } };
 }
@@ -16,30 +16,145 @@
 #ifndef __PEER_CONNECTION_FACTORY__
 #define __PEER_CONNECTION_FACTORY__
 
+#include "AnswerCache.h"
+#include "CodecProfile.h"
+#include "CpuPlacement.h"
+#include "EventLogCapture.h"
+#include "InstrumentedThread.h"
 #include "PcObserver.h"
+#include "SetupTracer.h"
+#include "SyntheticAudioDevice.h"
 
 #include <api/peer_connection_interface.h>
 #include <api/scoped_refptr.h>
-#include <pc/test/fake_audio_capture_module.h>
 
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/rtc_certificate.h>
+#include <rtc_base/thread.h>
+
+#include <atomic>
 #include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+/* Shape of the synthetic media the factory's peers send. */
+struct SyntheticMediaConfig
+{
+  int audioSampleRate = 48000;
+  size_t audioChannels = 1;
+  int videoWidth = 640;
+  int videoHeight = 480;
+  int videoFps = 30;
+
+  /* Send a VP8 loop encoded at start up instead of encoding the track's frames. */
+  bool preEncodedVideo = false;
+};
+
+/* A peer connection that hasn't connected after this long is taken to be abandoned. */
+#define PC_CONNECT_TIMEOUT_MS (30 * 1000)
+
+struct PeerConnectionEntry
+{
+  std::string id;
+  rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc;
+  rtc::scoped_refptr<rtc::RefCountedObject<PcObserver>> observer;
+  int64_t createdAtMs = 0;
+};
+
+enum class TrickleResult
+{
+  Ok,
+  NotFound,
+  Invalid,
+
+  /* The fragment carries new ICE credentials, an ICE restart isn't supported. */
+  IceRestart
+};
+
 class PcFactory {
 public:
-  PcFactory();
+  PcFactory(const SyntheticMediaConfig& mediaConfig = SyntheticMediaConfig(),
+    const CodecProfile& codecProfile = CodecProfile(),
+    const EventLogConfig& eventLogConfig = EventLogConfig(),
+    const CpuPlacementPlan& placement = CpuPlacementPlan());
   ~PcFactory();
-  std::string CreatePeerConnection(const char* buffer, int length);
+
+  /* Answers a remote offer with an echo peer connection. Returns false if the
+  * offer couldn't be applied or the answer couldn't be created. The id of the
+  * new peer connection is set if requested, it's what the WHIP resource is
+  * named after. */
+  bool CreatePeerConnection(const std::string& offerSdp, std::string& answerSdp,
+    std::string* peerConnectionId = nullptr);
+
+  /* Applies a trickle ICE SDP fragment (RFC 8840) to a peer connection. */
+  TrickleResult AddRemoteCandidates(const std::string& peerConnectionId, const std::string& sdpFragment);
+
+  /* Closes a peer connection and forgets it. Returns false if the id is unknown. */
+  bool ClosePeerConnection(const std::string& peerConnectionId);
+
+  /* Closes and forgets the peer connections that are no longer active, see
+  * GetActivePeerConnectionCount. Called periodically by the StatsCollector so
+  * sessions that end without a WHIP DELETE don't stay in memory. Returns the
+  * number removed. */
+  size_t ReapPeerConnections();
+
+  /* Client side of a connection, used by the load generator. Creates a peer
+  * connection with an audio track, plus a video track if a source is supplied,
+  * and returns its SDP offer. The entry's pc is null on failure. */
+  PeerConnectionEntry CreateOfferPeerConnection(
+    rtc::scoped_refptr<webrtc::VideoTrackSourceInterface> videoSource, std::string& offerSdp);
+  bool SetRemoteAnswer(const PeerConnectionEntry& entry, const std::string& answerSdp);
+
+  /* Adapter types (rtc::AdapterType bits) to exclude from ICE gathering. */
+  void SetNetworkIgnoreMask(int networkIgnoreMask);
+
+  /* Snapshot of the peer connections created so far, safe to call from any thread. */
+  std::vector<PeerConnectionEntry> GetPeerConnections();
+
+  /* Peer connections that haven't closed or failed, used to decide when a drain is
+  * done. One still connecting after PC_CONNECT_TIMEOUT_MS isn't counted, its
+  * client has gone. */
+  size_t GetActivePeerConnectionCount();
+
+  /* The ids of the same peer connections, and whether one of them is active. */
+  std::unordered_set<std::string> GetActivePeerConnectionIds();
+  bool IsPeerConnectionActive(const std::string& peerConnectionId);
+
+  /* The network, worker and signaling threads keyed by name. */
+  std::vector<std::pair<std::string, InstrumentedThread*>> GetThreads();
+
+  /* Answer offers seen before from a template instead of a full CreateAnswer. The
+  * server turns it on unless started with --no-answer-cache. */
+  void SetAnswerCacheEnabled(bool isEnabled);
+  AnswerCacheStats GetAnswerCacheStats();
+
+  /* Setup stage spans for the answering peer connections, traced by peer connection id. */
+  SetupTracer& GetSetupTracer() { return _setupTracer; }
 
 private:
   rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> _peerConnectionFactory;
-  std::vector<rtc::scoped_refptr<webrtc::PeerConnectionInterface>> _peerConnections;
-  std::unique_ptr<rtc::Thread> _networkThread;
-  std::unique_ptr<rtc::Thread> _workerThread;
-  std::unique_ptr<rtc::Thread> _signalingThread;
-  rtc::scoped_refptr<FakeAudioCaptureModule> _fakeAudioCapture;
+  std::mutex _peerConnectionsMtx;
+  std::vector<PeerConnectionEntry> _peerConnections;
+  std::atomic<uint64_t> _nextPeerConnectionId{ 0 };
+  std::unique_ptr<InstrumentedThread> _networkThread;
+  std::unique_ptr<InstrumentedThread> _workerThread;
+  std::unique_ptr<InstrumentedThread> _signalingThread;
+  rtc::scoped_refptr<SyntheticAudioDevice> _audioDevice;
+  rtc::scoped_refptr<rtc::RTCCertificate> _certificate;
+  AnswerCache _answerCache;
+  SetupTracer _setupTracer;
+
+  bool SetLocalDescriptionAndWait(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc);
+  bool SetLocalDescriptionAndWait(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    std::unique_ptr<webrtc::SessionDescriptionInterface> description);
+  bool SetRemoteDescriptionAndWait(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc,
+    std::unique_ptr<webrtc::SessionDescriptionInterface> description);
+  MidTracks GetMidTracks(rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc);
+  static bool IsActive(const PeerConnectionEntry& entry, int64_t nowMs);
 };
 
 #endif
\ No newline at end of file
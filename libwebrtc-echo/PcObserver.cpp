@@ -13,43 +13,177 @@
 /******************************************************************************/
 
 #include "PcObserver.h"
+#include "Logger.h"
 
-#include <iostream>
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+#include <iomanip>
+
+DEFINE_OBJECT_POOL(PcObserver)
+DEFINE_OBJECT_POOL(SetRemoteSdpObserver)
+DEFINE_OBJECT_POOL(CreateSdpObserver)
+
+PcObserver::PcObserver(bool isEcho) :
+  _isEcho(isEcho)
+{ }
 
 void PcObserver::OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state)
 {
-  std::cout << "OnSignalingChange " << new_state << "." << std::endl;
+  LOG_VERBOSE("OnSignalingChange " << new_state << ".");
 }
 
 void PcObserver::OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel)
 {
-  std::cout << "OnDataChannel " << data_channel->id() << "." << std::endl;
+  LOG_VERBOSE("OnDataChannel " << data_channel->id() << ".");
+
+  std::lock_guard<std::mutex> lck(_dataChannelsMtx);
+  _dataChannels.push_back(std::make_unique<DataChannelEcho>(data_channel));
 }
 
 void PcObserver::OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state)
 {
-  std::cout << "OnIceGatheringChange " << new_state << "." << std::endl;
+  LOG_VERBOSE("OnIceGatheringChange " << new_state << ".");
+}
+
+void PcObserver::OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state)
+{
+  LOG_VERBOSE("OnIceConnectionChange " << new_state << ".");
+
+  if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected ||
+    new_state == webrtc::PeerConnectionInterface::kIceConnectionCompleted) {
+
+    /* Only the first connect after the answer is part of setup. */
+    int64_t iceStartUs = _iceStartUs.exchange(0);
+    if (_setupTracer != nullptr && iceStartUs != 0) {
+      int64_t nowUs = SetupTracer::NowUs();
+      _setupTracer->Record(_traceId, SetupStage::IceConnected, iceStartUs, nowUs);
+      _iceConnectedUs = nowUs;
+    }
+  }
 }
 
 void PcObserver::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
 {
-  std::cout << "OnIceCandidate " << candidate->candidate().ToString() << "." << std::endl;
+  LOG_VERBOSE("OnIceCandidate " << candidate->candidate().ToString() << ".");
 }
 
 void PcObserver::OnAddTrack(
   rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
   const std::vector<rtc::scoped_refptr<webrtc::MediaStreamInterface>>& streams)
 {
-  std::cout << "OnAddTrack." << std::endl;
+  LOG_VERBOSE("OnAddTrack.");
 }
 
 void PcObserver::OnTrack(rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver)
 {
-  std::cout << "OnTrack." << std::endl;
+  auto track = transceiver->receiver()->track();
+
+  LOG_VERBOSE("OnTrack " << track->kind() << " " << track->id() << ".");
+
+  if (!_isEcho) {
+    return;
+  }
+
+  /* Loop the remote track back out on the same transceiver. This fires while the
+  * remote offer is being applied so the answer gets negotiated as sendrecv. */
+  rtc::scoped_refptr<EchoFrameTransformer> echoTransformer(new rtc::RefCountedObject<EchoFrameTransformer>());
+
+  {
+    std::lock_guard<std::mutex> lck(_echoTransformersMtx);
+    _echoTransformers.push_back(echoTransformer);
+  }
+
+  transceiver->SetDirection(webrtc::RtpTransceiverDirection::kSendRecv);
+  transceiver->sender()->SetEncoderToPacketizerFrameTransformer(echoTransformer);
+
+  if (!transceiver->sender()->SetTrack(track)) {
+    LOG_ERROR("Failed to set echo track on " << track->kind() << " sender.");
+  }
 }
 
 void PcObserver::OnConnectionChange(
   webrtc::PeerConnectionInterface::PeerConnectionState new_state)
 {
-  std::cout << "OnConnectionChange to " << (int)new_state << "." << std::endl;
+  LOG_VERBOSE("OnConnectionChange to " << (int)new_state << ".");
+
+  if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kConnected) {
+    _connectedAtMs = rtc::TimeMillis();
+
+    int64_t iceConnectedUs = _iceConnectedUs.exchange(0);
+    if (_setupTracer != nullptr && iceConnectedUs != 0) {
+      _setupTracer->Record(_traceId, SetupStage::DtlsConnected, iceConnectedUs, SetupTracer::NowUs());
+    }
+  }
+  else if (new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kDisconnected ||
+    new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kFailed ||
+    new_state == webrtc::PeerConnectionInterface::PeerConnectionState::kClosed) {
+    LOG_INFO("Echoed " << GetForwardedBytes() << " bytes, average forwarded bitrate "
+      << std::fixed << std::setprecision(1) << GetForwardedBitrateKbps() << " kbps.");
+  }
+}
+
+void PcObserver::SetSetupTrace(SetupTracer* setupTracer, uint64_t traceId)
+{
+  _setupTracer = setupTracer;
+  _traceId = traceId;
+}
+
+void PcObserver::TraceLocalDescriptionSet()
+{
+  if (_setupTracer != nullptr) {
+    _iceStartUs = SetupTracer::NowUs();
+  }
+}
+
+uint64_t PcObserver::GetForwardedBytes() const
+{
+  uint64_t forwardedBytes = 0;
+
+  std::lock_guard<std::mutex> lck(_echoTransformersMtx);
+
+  for (auto& echoTransformer : _echoTransformers) {
+    forwardedBytes += echoTransformer->GetForwardedBytes();
+  }
+
+  return forwardedBytes;
+}
+
+double PcObserver::GetForwardedBitrateKbps() const
+{
+  int64_t connectedAtMs = _connectedAtMs.load();
+  int64_t elapsedMs = rtc::TimeMillis() - connectedAtMs;
+
+  if (connectedAtMs == 0 || elapsedMs <= 0) {
+    return 0.0;
+  }
+
+  return GetForwardedBytes() * 8.0 / elapsedMs;
+}
+
+DataChannelEchoStats PcObserver::GetDataChannelStats() const
+{
+  DataChannelEchoStats total{};
+  double turnaroundTotalUs = 0;
+
+  std::lock_guard<std::mutex> lck(_dataChannelsMtx);
+
+  for (auto& dc : _dataChannels) {
+    auto stats = dc->GetStats();
+    total.messages += stats.messages;
+    total.bytes += stats.bytes;
+    total.dropped += stats.dropped;
+    total.messagesPerSecond += stats.messagesPerSecond;
+    total.bytesPerSecond += stats.bytesPerSecond;
+    total.turnaroundSamples += stats.turnaroundSamples;
+    turnaroundTotalUs += stats.turnaroundAvgUs * stats.turnaroundSamples;
+    total.turnaroundMaxUs = std::max(total.turnaroundMaxUs, stats.turnaroundMaxUs);
+  }
+
+  if (total.turnaroundSamples > 0) {
+    total.turnaroundAvgUs = turnaroundTotalUs / total.turnaroundSamples;
+  }
+
+  return total;
 }
\ No newline at end of file
@@ -16,21 +16,34 @@
 #ifndef __PEER_CONNECTION_OBSERVER__
 #define __PEER_CONNECTION_OBSERVER__
 
+#include "DataChannelEcho.h"
+#include "EchoFrameTransformer.h"
+#include "Logger.h"
+#include "ObjectPool.h"
+#include "SetupTracer.h"
+
 #include <api/peer_connection_interface.h>
+#include <api/scoped_refptr.h>
 
+#include <atomic>
 #include <condition_variable>
-#include <iomanip>
-#include <iostream>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 class PcObserver :
-  public webrtc::PeerConnectionObserver
+  public webrtc::PeerConnectionObserver,
+  public PooledObject<PcObserver>
 { 
 public:
+  /* Setting isEcho to false leaves received tracks alone, used for client peers. */
+  PcObserver(bool isEcho = true);
+
   void OnSignalingChange(webrtc::PeerConnectionInterface::SignalingState new_state);
   void OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel);
   void OnIceGatheringChange(webrtc::PeerConnectionInterface::IceGatheringState new_state);
+  void OnIceConnectionChange(webrtc::PeerConnectionInterface::IceConnectionState new_state);
   void OnIceCandidate(const webrtc::IceCandidateInterface* candidate);
   void OnAddTrack(
     rtc::scoped_refptr<webrtc::RtpReceiverInterface> receiver,
@@ -39,20 +52,94 @@ public:
     rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver);
   void OnConnectionChange(
     webrtc::PeerConnectionInterface::PeerConnectionState new_state);
+
+  /* Average bitrate of the media echoed back to the remote peer since connecting. */
+  uint64_t GetForwardedBytes() const;
+  double GetForwardedBitrateKbps() const;
+
+  /* Totals across all the data channels the remote peer has opened. */
+  DataChannelEchoStats GetDataChannelStats() const;
+
+  /* Zero until the connection reaches the connected state. */
+  int64_t GetConnectedAtMs() const { return _connectedAtMs.load(); }
+
+  /* Records the ICE and DTLS connect stages against the trace. Must be set
+  * before the remote description is applied. */
+  void SetSetupTrace(SetupTracer* setupTracer, uint64_t traceId);
+
+  /* The ICE connect stage is timed from here. */
+  void TraceLocalDescriptionSet();
+
+private:
+  bool _isEcho;
+
+  /* One per echoing transceiver, an audio sender takes over its transformer's
+  * single callback slot so they can't be shared. */
+  mutable std::mutex _echoTransformersMtx;
+  std::vector<rtc::scoped_refptr<EchoFrameTransformer>> _echoTransformers;
+  std::atomic<int64_t> _connectedAtMs{ 0 };
+  SetupTracer* _setupTracer = nullptr;
+  uint64_t _traceId = 0;
+  std::atomic<int64_t> _iceStartUs{ 0 };
+  std::atomic<int64_t> _iceConnectedUs{ 0 };
+  mutable std::mutex _dataChannelsMtx;
+  std::vector<std::unique_ptr<DataChannelEcho>> _dataChannels;
 };
 
-class SetRemoteSdpObserver :
-  public webrtc::SetRemoteDescriptionObserverInterface
+DECLARE_OBJECT_POOL(PcObserver)
 
+class SetRemoteSdpObserver :
+  public webrtc::SetRemoteDescriptionObserverInterface,
+  public PooledObject<SetRemoteSdpObserver>
 {
+public:
+  SetRemoteSdpObserver()
+    : _mtx(nullptr), _cv(nullptr), _isReady(nullptr), _isOk(nullptr) {
+  }
+
+  /* Signals the caller once the remote description has been applied. */
+  SetRemoteSdpObserver(std::mutex& mtx, std::condition_variable& cv, bool& isReady, bool& isOk)
+    : _mtx(&mtx), _cv(&cv), _isReady(&isReady), _isOk(&isOk) {
+  }
+
+  /* Times the remote description from now until it's been applied. */
+  void SetSetupTrace(SetupTracer* setupTracer, uint64_t traceId) {
+    _setupTracer = setupTracer;
+    _traceId = traceId;
+    _startUs = SetupTracer::NowUs();
+  }
+
   void OnSetRemoteDescriptionComplete(webrtc::RTCError error)
   {
-    std::cout << "OnSetRemoteDescriptionComplete ok ? " << std::boolalpha << error.ok() << "." << std::endl;
+    LOG_VERBOSE("OnSetRemoteDescriptionComplete ok ? " << std::boolalpha << error.ok() << ".");
+
+    if (_setupTracer != nullptr) {
+      _setupTracer->Record(_traceId, SetupStage::SetRemoteDescription, _startUs, SetupTracer::NowUs());
+    }
+
+    if (_mtx != nullptr) {
+      std::unique_lock<std::mutex> lck(*_mtx);
+      *_isOk = error.ok();
+      *_isReady = true;
+      _cv->notify_all();
+    }
   }
+
+private:
+  std::mutex* _mtx;
+  std::condition_variable* _cv;
+  bool* _isReady;
+  bool* _isOk;
+  SetupTracer* _setupTracer = nullptr;
+  uint64_t _traceId = 0;
+  int64_t _startUs = 0;
 };
 
+DECLARE_OBJECT_POOL(SetRemoteSdpObserver)
+
 class CreateSdpObserver :
-  public webrtc::SetLocalDescriptionObserverInterface
+  public webrtc::SetLocalDescriptionObserverInterface,
+  public PooledObject<CreateSdpObserver>
 {
 public:
   
@@ -60,15 +147,11 @@ public:
     : _mtx(mtx), _cv(cv), _isReady(isReady) {
   }
 
-  ~CreateSdpObserver() {
-    std::cout << "CreateSdpObserver Destructor." << std::endl;
-  }
-
   void OnSetLocalDescriptionComplete(webrtc::RTCError error) {
-    std::cout << "OnSetLocalDescriptionComplete." << std::endl;
+    LOG_VERBOSE("OnSetLocalDescriptionComplete.");
 
     if (!error.ok()) {
-      std::cerr << "OnSetLocalDescription error. " << error.message() << std::endl;
+      LOG_ERROR("OnSetLocalDescription error. " << error.message());
     }
 
     std::unique_lock<std::mutex> lck(_mtx);
@@ -82,4 +165,6 @@ private:
   bool& _isReady;
 };
 
+DECLARE_OBJECT_POOL(CreateSdpObserver)
+
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+/******************************************************************************
+* Filename: PreEncodedVideoEncoderFactory.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "PreEncodedVideoEncoderFactory.h"
+#include "Logger.h"
+#include "SyntheticVideoSource.h"
+
+#include <api/video/video_bitrate_allocation.h>
+#include <api/video/video_frame.h>
+#include <media/base/media_constants.h>
+#include <modules/video_coding/codecs/vp8/include/vp8.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include <stdexcept>
+
+/* Collects the output of the one-off encode run. */
+class PreEncodeCallback :
+  public webrtc::EncodedImageCallback
+{
+public:
+  std::vector<PreEncodedFrame> Frames;
+
+  Result OnEncodedImage(const webrtc::EncodedImage& image, const webrtc::CodecSpecificInfo* codecInfo) override
+  {
+    /* The encoder reuses its output buffer so the frame has to be copied out. */
+    PreEncodedFrame frame{ image, *codecInfo };
+    frame.image.SetEncodedData(webrtc::EncodedImageBuffer::Create(image.data(), image.size()));
+    Frames.push_back(std::move(frame));
+    return Result(Result::OK);
+  }
+};
+
+/* Replays the shared pre-encoded loop, one frame out for every frame in. */
+class LoopedVideoEncoder :
+  public webrtc::VideoEncoder
+{
+public:
+  LoopedVideoEncoder(std::shared_ptr<const std::vector<PreEncodedFrame>> frames) :
+    _frames(frames),
+    _callback(nullptr),
+    _frameIndex(0)
+  { }
+
+  int InitEncode(const webrtc::VideoCodec* codecSettings, const webrtc::VideoEncoder::Settings& settings) override
+  {
+    _frameIndex = 0;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t RegisterEncodeCompleteCallback(webrtc::EncodedImageCallback* callback) override
+  {
+    _callback = callback;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Release() override
+  {
+    _callback = nullptr;
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  int32_t Encode(const webrtc::VideoFrame& frame, const std::vector<webrtc::VideoFrameType>* frameTypes) override
+  {
+    if (_callback == nullptr) {
+      return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+    }
+
+    if (frameTypes != nullptr) {
+      for (auto frameType : *frameTypes) {
+        if (frameType == webrtc::VideoFrameType::kVideoFrameKey) {
+          _frameIndex = 0;
+        }
+      }
+    }
+
+    const PreEncodedFrame& preEncoded = (*_frames)[_frameIndex];
+    _frameIndex = (_frameIndex + 1) % _frames->size();
+
+    /* Copying the image only copies the reference to its encoded data. */
+    webrtc::EncodedImage image = preEncoded.image;
+    image.SetTimestamp(frame.timestamp());
+    image.ntp_time_ms_ = frame.ntp_time_ms();
+    image.capture_time_ms_ = frame.render_time_ms();
+    image.rotation_ = frame.rotation();
+
+    webrtc::CodecSpecificInfo codecInfo = preEncoded.codecInfo;
+    _callback->OnEncodedImage(image, &codecInfo);
+
+    return WEBRTC_VIDEO_CODEC_OK;
+  }
+
+  void SetRates(const webrtc::VideoEncoder::RateControlParameters& parameters) override
+  {
+    /* The loop's bitrate is fixed, not adapting is the point. */
+  }
+
+  webrtc::VideoEncoder::EncoderInfo GetEncoderInfo() const override
+  {
+    webrtc::VideoEncoder::EncoderInfo info;
+    info.implementation_name = "PreEncodedLoop";
+    info.scaling_settings = webrtc::VideoEncoder::ScalingSettings::kOff;
+    return info;
+  }
+
+private:
+  std::shared_ptr<const std::vector<PreEncodedFrame>> _frames;
+  webrtc::EncodedImageCallback* _callback;
+  size_t _frameIndex;
+};
+
+PreEncodedVideoEncoderFactory::PreEncodedVideoEncoderFactory(int width, int height, int fps)
+{
+  webrtc::VideoCodec codec;
+  codec.codecType = webrtc::kVideoCodecVP8;
+  codec.width = width;
+  codec.height = height;
+  codec.maxFramerate = fps;
+  codec.startBitrate = PRE_ENCODED_BITRATE_KBPS;
+  codec.maxBitrate = PRE_ENCODED_BITRATE_KBPS;
+  codec.minBitrate = PRE_ENCODED_BITRATE_KBPS / 10;
+  codec.qpMax = 56;
+  codec.numberOfSimulcastStreams = 1;
+  codec.simulcastStream[0].width = width;
+  codec.simulcastStream[0].height = height;
+  codec.simulcastStream[0].maxFramerate = fps;
+  codec.simulcastStream[0].numberOfTemporalLayers = 1;
+  codec.simulcastStream[0].maxBitrate = PRE_ENCODED_BITRATE_KBPS;
+  codec.simulcastStream[0].targetBitrate = PRE_ENCODED_BITRATE_KBPS;
+  codec.simulcastStream[0].minBitrate = PRE_ENCODED_BITRATE_KBPS / 10;
+  codec.simulcastStream[0].qpMax = 56;
+  codec.simulcastStream[0].active = true;
+  *codec.VP8() = webrtc::VideoEncoder::GetDefaultVp8Settings();
+  codec.VP8()->numberOfTemporalLayers = 1;
+  codec.VP8()->automaticResizeOn = false;
+  codec.VP8()->frameDroppingOn = false;
+
+  auto encoder = webrtc::VP8Encoder::Create();
+  PreEncodeCallback callback;
+
+  webrtc::VideoEncoder::Capabilities capabilities(false);
+  if (encoder->InitEncode(&codec, webrtc::VideoEncoder::Settings(capabilities, 1, 1200)) != WEBRTC_VIDEO_CODEC_OK) {
+    throw std::runtime_error("PreEncodedVideoEncoderFactory failed to initialise the VP8 encoder.");
+  }
+
+  encoder->RegisterEncodeCompleteCallback(&callback);
+
+  webrtc::VideoBitrateAllocation allocation;
+  allocation.SetBitrate(0, 0, PRE_ENCODED_BITRATE_KBPS * 1000);
+  encoder->SetRates(webrtc::VideoEncoder::RateControlParameters(allocation, fps));
+
+  int loopFrames = PRE_ENCODED_LOOP_SECONDS * fps;
+  for (int i = 0; i < loopFrames; i++) {
+    auto frame = webrtc::VideoFrame::Builder()
+      .set_video_frame_buffer(SyntheticVideoSource::RenderFrame(width, height, i % SYNTHETIC_VIDEO_LOOP_FRAMES))
+      .set_timestamp_rtp(static_cast<uint32_t>(i * (cricket::kVideoCodecClockrate / fps)))
+      .build();
+
+    std::vector<webrtc::VideoFrameType> frameTypes{ i == 0 ?
+      webrtc::VideoFrameType::kVideoFrameKey : webrtc::VideoFrameType::kVideoFrameDelta };
+    encoder->Encode(frame, &frameTypes);
+  }
+
+  encoder->Release();
+
+  if (callback.Frames.empty() || callback.Frames[0].image._frameType != webrtc::VideoFrameType::kVideoFrameKey) {
+    throw std::runtime_error("PreEncodedVideoEncoderFactory failed to encode the video loop.");
+  }
+
+  size_t loopBytes = 0;
+  for (auto& frame : callback.Frames) {
+    loopBytes += frame.image.size();
+  }
+
+  LOG_INFO("Pre-encoded " << callback.Frames.size() << " VP8 frames at " << width << "x" << height
+    << ", " << loopBytes << " bytes.");
+
+  _frames = std::make_shared<const std::vector<PreEncodedFrame>>(std::move(callback.Frames));
+}
+
+std::vector<webrtc::SdpVideoFormat> PreEncodedVideoEncoderFactory::GetSupportedFormats() const
+{
+  return { webrtc::SdpVideoFormat(cricket::kVp8CodecName) };
+}
+
+std::unique_ptr<webrtc::VideoEncoder> PreEncodedVideoEncoderFactory::CreateVideoEncoder(
+  const webrtc::SdpVideoFormat& format)
+{
+  return std::make_unique<LoopedVideoEncoder>(_frames);
+}
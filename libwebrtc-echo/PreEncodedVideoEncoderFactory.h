@@ -0,0 +1,56 @@
+/******************************************************************************
+* Filename: PreEncodedVideoEncoderFactory.h
+*
+* Description:
+* Video encoder factory for measuring transport capacity without paying for
+* video encoding. A loop of synthetic frames is VP8 encoded once at start up
+* and every encoder the factory creates replays that loop, one encoded frame
+* per input frame, ignoring the input content and any rate updates. The
+* encoded buffers are shared between all encoders so there are no per frame
+* copies either. The loop starts on a key frame and key frame requests jump
+* back to it.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __PRE_ENCODED_VIDEO_ENCODER_FACTORY__
+#define __PRE_ENCODED_VIDEO_ENCODER_FACTORY__
+
+#include <api/video/encoded_image.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+
+#include <memory>
+#include <vector>
+
+/* Length of the loop in seconds, the loop's only key frame is at its start. */
+#define PRE_ENCODED_LOOP_SECONDS 2
+#define PRE_ENCODED_BITRATE_KBPS 1000
+
+struct PreEncodedFrame
+{
+  webrtc::EncodedImage image;
+  webrtc::CodecSpecificInfo codecInfo;
+};
+
+class PreEncodedVideoEncoderFactory :
+  public webrtc::VideoEncoderFactory
+{
+public:
+  PreEncodedVideoEncoderFactory(int width, int height, int fps);
+
+  std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+  std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(const webrtc::SdpVideoFormat& format) override;
+
+private:
+  std::shared_ptr<const std::vector<PreEncodedFrame>> _frames;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/******************************************************************************
+* Filename: SetupTracer.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "SetupTracer.h"
+#include "json.hpp"
+
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+
+SetupTracer::SetupTracer(size_t capacity) :
+  _capacity(std::max<size_t>(capacity, 1)),
+  _slots(new Slot[_capacity])
+{
+  for (size_t i = 0; i < static_cast<size_t>(SetupStage::Count); i++) {
+    _histograms.push_back(std::make_unique<LatencyHistogram>(GetBucketBoundsUs()));
+  }
+}
+
+int64_t SetupTracer::NowUs()
+{
+  return rtc::TimeMicros();
+}
+
+const char* SetupTracer::GetStageName(SetupStage stage)
+{
+  switch (stage) {
+  case SetupStage::HttpRequest: return "HttpRequest";
+  case SetupStage::ParseOffer: return "ParseOffer";
+  case SetupStage::CreatePeerConnection: return "CreatePeerConnection";
+  case SetupStage::SetRemoteDescription: return "SetRemoteDescription";
+  case SetupStage::SetLocalDescription: return "SetLocalDescription";
+  case SetupStage::IceConnected: return "IceConnected";
+  case SetupStage::DtlsConnected: return "DtlsConnected";
+  default: return "Unknown";
+  }
+}
+
+const std::vector<int64_t>& SetupTracer::GetBucketBoundsUs()
+{
+  static const std::vector<int64_t> bounds(SETUP_TRACE_BUCKET_BOUNDS_US);
+  return bounds;
+}
+
+void SetupTracer::Record(uint64_t traceId, SetupStage stage, int64_t startUs, int64_t endUs)
+{
+  int64_t durationUs = std::max<int64_t>(endUs - startUs, 0);
+  uint64_t index = _writeIndex.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = _slots[index % _capacity];
+
+  slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.traceId.store(traceId, std::memory_order_relaxed);
+  slot.stage.store(static_cast<int>(stage), std::memory_order_relaxed);
+  slot.startUs.store(startUs, std::memory_order_relaxed);
+  slot.durationUs.store(durationUs, std::memory_order_relaxed);
+  slot.sequence.store(2 * index + 2, std::memory_order_release);
+
+  _histograms[static_cast<size_t>(stage)]->Add(durationUs);
+}
+
+std::vector<SetupSpan> SetupTracer::GetSpans() const
+{
+  std::vector<SetupSpan> spans;
+  uint64_t end = _writeIndex.load(std::memory_order_acquire);
+  uint64_t start = end > _capacity ? end - _capacity : 0;
+
+  spans.reserve(end - start);
+
+  for (uint64_t index = start; index < end; index++) {
+    const Slot& slot = _slots[index % _capacity];
+
+    /* Skip slots still being written or already overwritten by a newer span. */
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * index + 2) {
+      continue;
+    }
+
+    SetupSpan span;
+    span.traceId = slot.traceId.load(std::memory_order_relaxed);
+    span.stage = static_cast<SetupStage>(slot.stage.load(std::memory_order_relaxed));
+    span.startUs = slot.startUs.load(std::memory_order_relaxed);
+    span.durationUs = slot.durationUs.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      spans.push_back(span);
+    }
+  }
+
+  return spans;
+}
+
+std::string SetupTracer::GetChromeTraceJson() const
+{
+  nlohmann::json traceEvents = nlohmann::json::array();
+
+  for (auto& span : GetSpans()) {
+    traceEvents.push_back({
+      { "name", GetStageName(span.stage) },
+      { "cat", "setup" },
+      { "ph", "X" },
+      { "ts", span.startUs },
+      { "dur", span.durationUs },
+      { "pid", 1 },
+      { "tid", span.traceId } });
+  }
+
+  nlohmann::json traceJson;
+  traceJson["traceEvents"] = std::move(traceEvents);
+  traceJson["displayTimeUnit"] = "ms";
+
+  return traceJson.dump();
+}
+
+std::vector<SetupStageStats> SetupTracer::GetStageStats() const
+{
+  std::vector<SetupStageStats> stageStats;
+
+  for (size_t i = 0; i < _histograms.size(); i++) {
+    stageStats.push_back({ static_cast<SetupStage>(i), _histograms[i]->GetSnapshot() });
+  }
+
+  return stageStats;
+}
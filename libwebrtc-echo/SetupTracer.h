@@ -0,0 +1,113 @@
+/******************************************************************************
+* Filename: SetupTracer.h
+*
+* Description:
+* Span tracing for peer connection setup. Each stage a new connection goes
+* through, from the HTTP request arriving to DTLS connecting, is recorded as a
+* span with monotonic start and end timestamps against the connection's trace
+* id, which is its peer connection id.
+*
+* Spans go into a fixed size ring buffer that never blocks or allocates on the
+* recording threads, the oldest spans are overwritten once it's full. Each
+* slot is guarded by a sequence number so a reader skips any slot that's
+* being written. The buffer can be exported in the Chrome trace event format,
+* loadable in chrome://tracing or Perfetto, with a row per connection. Every
+* span is also counted in a per stage latency histogram that covers all
+* connections, not just the ones still in the buffer.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __SETUP_TRACER__
+#define __SETUP_TRACER__
+
+#include "LatencyHistogram.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define SETUP_TRACE_DEFAULT_CAPACITY 16384
+
+/* Upper bounds of the histogram buckets, there's an overflow bucket after the last. */
+#define SETUP_TRACE_BUCKET_BOUNDS_US { 1000, 2000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, \
+  1000000, 2500000, 5000000, 10000000 }
+
+enum class SetupStage
+{
+  /* The whole signaling request, from arrival to the answer being sent. */
+  HttpRequest,
+  ParseOffer,
+  CreatePeerConnection,
+  SetRemoteDescription,
+  SetLocalDescription,
+
+  /* From the local description being set to ICE connecting. */
+  IceConnected,
+
+  /* From ICE connecting to the DTLS handshake completing. */
+  DtlsConnected,
+
+  Count
+};
+
+struct SetupSpan
+{
+  uint64_t traceId;
+  SetupStage stage;
+  int64_t startUs;
+  int64_t durationUs;
+};
+
+struct SetupStageStats
+{
+  SetupStage stage;
+  LatencyHistogramSnapshot latency;
+};
+
+class SetupTracer
+{
+public:
+  SetupTracer(size_t capacity = SETUP_TRACE_DEFAULT_CAPACITY);
+
+  /* Monotonic clock all spans are timed against. */
+  static int64_t NowUs();
+
+  static const char* GetStageName(SetupStage stage);
+  static const std::vector<int64_t>& GetBucketBoundsUs();
+
+  /* Safe to call from any thread. */
+  void Record(uint64_t traceId, SetupStage stage, int64_t startUs, int64_t endUs);
+
+  /* The spans currently in the ring buffer, oldest first. */
+  std::vector<SetupSpan> GetSpans() const;
+
+  std::string GetChromeTraceJson() const;
+  std::vector<SetupStageStats> GetStageStats() const;
+
+private:
+  struct Slot
+  {
+    /* Odd while the slot is being written, 2 * (index + 1) once written. */
+    std::atomic<uint64_t> sequence{ 0 };
+    std::atomic<uint64_t> traceId{ 0 };
+    std::atomic<int> stage{ 0 };
+    std::atomic<int64_t> startUs{ 0 };
+    std::atomic<int64_t> durationUs{ 0 };
+  };
+
+  size_t _capacity;
+  std::unique_ptr<Slot[]> _slots;
+  std::atomic<uint64_t> _writeIndex{ 0 };
+  std::vector<std::unique_ptr<LatencyHistogram>> _histograms;
+};
+
+#endif
@@ -0,0 +1,379 @@
+/******************************************************************************
+* Filename: SignalingJson.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "SignalingJson.h"
+
+#include <string.h>
+#include <vector>
+
+/* Used in place of unpaired UTF-16 surrogates. */
+#define UNICODE_REPLACEMENT_CHARACTER 0xFFFD
+
+static bool IsJsonWhitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int HexValue(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+JsonStringFieldExtractor::JsonStringFieldExtractor(const char* key, std::string& value) :
+  _key(key),
+  _keyLength(strlen(key)),
+  _value(value),
+  _state(State::Start),
+  _depth(0),
+  _expectKey(false),
+  _keyBufferLength(0),
+  _keyOverflow(false),
+  _unicode(0),
+  _unicodeDigits(0),
+  _highSurrogate(0)
+{ }
+
+bool JsonStringFieldExtractor::Feed(const char* data, size_t length)
+{
+  const char* end = data + length;
+
+  while (data < end && _state != State::Done && _state != State::Error) {
+
+    /* Fast path for string bodies, which is where nearly all the bytes are. */
+    if (_state == State::Capture || _state == State::SkipString) {
+      const char* run = data;
+      while (run < end && *run != '"' && *run != '\\' && static_cast<unsigned char>(*run) >= 0x20) {
+        run++;
+      }
+
+      if (run > data && _state == State::Capture) {
+        if (_highSurrogate != 0) {
+          AppendCodePoint(UNICODE_REPLACEMENT_CHARACTER);
+          _highSurrogate = 0;
+        }
+        _value.append(data, run - data);
+      }
+
+      data = run;
+      if (data == end) {
+        break;
+      }
+    }
+
+    Step(*data++);
+  }
+
+  return _state != State::Done && _state != State::Error;
+}
+
+void JsonStringFieldExtractor::Step(char c)
+{
+  switch (_state) {
+  case State::Start:
+    if (c == '{') {
+      _depth = 1;
+      _expectKey = true;
+      _state = State::Scan;
+    }
+    else if (!IsJsonWhitespace(c)) {
+      _state = State::Error;
+    }
+    break;
+
+  case State::Scan:
+    if (c == '"') {
+      if (_depth == 1 && _expectKey) {
+        _keyBufferLength = 0;
+        _keyOverflow = false;
+        _state = State::Key;
+      }
+      else {
+        _state = State::SkipString;
+      }
+    }
+    else if (c == '{' || c == '[') {
+      _depth++;
+    }
+    else if (c == '}' || c == ']') {
+      if (--_depth == 0) {
+        /* End of the top level object without finding the field. */
+        _state = State::Error;
+      }
+    }
+    else if (c == ',' && _depth == 1) {
+      _expectKey = true;
+    }
+    break;
+
+  case State::Key:
+    if (c == '"') {
+      _state = State::Colon;
+    }
+    else if (c == '\\') {
+      /* None of the keys of interest need escaping so an escaped key can't match. */
+      _keyOverflow = true;
+      _state = State::KeyEscape;
+    }
+    else if (_keyBufferLength < SIGNALING_JSON_MAX_KEY_LENGTH) {
+      _keyBuffer[_keyBufferLength++] = c;
+    }
+    else {
+      _keyOverflow = true;
+    }
+    break;
+
+  case State::KeyEscape:
+    _state = State::Key;
+    break;
+
+  case State::Colon:
+    if (c == ':') {
+      _expectKey = false;
+      _state = State::Value;
+    }
+    else if (!IsJsonWhitespace(c)) {
+      _state = State::Error;
+    }
+    break;
+
+  case State::Value:
+    if (c == '"') {
+      bool isMatch = !_keyOverflow && _keyBufferLength == _keyLength &&
+        memcmp(_keyBuffer, _key, _keyLength) == 0;
+
+      if (isMatch) {
+        _value.clear();
+        _highSurrogate = 0;
+        _state = State::Capture;
+      }
+      else {
+        _state = State::SkipString;
+      }
+    }
+    else if (!IsJsonWhitespace(c)) {
+      /* Number, literal, object or array value, let the scanner track its nesting. */
+      _state = State::Scan;
+      Step(c);
+    }
+    break;
+
+  case State::Capture:
+    if (c == '\\') {
+      _state = State::CaptureEscape;
+    }
+    else if (c == '"') {
+      if (_highSurrogate != 0) {
+        AppendCodePoint(UNICODE_REPLACEMENT_CHARACTER);
+      }
+      _state = State::Done;
+    }
+    else {
+      /* Unescaped control character. */
+      _state = State::Error;
+    }
+    break;
+
+  case State::CaptureEscape:
+    if (c == 'u') {
+      _unicode = 0;
+      _unicodeDigits = 0;
+      _state = State::CaptureUnicode;
+      break;
+    }
+
+    if (_highSurrogate != 0) {
+      AppendCodePoint(UNICODE_REPLACEMENT_CHARACTER);
+      _highSurrogate = 0;
+    }
+
+    _state = State::Capture;
+
+    switch (c) {
+    case '"': _value.push_back('"'); break;
+    case '\\': _value.push_back('\\'); break;
+    case '/': _value.push_back('/'); break;
+    case 'b': _value.push_back('\b'); break;
+    case 'f': _value.push_back('\f'); break;
+    case 'n': _value.push_back('\n'); break;
+    case 'r': _value.push_back('\r'); break;
+    case 't': _value.push_back('\t'); break;
+    default: _state = State::Error; break;
+    }
+    break;
+
+  case State::CaptureUnicode:
+  {
+    int hex = HexValue(c);
+    if (hex < 0) {
+      _state = State::Error;
+      break;
+    }
+
+    _unicode = (_unicode << 4) | hex;
+    if (++_unicodeDigits < 4) {
+      break;
+    }
+
+    _state = State::Capture;
+
+    if (_unicode >= 0xD800 && _unicode <= 0xDBFF) {
+      if (_highSurrogate != 0) {
+        AppendCodePoint(UNICODE_REPLACEMENT_CHARACTER);
+      }
+      _highSurrogate = _unicode;
+    }
+    else if (_unicode >= 0xDC00 && _unicode <= 0xDFFF) {
+      if (_highSurrogate != 0) {
+        AppendCodePoint(0x10000 + ((_highSurrogate - 0xD800) << 10) + (_unicode - 0xDC00));
+        _highSurrogate = 0;
+      }
+      else {
+        AppendCodePoint(UNICODE_REPLACEMENT_CHARACTER);
+      }
+    }
+    else {
+      if (_highSurrogate != 0) {
+        AppendCodePoint(UNICODE_REPLACEMENT_CHARACTER);
+        _highSurrogate = 0;
+      }
+      AppendCodePoint(_unicode);
+    }
+    break;
+  }
+
+  case State::SkipString:
+    if (c == '\\') {
+      _state = State::SkipStringEscape;
+    }
+    else if (c == '"') {
+      _state = State::Scan;
+    }
+    else {
+      _state = State::Error;
+    }
+    break;
+
+  case State::SkipStringEscape:
+    _state = State::SkipString;
+    break;
+
+  case State::Done:
+  case State::Error:
+    break;
+  }
+}
+
+void JsonStringFieldExtractor::AppendCodePoint(uint32_t codePoint)
+{
+  if (codePoint < 0x80) {
+    _value.push_back(static_cast<char>(codePoint));
+  }
+  else if (codePoint < 0x800) {
+    _value.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+    _value.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  }
+  else if (codePoint < 0x10000) {
+    _value.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+    _value.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+    _value.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  }
+  else {
+    _value.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+    _value.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+    _value.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+    _value.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+  }
+}
+
+bool ExtractJsonStringField(evbuffer* buffer, const char* key, std::string& value)
+{
+  JsonStringFieldExtractor extractor(key, value);
+
+  /* The escaped value is an upper bound on the unescaped length. */
+  value.reserve(evbuffer_get_length(buffer));
+
+  int chunkCount = evbuffer_peek(buffer, -1, nullptr, nullptr, 0);
+  if (chunkCount <= 0) {
+    return false;
+  }
+
+  std::vector<evbuffer_iovec> chunks(chunkCount);
+  evbuffer_peek(buffer, -1, nullptr, chunks.data(), chunkCount);
+
+  for (auto& chunk : chunks) {
+    if (!extractor.Feed(static_cast<const char*>(chunk.iov_base), chunk.iov_len)) {
+      break;
+    }
+  }
+
+  return extractor.IsFound();
+}
+
+int AppendSdpJson(evbuffer* buffer, const char* type, const std::string& sdp)
+{
+  static const char hexDigits[] = "0123456789abcdef";
+
+  if (evbuffer_add_printf(buffer, "{\"type\":\"%s\",\"sdp\":\"", type) < 0) {
+    return -1;
+  }
+
+  /* Escaped output is written in runs so most of the SDP goes in with a handful of adds. */
+  const char* data = sdp.data();
+  const char* end = data + sdp.size();
+  const char* runStart = data;
+
+  for (; data < end; data++) {
+    unsigned char c = static_cast<unsigned char>(*data);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    if (data > runStart && evbuffer_add(buffer, runStart, data - runStart) != 0) {
+      return -1;
+    }
+    runStart = data + 1;
+
+    char escape[6] = { '\\', 0, 0, 0, 0, 0 };
+    size_t escapeLength = 2;
+
+    switch (c) {
+    case '"': escape[1] = '"'; break;
+    case '\\': escape[1] = '\\'; break;
+    case '\n': escape[1] = 'n'; break;
+    case '\r': escape[1] = 'r'; break;
+    case '\t': escape[1] = 't'; break;
+    default:
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = hexDigits[c >> 4];
+      escape[5] = hexDigits[c & 0x0F];
+      escapeLength = 6;
+      break;
+    }
+
+    if (evbuffer_add(buffer, escape, escapeLength) != 0) {
+      return -1;
+    }
+  }
+
+  if (data > runStart && evbuffer_add(buffer, runStart, data - runStart) != 0) {
+    return -1;
+  }
+
+  return evbuffer_add(buffer, "\"}", 2);
+}
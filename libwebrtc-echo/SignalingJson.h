@@ -0,0 +1,89 @@
+/******************************************************************************
+* Filename: SignalingJson.h
+*
+* Description:
+* Minimal JSON handling for the signaling path. The only thing needed from an
+* offer is its "sdp" string so rather than building a DOM the request body is
+* scanned in place, chunk by chunk straight out of the libevent buffer, and
+* the unescaped SDP is the only copy made. The answer is escaped directly
+* into the response buffer.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __SIGNALING_JSON__
+#define __SIGNALING_JSON__
+
+#include <event2/buffer.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/* Longest key name that's tracked, anything longer can't match and is skipped. */
+#define SIGNALING_JSON_MAX_KEY_LENGTH 16
+
+/**
+* Incremental extractor for a string field in the top level object of a JSON
+* document. Input can be fed in arbitrary sized chunks, escape sequences split
+* across chunk boundaries are handled.
+*/
+class JsonStringFieldExtractor
+{
+public:
+  JsonStringFieldExtractor(const char* key, std::string& value);
+
+  /* Returns false once the field has been found or the input is malformed. */
+  bool Feed(const char* data, size_t length);
+
+  bool IsFound() const { return _state == State::Done; }
+  bool IsError() const { return _state == State::Error; }
+
+private:
+  enum class State
+  {
+    Start,
+    Scan,
+    Key,
+    KeyEscape,
+    Colon,
+    Value,
+    Capture,
+    CaptureEscape,
+    CaptureUnicode,
+    SkipString,
+    SkipStringEscape,
+    Done,
+    Error
+  };
+
+  const char* _key;
+  size_t _keyLength;
+  std::string& _value;
+  State _state;
+  int _depth;
+  bool _expectKey;
+  char _keyBuffer[SIGNALING_JSON_MAX_KEY_LENGTH];
+  size_t _keyBufferLength;
+  bool _keyOverflow;
+  uint32_t _unicode;
+  int _unicodeDigits;
+  uint32_t _highSurrogate;
+
+  void Step(char c);
+  void AppendCodePoint(uint32_t codePoint);
+};
+
+/* Extracts a top level string field from the buffer without draining or linearising it. */
+bool ExtractJsonStringField(evbuffer* buffer, const char* key, std::string& value);
+
+/* Appends {"type":"<type>","sdp":"<escaped sdp>"} to the buffer. */
+int AppendSdpJson(evbuffer* buffer, const char* type, const std::string& sdp);
+
+#endif
@@ -0,0 +1,638 @@
+/******************************************************************************
+* Filename: StatsCollector.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "StatsCollector.h"
+#include "Logger.h"
+#include "ObjectPool.h"
+#include "json.hpp"
+
+#include <api/stats/rtc_stats_collector_callback.h>
+#include <api/stats/rtcstats_objects.h>
+#include <rtc_base/task_utils/to_queued_task.h>
+#include <rtc_base/time_utils.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+/* A report that hasn't arrived after this long is assumed lost and requested again. */
+#define STATS_REQUEST_TIMEOUT_US (10 * rtc::kNumMicrosecsPerSec)
+
+template <typename T>
+static T ValueOr(const webrtc::RTCStatsMember<T>& member, T defaultValue)
+{
+  return member.is_defined() ? *member : defaultValue;
+}
+
+static std::string ConnectionStateToString(webrtc::PeerConnectionInterface::PeerConnectionState state)
+{
+  switch (state) {
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kNew: return "new";
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kConnecting: return "connecting";
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kConnected: return "connected";
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kDisconnected: return "disconnected";
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kFailed: return "failed";
+  case webrtc::PeerConnectionInterface::PeerConnectionState::kClosed: return "closed";
+  default: return "unknown";
+  }
+}
+
+struct PcStatsSnapshot
+{
+  std::string state;
+  double rttMs = 0;
+  int64_t packetsLost = 0;
+  double jitterMs = 0;
+  uint64_t bytesSent = 0;
+  uint64_t bytesReceived = 0;
+  double sendBitrateKbps = 0;
+  double recvBitrateKbps = 0;
+  uint64_t framesEncoded = 0;
+  uint64_t framesDecoded = 0;
+  double forwardedBitrateKbps = 0;
+  DataChannelEchoStats dataChannels{};
+  int64_t timestampUs = 0;
+  int64_t requestedAtUs = 0;
+};
+
+struct ThreadStatsSnapshot
+{
+  int64_t queueDelayUs = 0;
+  int64_t maxQueueDelayUs = 0;
+  size_t queueDepth = 0;
+  LatencyHistogramSnapshot taskLatency{};
+  double cpuPercent = 0;
+  int64_t cpuTimeUs = -1;
+  int64_t sampledAtUs = 0;
+  int numaNode = -1;
+  int lastCpu = -1;
+  int64_t migrations = -1;
+};
+
+/* Resident memory by NUMA node and how much of it is off the node the threads were placed on. */
+struct NumaMemorySnapshot
+{
+  std::map<int, uint64_t> memoryKb;
+  int numaNode = -1;
+  double remotePercent = 0;
+};
+
+/* CPU use as a percentage of one core between two samples of its CPU time. */
+static double CpuPercent(int64_t cpuTimeUs, int64_t previousCpuTimeUs, int64_t elapsedUs)
+{
+  if (cpuTimeUs < 0 || previousCpuTimeUs < 0 || elapsedUs <= 0) {
+    return 0;
+  }
+  return std::max<int64_t>(cpuTimeUs - previousCpuTimeUs, 0) * 100.0 / elapsedUs;
+}
+
+/**
+* Holds the latest statistics. Shared with the in-flight GetStats callbacks so
+* a late report arriving after the collector has gone is harmless.
+*/
+class StatsCache
+{
+public:
+  bool TryBeginCollect(const std::string& id, const std::string& state)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto& snapshot = _peerConnections[id];
+    int64_t nowUs = rtc::TimeMicros();
+    snapshot.state = state;
+    if (snapshot.requestedAtUs != 0 && nowUs - snapshot.requestedAtUs < STATS_REQUEST_TIMEOUT_US) {
+      return false;
+    }
+    snapshot.requestedAtUs = nowUs;
+    return true;
+  }
+
+  void Update(const std::string& id, PcStatsSnapshot update)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto& previous = _peerConnections[id];
+
+    int64_t elapsedUs = update.timestampUs - previous.timestampUs;
+    if (previous.timestampUs != 0 && elapsedUs > 0) {
+      update.sendBitrateKbps = (update.bytesSent - std::min(update.bytesSent, previous.bytesSent)) * 8000.0 / elapsedUs;
+      update.recvBitrateKbps = (update.bytesReceived - std::min(update.bytesReceived, previous.bytesReceived)) * 8000.0 / elapsedUs;
+    }
+
+    update.state = previous.state;
+    update.requestedAtUs = 0;
+    previous = update;
+  }
+
+  void UpdateThread(const std::string& name, int64_t queueDelayUs)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto& snapshot = _threads[name];
+    snapshot.queueDelayUs = queueDelayUs;
+    snapshot.maxQueueDelayUs = std::max(snapshot.maxQueueDelayUs, queueDelayUs);
+  }
+
+  /* Returns the thread's CPU use since it was last sampled. */
+  double UpdateThreadLoad(const std::string& name, size_t queueDepth, LatencyHistogramSnapshot taskLatency,
+    int64_t cpuTimeUs, int64_t sampledAtUs)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto& snapshot = _threads[name];
+    snapshot.queueDepth = queueDepth;
+    snapshot.taskLatency = std::move(taskLatency);
+    snapshot.cpuPercent = CpuPercent(cpuTimeUs, snapshot.cpuTimeUs, sampledAtUs - snapshot.sampledAtUs);
+    snapshot.cpuTimeUs = cpuTimeUs;
+    snapshot.sampledAtUs = sampledAtUs;
+    return snapshot.cpuPercent;
+  }
+
+  void UpdateThreadPlacement(const std::string& name, int numaNode, int lastCpu, int64_t migrations)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    auto& snapshot = _threads[name];
+    snapshot.numaNode = numaNode;
+    snapshot.lastCpu = lastCpu;
+    snapshot.migrations = migrations;
+  }
+
+  void UpdateNumaMemory(NumaMemorySnapshot numaMemory)
+  {
+    uint64_t totalKb = 0;
+    for (auto& node : numaMemory.memoryKb) {
+      totalKb += node.second;
+    }
+
+    if (numaMemory.numaNode >= 0 && totalKb > 0) {
+      uint64_t localKb = numaMemory.memoryKb.count(numaMemory.numaNode) ? numaMemory.memoryKb[numaMemory.numaNode] : 0;
+      numaMemory.remotePercent = (totalKb - localKb) * 100.0 / totalKb;
+    }
+
+    std::lock_guard<std::mutex> lck(_mtx);
+    _numaMemory = std::move(numaMemory);
+  }
+
+  NumaMemorySnapshot GetNumaMemory()
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    return _numaMemory;
+  }
+
+  void UpdateProcessLoad(int64_t cpuTimeUs, int64_t sampledAtUs)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _processCpuPercent = CpuPercent(cpuTimeUs, _processCpuTimeUs, sampledAtUs - _processSampledAtUs);
+    _processCpuTimeUs = cpuTimeUs;
+    _processSampledAtUs = sampledAtUs;
+  }
+
+  double GetProcessCpuPercent()
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    return _processCpuPercent;
+  }
+
+  /* Forgets any peer connections the factory no longer knows about. */
+  void Prune(const std::set<std::string>& ids)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    for (auto it = _peerConnections.begin(); it != _peerConnections.end();) {
+      it = (ids.count(it->first) == 0) ? _peerConnections.erase(it) : std::next(it);
+    }
+  }
+
+  void Copy(std::map<std::string, PcStatsSnapshot>& peerConnections,
+    std::map<std::string, ThreadStatsSnapshot>& threads)
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    peerConnections = _peerConnections;
+    threads = _threads;
+  }
+
+private:
+  std::mutex _mtx;
+  std::map<std::string, PcStatsSnapshot> _peerConnections;
+  std::map<std::string, ThreadStatsSnapshot> _threads;
+  double _processCpuPercent = 0;
+  int64_t _processCpuTimeUs = -1;
+  int64_t _processSampledAtUs = 0;
+  NumaMemorySnapshot _numaMemory;
+};
+
+class StatsCallback :
+  public webrtc::RTCStatsCollectorCallback,
+  public PooledObject<StatsCallback>
+{
+public:
+  StatsCallback(std::shared_ptr<StatsCache> cache, const PeerConnectionEntry& entry)
+    : _cache(cache), _entry(entry) {
+  }
+
+  void OnStatsDelivered(const rtc::scoped_refptr<const webrtc::RTCStatsReport>& report) override
+  {
+    PcStatsSnapshot snapshot;
+    snapshot.timestampUs = report->timestamp_us();
+    snapshot.forwardedBitrateKbps = _entry.observer->GetForwardedBitrateKbps();
+    snapshot.dataChannels = _entry.observer->GetDataChannelStats();
+
+    for (auto pair : report->GetStatsOfType<webrtc::RTCIceCandidatePairStats>()) {
+      if (ValueOr(pair->nominated, false) && pair->current_round_trip_time.is_defined()) {
+        snapshot.rttMs = *pair->current_round_trip_time * 1000.0;
+      }
+    }
+
+    for (auto inbound : report->GetStatsOfType<webrtc::RTCInboundRTPStreamStats>()) {
+      snapshot.bytesReceived += ValueOr<uint64_t>(inbound->bytes_received, 0);
+      snapshot.packetsLost += ValueOr<int32_t>(inbound->packets_lost, 0);
+      snapshot.jitterMs = std::max(snapshot.jitterMs, ValueOr(inbound->jitter, 0.0) * 1000.0);
+      snapshot.framesDecoded += ValueOr<uint32_t>(inbound->frames_decoded, 0);
+    }
+
+    for (auto outbound : report->GetStatsOfType<webrtc::RTCOutboundRTPStreamStats>()) {
+      snapshot.bytesSent += ValueOr<uint64_t>(outbound->bytes_sent, 0);
+      snapshot.framesEncoded += ValueOr<uint32_t>(outbound->frames_encoded, 0);
+    }
+
+    _cache->Update(_entry.id, snapshot);
+  }
+
+private:
+  std::shared_ptr<StatsCache> _cache;
+  PeerConnectionEntry _entry;
+};
+
+DEFINE_OBJECT_POOL(StatsCallback)
+
+StatsCollector::StatsCollector(PcFactory* pcFactory, int intervalMs) :
+  _pcFactory(pcFactory),
+  _intervalMs(intervalMs),
+  _threadWarnPercent(STATS_THREAD_WARN_PERCENT),
+  _cache(std::make_shared<StatsCache>()),
+  _stop(false)
+{ }
+
+StatsCollector::~StatsCollector()
+{
+  Stop();
+}
+
+void StatsCollector::Start()
+{
+  _collectThread = std::thread(&StatsCollector::Run, this);
+}
+
+void StatsCollector::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lck(_stopMtx);
+    _stop = true;
+  }
+  _stopCv.notify_all();
+
+  if (_collectThread.joinable()) {
+    _collectThread.join();
+  }
+}
+
+void StatsCollector::Run()
+{
+  std::unique_lock<std::mutex> lck(_stopMtx);
+
+  while (!_stop) {
+    lck.unlock();
+    Collect();
+    lck.lock();
+
+    _stopCv.wait_for(lck, std::chrono::milliseconds(_intervalMs), [this] { return _stop; });
+  }
+}
+
+void StatsCollector::Collect()
+{
+  std::set<std::string> ids;
+
+  /* Sessions that ended without a WHIP DELETE, or never connected, are only
+  * let go of here. */
+  size_t reapedCount = _pcFactory->ReapPeerConnections();
+  if (reapedCount > 0) {
+    LOG_VERBOSE("Reaped " << reapedCount << " inactive peer connections.");
+  }
+
+  for (auto& entry : _pcFactory->GetPeerConnections()) {
+    auto pcState = entry.pc->peer_connection_state();
+
+    /* Finished connections have nothing left to report, leaving them out
+    * drops their series rather than exporting one per connection ever made. */
+    if (pcState == webrtc::PeerConnectionInterface::PeerConnectionState::kClosed ||
+      pcState == webrtc::PeerConnectionInterface::PeerConnectionState::kFailed) {
+      continue;
+    }
+
+    ids.insert(entry.id);
+
+    auto state = ConnectionStateToString(pcState);
+
+    /* Skip connections whose previous report hasn't arrived yet rather than
+    * piling more work onto a busy signaling thread. */
+    if (_cache->TryBeginCollect(entry.id, state)) {
+      entry.pc->GetStats(new rtc::RefCountedObject<StatsCallback>(_cache, entry));
+    }
+  }
+
+  _cache->Prune(ids);
+
+  int numaNode = -1;
+
+  for (auto& thread : _pcFactory->GetThreads()) {
+    auto cache = _cache;
+    auto name = thread.first;
+    int64_t postedAtUs = rtc::TimeMicros();
+
+    thread.second->PostTask(webrtc::ToQueuedTask([cache, name, postedAtUs]() {
+      cache->UpdateThread(name, rtc::TimeMicros() - postedAtUs);
+    }));
+
+    double cpuPercent = _cache->UpdateThreadLoad(name, thread.second->GetQueueDepth(),
+      thread.second->GetTaskLatency().GetSnapshot(), thread.second->GetCpuTimeUs(), postedAtUs);
+
+    if (cpuPercent >= _threadWarnPercent) {
+      LOG_INFO("The " << name << " thread used " << static_cast<int>(cpuPercent) << "% CPU, over the "
+        << _threadWarnPercent << "% warning threshold.");
+    }
+
+    auto& placement = thread.second->GetPlacement();
+    _cache->UpdateThreadPlacement(name, placement.numaNode, thread.second->GetLastCpu(), thread.second->GetMigrations());
+    numaNode = std::max(numaNode, placement.numaNode);
+  }
+
+  _cache->UpdateProcessLoad(InstrumentedThread::GetProcessCpuTimeUs(), rtc::TimeMicros());
+
+  NumaMemorySnapshot numaMemory;
+  numaMemory.memoryKb = GetProcessNumaMemoryKb();
+  numaMemory.numaNode = numaNode;
+  _cache->UpdateNumaMemory(std::move(numaMemory));
+}
+
+std::string StatsCollector::GetJson()
+{
+  std::map<std::string, PcStatsSnapshot> peerConnections;
+  std::map<std::string, ThreadStatsSnapshot> threads;
+  _cache->Copy(peerConnections, threads);
+
+  nlohmann::json statsJson;
+  statsJson["peerConnections"] = nlohmann::json::array();
+
+  for (auto& pc : peerConnections) {
+    auto& s = pc.second;
+    statsJson["peerConnections"].push_back({
+      { "id", pc.first },
+      { "state", s.state },
+      { "rttMs", s.rttMs },
+      { "packetsLost", s.packetsLost },
+      { "jitterMs", s.jitterMs },
+      { "bytesSent", s.bytesSent },
+      { "bytesReceived", s.bytesReceived },
+      { "sendBitrateKbps", s.sendBitrateKbps },
+      { "recvBitrateKbps", s.recvBitrateKbps },
+      { "framesEncoded", s.framesEncoded },
+      { "framesDecoded", s.framesDecoded },
+      { "forwardedBitrateKbps", s.forwardedBitrateKbps },
+      { "dataChannelMessages", s.dataChannels.messages },
+      { "dataChannelBytes", s.dataChannels.bytes },
+      { "dataChannelMessagesPerSecond", s.dataChannels.messagesPerSecond },
+      { "dataChannelBytesPerSecond", s.dataChannels.bytesPerSecond },
+      { "dataChannelEchoTurnaroundAvgUs", s.dataChannels.turnaroundAvgUs },
+      { "dataChannelEchoTurnaroundMaxUs", s.dataChannels.turnaroundMaxUs } });
+  }
+
+  statsJson["threads"] = nlohmann::json::object();
+  for (auto& thread : threads) {
+    auto& taskLatency = thread.second.taskLatency;
+    statsJson["threads"][thread.first] = {
+      { "queueDelayUs", thread.second.queueDelayUs },
+      { "maxQueueDelayUs", thread.second.maxQueueDelayUs },
+      { "queueDepth", thread.second.queueDepth },
+      { "cpuPercent", thread.second.cpuPercent },
+      { "tasks", taskLatency.count },
+      { "taskMeanUs", taskLatency.meanUs },
+      { "taskP99Us", taskLatency.p99Us },
+      { "taskMaxUs", taskLatency.maxUs },
+      { "numaNode", thread.second.numaNode },
+      { "lastCpu", thread.second.lastCpu },
+      { "migrations", thread.second.migrations } };
+  }
+
+  auto numaMemory = _cache->GetNumaMemory();
+  statsJson["process"] = {
+    { "cpuPercent", _cache->GetProcessCpuPercent() },
+    { "numaNode", numaMemory.numaNode },
+    { "remoteMemoryPercent", numaMemory.remotePercent },
+    { "numaMemoryKb", nlohmann::json::object() } };
+  for (auto& node : numaMemory.memoryKb) {
+    statsJson["process"]["numaMemoryKb"][std::to_string(node.first)] = node.second;
+  }
+
+  auto answerCache = _pcFactory->GetAnswerCacheStats();
+  statsJson["answerCache"] = {
+    { "hits", answerCache.hits },
+    { "misses", answerCache.misses },
+    { "fallbacks", answerCache.fallbacks },
+    { "entries", answerCache.entries } };
+
+  statsJson["setupStages"] = nlohmann::json::object();
+  for (auto& stage : _pcFactory->GetSetupTracer().GetStageStats()) {
+    statsJson["setupStages"][SetupTracer::GetStageName(stage.stage)] = {
+      { "count", stage.latency.count },
+      { "meanMs", stage.latency.meanUs / 1000.0 },
+      { "p50Ms", stage.latency.p50Us / 1000.0 },
+      { "p95Ms", stage.latency.p95Us / 1000.0 },
+      { "p99Ms", stage.latency.p99Us / 1000.0 },
+      { "maxMs", stage.latency.maxUs / 1000.0 } };
+  }
+
+  statsJson["objectPools"] = nlohmann::json::object();
+  for (auto& pool : ObjectPool::GetAllStats()) {
+    statsJson["objectPools"][pool.name] = {
+      { "allocations", pool.allocations },
+      { "heapAllocations", pool.heapAllocations },
+      { "live", pool.live },
+      { "free", pool.free } };
+  }
+
+  return statsJson.dump();
+}
+
+static void WritePrometheusHistogram(std::ostringstream& out, const char* name, const std::string& labels,
+  const std::vector<int64_t>& boundsUs, const LatencyHistogramSnapshot& snapshot)
+{
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < boundsUs.size(); i++) {
+    cumulative += snapshot.buckets[i];
+    out << name << "_bucket{" << labels << ",le=\"" << boundsUs[i] / 1e6 << "\"} " << cumulative << "\n";
+  }
+  out << name << "_bucket{" << labels << ",le=\"+Inf\"} " << snapshot.count << "\n";
+  out << name << "_sum{" << labels << "} " << snapshot.sumUs / 1e6 << "\n";
+  out << name << "_count{" << labels << "} " << snapshot.count << "\n";
+}
+
+std::string StatsCollector::GetPrometheus()
+{
+  std::map<std::string, PcStatsSnapshot> peerConnections;
+  std::map<std::string, ThreadStatsSnapshot> threads;
+  _cache->Copy(peerConnections, threads);
+
+  std::ostringstream out;
+
+  auto gauge = [&](const char* name, const char* help, std::function<double(const PcStatsSnapshot&)> value) {
+    out << "# HELP webrtc_echo_" << name << " " << help << "\n";
+    out << "# TYPE webrtc_echo_" << name << " gauge\n";
+    for (auto& pc : peerConnections) {
+      out << "webrtc_echo_" << name << "{pc=\"" << pc.first << "\"} " << value(pc.second) << "\n";
+    }
+  };
+
+  out << "# HELP webrtc_echo_peer_connections Number of tracked peer connections.\n";
+  out << "# TYPE webrtc_echo_peer_connections gauge\n";
+  out << "webrtc_echo_peer_connections " << peerConnections.size() << "\n";
+
+  gauge("rtt_ms", "Round trip time of the nominated candidate pair.", [](const PcStatsSnapshot& s) { return s.rttMs; });
+  gauge("packets_lost", "Packets lost across all inbound RTP streams.", [](const PcStatsSnapshot& s) { return (double)s.packetsLost; });
+  gauge("jitter_ms", "Highest jitter across the inbound RTP streams.", [](const PcStatsSnapshot& s) { return s.jitterMs; });
+  gauge("send_bitrate_kbps", "Outbound RTP bitrate over the last collection interval.", [](const PcStatsSnapshot& s) { return s.sendBitrateKbps; });
+  gauge("recv_bitrate_kbps", "Inbound RTP bitrate over the last collection interval.", [](const PcStatsSnapshot& s) { return s.recvBitrateKbps; });
+  gauge("frames_encoded", "Video frames encoded.", [](const PcStatsSnapshot& s) { return (double)s.framesEncoded; });
+  gauge("frames_decoded", "Video frames decoded.", [](const PcStatsSnapshot& s) { return (double)s.framesDecoded; });
+  gauge("forwarded_bitrate_kbps", "Average bitrate of the echoed media since connecting.", [](const PcStatsSnapshot& s) { return s.forwardedBitrateKbps; });
+  gauge("datachannel_messages_per_second", "Data channel messages echoed per second.", [](const PcStatsSnapshot& s) { return s.dataChannels.messagesPerSecond; });
+  gauge("datachannel_bytes_per_second", "Data channel bytes echoed per second.", [](const PcStatsSnapshot& s) { return s.dataChannels.bytesPerSecond; });
+  gauge("datachannel_echo_turnaround_us", "Average time from a data channel message arriving to its echo being sent, not a network round trip.", [](const PcStatsSnapshot& s) { return s.dataChannels.turnaroundAvgUs; });
+
+  out << "# HELP webrtc_echo_thread_queue_delay_us Delay before a task posted to the thread ran.\n";
+  out << "# TYPE webrtc_echo_thread_queue_delay_us gauge\n";
+  for (auto& thread : threads) {
+    out << "webrtc_echo_thread_queue_delay_us{thread=\"" << thread.first << "\"} " << thread.second.queueDelayUs << "\n";
+  }
+
+  out << "# HELP webrtc_echo_thread_max_queue_delay_us Largest task queue delay seen for the thread.\n";
+  out << "# TYPE webrtc_echo_thread_max_queue_delay_us gauge\n";
+  for (auto& thread : threads) {
+    out << "webrtc_echo_thread_max_queue_delay_us{thread=\"" << thread.first << "\"} " << thread.second.maxQueueDelayUs << "\n";
+  }
+
+  out << "# HELP webrtc_echo_thread_queue_depth Messages and tasks waiting on the thread.\n";
+  out << "# TYPE webrtc_echo_thread_queue_depth gauge\n";
+  for (auto& thread : threads) {
+    out << "webrtc_echo_thread_queue_depth{thread=\"" << thread.first << "\"} " << thread.second.queueDepth << "\n";
+  }
+
+  out << "# HELP webrtc_echo_thread_cpu_percent CPU used by the thread over the last collection interval.\n";
+  out << "# TYPE webrtc_echo_thread_cpu_percent gauge\n";
+  for (auto& thread : threads) {
+    out << "webrtc_echo_thread_cpu_percent{thread=\"" << thread.first << "\"} " << thread.second.cpuPercent << "\n";
+  }
+
+  out << "# HELP webrtc_echo_thread_task_seconds Time taken by each message or task the thread dispatched.\n";
+  out << "# TYPE webrtc_echo_thread_task_seconds histogram\n";
+  for (auto& thread : threads) {
+    WritePrometheusHistogram(out, "webrtc_echo_thread_task_seconds", "thread=\"" + thread.first + "\"",
+      INSTRUMENTED_THREAD_TASK_BOUNDS_US, thread.second.taskLatency);
+  }
+
+  out << "# HELP webrtc_echo_process_cpu_percent CPU used by the process over the last collection interval.\n";
+  out << "# TYPE webrtc_echo_process_cpu_percent gauge\n";
+  out << "webrtc_echo_process_cpu_percent " << _cache->GetProcessCpuPercent() << "\n";
+
+  out << "# HELP webrtc_echo_thread_migrations_total Times the scheduler moved the thread to another core.\n";
+  out << "# TYPE webrtc_echo_thread_migrations_total counter\n";
+  for (auto& thread : threads) {
+    if (thread.second.migrations >= 0) {
+      out << "webrtc_echo_thread_migrations_total{thread=\"" << thread.first << "\"} " << thread.second.migrations << "\n";
+    }
+  }
+
+  auto numaMemory = _cache->GetNumaMemory();
+  out << "# HELP webrtc_echo_process_numa_memory_bytes Resident memory of the process on each NUMA node.\n";
+  out << "# TYPE webrtc_echo_process_numa_memory_bytes gauge\n";
+  for (auto& node : numaMemory.memoryKb) {
+    out << "webrtc_echo_process_numa_memory_bytes{node=\"" << node.first << "\"} " << node.second * 1024 << "\n";
+  }
+  out << "# HELP webrtc_echo_process_remote_memory_percent Resident memory off the NUMA node the threads are placed on.\n";
+  out << "# TYPE webrtc_echo_process_remote_memory_percent gauge\n";
+  out << "webrtc_echo_process_remote_memory_percent " << numaMemory.remotePercent << "\n";
+
+  auto answerCache = _pcFactory->GetAnswerCacheStats();
+  out << "# HELP webrtc_echo_answer_cache_hits_total Offers answered from a cached template.\n";
+  out << "# TYPE webrtc_echo_answer_cache_hits_total counter\n";
+  out << "webrtc_echo_answer_cache_hits_total " << answerCache.hits << "\n";
+  out << "# HELP webrtc_echo_answer_cache_misses_total Offers with no cached template.\n";
+  out << "# TYPE webrtc_echo_answer_cache_misses_total counter\n";
+  out << "webrtc_echo_answer_cache_misses_total " << answerCache.misses << "\n";
+  out << "# HELP webrtc_echo_answer_cache_fallbacks_total Cached answers rejected in favour of a full CreateAnswer.\n";
+  out << "# TYPE webrtc_echo_answer_cache_fallbacks_total counter\n";
+  out << "webrtc_echo_answer_cache_fallbacks_total " << answerCache.fallbacks << "\n";
+
+  out << "# HELP webrtc_echo_setup_stage_seconds Time taken by each peer connection setup stage.\n";
+  out << "# TYPE webrtc_echo_setup_stage_seconds histogram\n";
+  for (auto& stage : _pcFactory->GetSetupTracer().GetStageStats()) {
+    WritePrometheusHistogram(out, "webrtc_echo_setup_stage_seconds", "stage=\"" + std::string(SetupTracer::GetStageName(stage.stage)) + "\"",
+      SetupTracer::GetBucketBoundsUs(), stage.latency);
+  }
+
+  auto pools = ObjectPool::GetAllStats();
+  out << "# HELP webrtc_echo_object_pool_live Pooled signaling objects currently allocated.\n";
+  out << "# TYPE webrtc_echo_object_pool_live gauge\n";
+  for (auto& pool : pools) {
+    out << "webrtc_echo_object_pool_live{pool=\"" << pool.name << "\"} " << pool.live << "\n";
+  }
+  out << "# HELP webrtc_echo_object_pool_heap_allocations_total Pooled object allocations that had to go to the heap.\n";
+  out << "# TYPE webrtc_echo_object_pool_heap_allocations_total counter\n";
+  for (auto& pool : pools) {
+    out << "webrtc_echo_object_pool_heap_allocations_total{pool=\"" << pool.name << "\"} " << pool.heapAllocations << "\n";
+  }
+
+  return out.str();
+}
+
+StatsSummary StatsCollector::GetSummary()
+{
+  std::map<std::string, PcStatsSnapshot> peerConnections;
+  std::map<std::string, ThreadStatsSnapshot> threads;
+  _cache->Copy(peerConnections, threads);
+
+  StatsSummary summary{};
+  size_t rttSamples = 0;
+
+  for (auto& pc : peerConnections) {
+    auto& s = pc.second;
+    summary.peerConnections++;
+    summary.packetsLost += s.packetsLost;
+    summary.maxJitterMs = std::max(summary.maxJitterMs, s.jitterMs);
+    summary.sendBitrateKbps += s.sendBitrateKbps;
+    summary.recvBitrateKbps += s.recvBitrateKbps;
+    summary.framesEncoded += s.framesEncoded;
+    summary.framesDecoded += s.framesDecoded;
+
+    if (s.rttMs > 0) {
+      summary.avgRttMs += s.rttMs;
+      rttSamples++;
+    }
+  }
+
+  if (rttSamples > 0) {
+    summary.avgRttMs /= rttSamples;
+  }
+
+  return summary;
+}
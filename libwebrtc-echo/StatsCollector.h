@@ -0,0 +1,85 @@
+/******************************************************************************
+* Filename: StatsCollector.h
+*
+* Description:
+* Periodically requests the WebRTC statistics for every peer connection
+* created by the PcFactory and caches an aggregated summary of them. Requests
+* to the HTTP stats endpoint are served from the cache so scrapers never
+* trigger GetStats calls on the signaling thread themselves. The delay for a
+* task posted to each of the factory's threads is also sampled as a measure
+* of how busy they are, along with each thread's queue depth, task times,
+* CPU use and migrations between cores. A thread using more CPU than the
+* warning threshold is logged. The process's resident memory per NUMA node
+* shows how much of it is remote to the node the threads were placed on.
+* Each collection first has the factory close and forget the peer connections
+* that have closed, failed or never connected.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __STATS_COLLECTOR__
+#define __STATS_COLLECTOR__
+
+#include "PcFactory.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* A thread above this CPU use is likely the first to saturate. */
+#define STATS_THREAD_WARN_PERCENT 85
+
+class StatsCache;
+
+/* Totals across every peer connection from the latest collection. */
+struct StatsSummary
+{
+  size_t peerConnections;
+  double avgRttMs;
+  int64_t packetsLost;
+  double maxJitterMs;
+  double sendBitrateKbps;
+  double recvBitrateKbps;
+  uint64_t framesEncoded;
+  uint64_t framesDecoded;
+};
+
+class StatsCollector
+{
+public:
+  StatsCollector(PcFactory* pcFactory, int intervalMs);
+  ~StatsCollector();
+
+  void Start();
+  void Stop();
+
+  void SetThreadWarnPercent(double threadWarnPercent) { _threadWarnPercent = threadWarnPercent; }
+
+  /* Renders the most recently collected statistics. */
+  std::string GetJson();
+  std::string GetPrometheus();
+  StatsSummary GetSummary();
+
+private:
+  PcFactory* _pcFactory;
+  int _intervalMs;
+  double _threadWarnPercent;
+  std::shared_ptr<StatsCache> _cache;
+  std::thread _collectThread;
+  std::mutex _stopMtx;
+  std::condition_variable _stopCv;
+  bool _stop;
+
+  void Run();
+  void Collect();
+};
+
+#endif
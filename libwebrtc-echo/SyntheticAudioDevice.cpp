@@ -0,0 +1,277 @@
+/******************************************************************************
+* Filename: SyntheticAudioDevice.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "SyntheticAudioDevice.h"
+#include "MediaClock.h"
+
+#include <rtc_base/time_utils.h>
+
+#include <cmath>
+
+#define SYNTHETIC_AUDIO_MAX_MIC_LEVEL 14392
+
+SyntheticAudioDevice::SyntheticAudioDevice(int sampleRate, size_t channels) :
+  _sampleRate(sampleRate),
+  _channels(channels),
+  _samplesPerFrame(sampleRate * SYNTHETIC_AUDIO_FRAME_MS / 1000),
+  _audioCallback(nullptr),
+  _initialized(false),
+  _playoutInitialized(false),
+  _recordingInitialized(false),
+  _playing(false),
+  _recording(false),
+  _micLevel(SYNTHETIC_AUDIO_MAX_MIC_LEVEL),
+  _clockSubscription(0)
+{
+  const double pi = 3.14159265358979323846;
+
+  _recordFrame.resize(_samplesPerFrame * _channels);
+  _playoutFrame.resize(_samplesPerFrame * _channels);
+
+  for (size_t i = 0; i < _samplesPerFrame; i++) {
+    int16_t sample = static_cast<int16_t>(SYNTHETIC_AUDIO_TONE_AMPLITUDE *
+      sin(2 * pi * SYNTHETIC_AUDIO_TONE_HZ * i / _sampleRate));
+    for (size_t ch = 0; ch < _channels; ch++) {
+      _recordFrame[i * _channels + ch] = sample;
+    }
+  }
+}
+
+SyntheticAudioDevice::~SyntheticAudioDevice()
+{
+  std::lock_guard<std::mutex> lck(_subscriptionMtx);
+  if (_clockSubscription != 0) {
+    MediaClock::Instance().Unsubscribe(_clockSubscription);
+  }
+}
+
+int32_t SyntheticAudioDevice::RegisterAudioCallback(webrtc::AudioTransport* audioCallback)
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _audioCallback = audioCallback;
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::Init()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _initialized = true;
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::Terminate()
+{
+  StopPlayout();
+  StopRecording();
+
+  std::lock_guard<std::mutex> lck(_mtx);
+  _initialized = false;
+  return 0;
+}
+
+bool SyntheticAudioDevice::Initialized() const
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return _initialized;
+}
+
+int32_t SyntheticAudioDevice::InitPlayout()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _playoutInitialized = true;
+  return 0;
+}
+
+bool SyntheticAudioDevice::PlayoutIsInitialized() const
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return _playoutInitialized;
+}
+
+int32_t SyntheticAudioDevice::StartPlayout()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (!_playoutInitialized) {
+      return -1;
+    }
+    _playing = true;
+  }
+  UpdateClockSubscription();
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::StopPlayout()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _playing = false;
+  }
+  UpdateClockSubscription();
+  return 0;
+}
+
+bool SyntheticAudioDevice::Playing() const
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return _playing;
+}
+
+int32_t SyntheticAudioDevice::InitRecording()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  _recordingInitialized = true;
+  return 0;
+}
+
+bool SyntheticAudioDevice::RecordingIsInitialized() const
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return _recordingInitialized;
+}
+
+int32_t SyntheticAudioDevice::StartRecording()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    if (!_recordingInitialized) {
+      return -1;
+    }
+    _recording = true;
+  }
+  UpdateClockSubscription();
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::StopRecording()
+{
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    _recording = false;
+  }
+  UpdateClockSubscription();
+  return 0;
+}
+
+bool SyntheticAudioDevice::Recording() const
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  return _recording;
+}
+
+int32_t SyntheticAudioDevice::StereoPlayoutIsAvailable(bool* available) const
+{
+  *available = _channels == 2;
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::SetStereoPlayout(bool enable)
+{
+  return (enable == (_channels == 2)) ? 0 : -1;
+}
+
+int32_t SyntheticAudioDevice::StereoPlayout(bool* enabled) const
+{
+  *enabled = _channels == 2;
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::StereoRecordingIsAvailable(bool* available) const
+{
+  *available = _channels == 2;
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::SetStereoRecording(bool enable)
+{
+  return (enable == (_channels == 2)) ? 0 : -1;
+}
+
+int32_t SyntheticAudioDevice::StereoRecording(bool* enabled) const
+{
+  *enabled = _channels == 2;
+  return 0;
+}
+
+int32_t SyntheticAudioDevice::PlayoutDelay(uint16_t* delayMs) const
+{
+  /* Playout audio is discarded as soon as it's pulled. */
+  *delayMs = 0;
+  return 0;
+}
+
+/**
+* Ticks are only needed while the device is playing or recording. Called after
+* the state has changed and with _mtx released, Unsubscribe waits for any tick
+* in progress to finish and that tick will be trying to take _mtx.
+*/
+void SyntheticAudioDevice::UpdateClockSubscription()
+{
+  std::lock_guard<std::mutex> subLck(_subscriptionMtx);
+
+  bool isActive = false;
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    isActive = _playing || _recording;
+  }
+
+  if (isActive && _clockSubscription == 0) {
+    _clockSubscription = MediaClock::Instance().Subscribe(
+      SYNTHETIC_AUDIO_FRAME_MS * rtc::kNumMicrosecsPerMillisec,
+      [this](int64_t tickTimeUs) { OnTick(tickTimeUs); });
+  }
+  else if (!isActive && _clockSubscription != 0) {
+    MediaClock::Instance().Unsubscribe(_clockSubscription);
+    _clockSubscription = 0;
+  }
+}
+
+void SyntheticAudioDevice::OnTick(int64_t tickTimeUs)
+{
+  webrtc::AudioTransport* audioCallback = nullptr;
+  bool playing = false;
+  bool recording = false;
+  uint32_t micLevel = 0;
+
+  {
+    std::lock_guard<std::mutex> lck(_mtx);
+    audioCallback = _audioCallback;
+    playing = _playing;
+    recording = _recording;
+    micLevel = _micLevel;
+  }
+
+  if (audioCallback == nullptr) {
+    return;
+  }
+
+  const size_t bytesPerFrame = sizeof(int16_t) * _channels;
+
+  if (playing) {
+    size_t samplesOut = 0;
+    int64_t elapsedTimeMs = 0;
+    int64_t ntpTimeMs = 0;
+    audioCallback->NeedMorePlayData(_samplesPerFrame, bytesPerFrame, _channels, _sampleRate,
+      _playoutFrame.data(), samplesOut, &elapsedTimeMs, &ntpTimeMs);
+  }
+
+  if (recording) {
+    uint32_t newMicLevel = micLevel;
+    audioCallback->RecordedDataIsAvailable(_recordFrame.data(), _samplesPerFrame, bytesPerFrame,
+      _channels, _sampleRate, 0 /* total delay ms */, 0 /* clock drift */, micLevel, false, newMicLevel);
+
+    std::lock_guard<std::mutex> lck(_mtx);
+    _micLevel = newMicLevel;
+  }
+}
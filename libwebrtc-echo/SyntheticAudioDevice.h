@@ -0,0 +1,95 @@
+/******************************************************************************
+* Filename: SyntheticAudioDevice.h
+*
+* Description:
+* Audio device module that replaces FakeAudioCaptureModule for capacity
+* testing. The sample rate and channel count are configurable, recording
+* delivers a tone that repeats exactly every 10 ms frame so the captured
+* audio is identical from run to run, and playout pulls and discards the
+* mixed remote audio. Frames are driven by the shared MediaClock rather than
+* a process thread per device.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __SYNTHETIC_AUDIO_DEVICE__
+#define __SYNTHETIC_AUDIO_DEVICE__
+
+#include <modules/audio_device/include/audio_device.h>
+#include <modules/audio_device/include/audio_device_default.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#define SYNTHETIC_AUDIO_FRAME_MS 10
+
+/* A whole number of cycles fits in every 10 ms frame at this frequency. */
+#define SYNTHETIC_AUDIO_TONE_HZ 500
+#define SYNTHETIC_AUDIO_TONE_AMPLITUDE 10000
+
+class SyntheticAudioDevice :
+  public webrtc::webrtc_impl::AudioDeviceModuleDefault<webrtc::AudioDeviceModule>
+{
+public:
+  SyntheticAudioDevice(int sampleRate, size_t channels);
+  ~SyntheticAudioDevice();
+
+  int32_t RegisterAudioCallback(webrtc::AudioTransport* audioCallback) override;
+  int32_t Init() override;
+  int32_t Terminate() override;
+  bool Initialized() const override;
+
+  int32_t InitPlayout() override;
+  bool PlayoutIsInitialized() const override;
+  int32_t StartPlayout() override;
+  int32_t StopPlayout() override;
+  bool Playing() const override;
+
+  int32_t InitRecording() override;
+  bool RecordingIsInitialized() const override;
+  int32_t StartRecording() override;
+  int32_t StopRecording() override;
+  bool Recording() const override;
+
+  int32_t StereoPlayoutIsAvailable(bool* available) const override;
+  int32_t SetStereoPlayout(bool enable) override;
+  int32_t StereoPlayout(bool* enabled) const override;
+  int32_t StereoRecordingIsAvailable(bool* available) const override;
+  int32_t SetStereoRecording(bool enable) override;
+  int32_t StereoRecording(bool* enabled) const override;
+
+  int32_t PlayoutDelay(uint16_t* delayMs) const override;
+
+private:
+  int _sampleRate;
+  size_t _channels;
+  size_t _samplesPerFrame;
+  std::vector<int16_t> _recordFrame;
+  std::vector<int16_t> _playoutFrame;
+
+  /* _mtx guards the device state and is taken on the clock thread, the clock
+  * subscription is changed under _subscriptionMtx so that's never nested
+  * inside a tick. */
+  mutable std::mutex _mtx;
+  std::mutex _subscriptionMtx;
+  webrtc::AudioTransport* _audioCallback;
+  bool _initialized;
+  bool _playoutInitialized;
+  bool _recordingInitialized;
+  bool _playing;
+  bool _recording;
+  uint32_t _micLevel;
+  int _clockSubscription;
+
+  void UpdateClockSubscription();
+  void OnTick(int64_t tickTimeUs);
+};
+
+#endif
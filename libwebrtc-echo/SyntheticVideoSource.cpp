@@ -0,0 +1,84 @@
+/******************************************************************************
+* Filename: SyntheticVideoSource.cpp
+*
+* Description: See header file.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "SyntheticVideoSource.h"
+#include "MediaClock.h"
+
+#include <api/video/video_frame.h>
+#include <rtc_base/time_utils.h>
+
+#include <cstring>
+
+SyntheticVideoSource::SyntheticVideoSource(int width, int height, int fps) :
+  _fps(fps),
+  _clockSubscription(0),
+  _frameIndex(0)
+{
+  for (int i = 0; i < SYNTHETIC_VIDEO_LOOP_FRAMES; i++) {
+    _frames.push_back(RenderFrame(width, height, i));
+  }
+}
+
+SyntheticVideoSource::~SyntheticVideoSource()
+{
+  Stop();
+}
+
+void SyntheticVideoSource::Start()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  if (_clockSubscription == 0) {
+    _clockSubscription = MediaClock::Instance().Subscribe(rtc::kNumMicrosecsPerSec / _fps,
+      [this](int64_t tickTimeUs) { OnTick(tickTimeUs); });
+  }
+}
+
+void SyntheticVideoSource::Stop()
+{
+  std::lock_guard<std::mutex> lck(_mtx);
+  if (_clockSubscription != 0) {
+    MediaClock::Instance().Unsubscribe(_clockSubscription);
+    _clockSubscription = 0;
+  }
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer> SyntheticVideoSource::RenderFrame(int width, int height, int frameIndex)
+{
+  auto buffer = webrtc::I420Buffer::Create(width, height);
+  uint8_t offset = static_cast<uint8_t>(frameIndex * (256 / SYNTHETIC_VIDEO_LOOP_FRAMES));
+
+  /* Horizontal luma gradient that scrolls each frame so the encoder has real work. */
+  for (int y = 0; y < height; y++) {
+    uint8_t* row = buffer->MutableDataY() + y * buffer->StrideY();
+    for (int x = 0; x < width; x++) {
+      row[x] = static_cast<uint8_t>(x + offset);
+    }
+  }
+  memset(buffer->MutableDataU(), 128, buffer->StrideU() * buffer->ChromaHeight());
+  memset(buffer->MutableDataV(), 128, buffer->StrideV() * buffer->ChromaHeight());
+
+  return buffer;
+}
+
+void SyntheticVideoSource::OnTick(int64_t tickTimeUs)
+{
+  /* The loop buffers are shared by every frame sent, sinks only ever read them. */
+  OnFrame(webrtc::VideoFrame::Builder()
+    .set_video_frame_buffer(_frames[_frameIndex])
+    .set_rotation(webrtc::kVideoRotation_0)
+    .set_timestamp_us(tickTimeUs)
+    .build());
+
+  _frameIndex = (_frameIndex + 1) % _frames.size();
+}
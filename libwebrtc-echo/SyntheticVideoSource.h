@@ -0,0 +1,62 @@
+/******************************************************************************
+* Filename: SyntheticVideoSource.h
+*
+* Description:
+* Video track source that generates I420 frames with a moving gradient at a
+* fixed resolution and frame rate. A single instance can feed the video
+* tracks of any number of peer connections. The frames are rendered once up
+* front as a loop that scrolls back to its start seamlessly, and are emitted
+* on the shared MediaClock, so the source itself costs next to no CPU.
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#ifndef __SYNTHETIC_VIDEO_SOURCE__
+#define __SYNTHETIC_VIDEO_SOURCE__
+
+#include <media/base/adapted_video_track_source.h>
+
+#include <api/scoped_refptr.h>
+#include <api/video/i420_buffer.h>
+
+#include <mutex>
+#include <vector>
+
+/* The gradient scrolls 256 / SYNTHETIC_VIDEO_LOOP_FRAMES luma steps per frame. */
+#define SYNTHETIC_VIDEO_LOOP_FRAMES 16
+
+class SyntheticVideoSource :
+  public rtc::AdaptedVideoTrackSource
+{
+public:
+  SyntheticVideoSource(int width, int height, int fps);
+  ~SyntheticVideoSource();
+
+  void Start();
+  void Stop();
+
+  webrtc::MediaSourceInterface::SourceState state() const override { return kLive; }
+  bool remote() const override { return false; }
+  bool is_screencast() const override { return false; }
+  absl::optional<bool> needs_denoising() const override { return false; }
+
+  /* Frame frameIndex of the loop, also used to feed the pre-encoded video loop. */
+  static rtc::scoped_refptr<webrtc::I420Buffer> RenderFrame(int width, int height, int frameIndex);
+
+private:
+  int _fps;
+  std::vector<rtc::scoped_refptr<webrtc::I420Buffer>> _frames;
+  std::mutex _mtx;
+  int _clockSubscription;
+  size_t _frameIndex;
+
+  void OnTick(int64_t tickTimeUs);
+};
+
+#endif
@@ -0,0 +1,427 @@
+/******************************************************************************
+* Filename: libwebrtc-echo-load.cpp
+*
+* Description:
+* Load generator for the libwebrtc echo server. Synthetic client peers are
+* created with the same PcFactory the server uses, each with a synthetic
+* audio track and a shared synthetic video track, all driven by one clock. Offers are POSTed to the server's
+* offer endpoint at a fixed arrival rate and the peers are kept connected
+* until the test duration expires. Setup latency percentiles, connected peer
+* count, CPU per peer and media statistics are reported periodically. The CPU
+* figure is the load generator's own unless --server-pid names the server
+* process, in which case the server's is reported as well.
+*
+* Everything runs over loopback, ICE gathering is restricted to the loopback
+* adapter and the server URL must be a loopback address. The server needs to
+* be started with --loopback so that it also offers loopback candidates.
+*
+* Usage:
+* libwebrtc-echo-load [--url http://127.0.0.1:8080/offer] [--peers 10]
+*   [--rate 2] [--duration 60] [--report 5] [--width 640] [--height 480]
+*   [--fps 30] [--no-video] [--sample-rate 48000] [--channels 1]
+*   [--pre-encoded] [--audio-codec opus|g711] [--opus-complexity 0-10]
+*   [--video-codecs vp8[:threads=N][:complexity=high],vp9,h264] [--apm]
+*   [--server-pid pid]
+*
+* Author:
+* Aaron Clauson (aaron@sipsorcery.com)
+*
+* History:
+* 19 Oct 2026	Aaron Clauson	  Created, Dublin, Ireland.
+*
+* License: Public Domain (no warranty, use at own risk)
+/******************************************************************************/
+
+#include "InstrumentedThread.h"
+#include "PcFactory.h"
+#include "StatsCollector.h"
+#include "SyntheticVideoSource.h"
+#include "json.hpp"
+
+#include <event2/buffer.h>
+#include <event2/event.h>
+#include <event2/http.h>
+#include <rtc_base/logging.h>
+#include <rtc_base/network_constants.h>
+#include <rtc_base/time_utils.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define DEFAULT_OFFER_URL "http://127.0.0.1:8080/offer"
+#define DEFAULT_PEER_COUNT 10
+#define DEFAULT_ARRIVAL_RATE 2.0
+#define DEFAULT_DURATION_SECONDS 60
+#define DEFAULT_REPORT_SECONDS 5
+
+struct LoadOptions
+{
+  std::string url = DEFAULT_OFFER_URL;
+  int peers = DEFAULT_PEER_COUNT;
+  double rate = DEFAULT_ARRIVAL_RATE;
+  int durationSeconds = DEFAULT_DURATION_SECONDS;
+  int reportSeconds = DEFAULT_REPORT_SECONDS;
+  SyntheticMediaConfig media;
+  CodecProfile codecs;
+  bool video = true;
+
+  /* Server process to sample CPU use from, 0 for none. */
+  int64_t serverPid = 0;
+};
+
+struct LoadContext;
+
+struct LoadClient
+{
+  LoadContext* ctx;
+  PeerConnectionEntry entry;
+  int64_t startedAtMs;
+  bool failed;
+};
+
+struct LoadContext
+{
+  LoadOptions options;
+  PcFactory* pcFactory;
+  StatsCollector* statsCollector;
+  rtc::scoped_refptr<SyntheticVideoSource> videoSource;
+  std::string host;
+  int port;
+  std::string path;
+  event_base* base;
+  event* arrivalTimer;
+  event* reportTimer;
+  std::vector<std::unique_ptr<LoadClient>> clients;
+  int64_t allStartedAtMs;
+  int64_t lastReportAtMs;
+  int64_t lastCpuUs;
+  int64_t lastServerCpuUs;
+};
+
+static bool ParseOptions(int argc, char* argv[], LoadOptions& options);
+static bool IsLoopbackHost(const std::string& host);
+static int64_t GetProcessCpuMicros();
+static void OnArrival(evutil_socket_t fd, short events, void* arg);
+static void OnAnswer(struct evhttp_request* req, void* arg);
+static void OnReport(evutil_socket_t fd, short events, void* arg);
+
+int main(int argc, char* argv[])
+{
+  LoadContext ctx;
+
+  if (!ParseOptions(argc, argv, ctx.options)) {
+    std::cerr << "Usage: libwebrtc-echo-load [--url " DEFAULT_OFFER_URL "] [--peers N] [--rate offers/s] "
+      "[--duration s] [--report s] [--width px] [--height px] [--fps n] [--no-video] "
+      "[--sample-rate hz] [--channels 1|2] [--pre-encoded] [--server-pid pid] " CODEC_PROFILE_USAGE << std::endl;
+    return -1;
+  }
+
+  evhttp_uri* uri = evhttp_uri_parse(ctx.options.url.c_str());
+  if (uri == nullptr || evhttp_uri_get_host(uri) == nullptr) {
+    std::cerr << "Could not parse offer URL " << ctx.options.url << "." << std::endl;
+    return -1;
+  }
+
+  ctx.host = evhttp_uri_get_host(uri);
+  ctx.port = evhttp_uri_get_port(uri) > 0 ? evhttp_uri_get_port(uri) : 80;
+  ctx.path = evhttp_uri_get_path(uri) != nullptr ? evhttp_uri_get_path(uri) : "/";
+  evhttp_uri_free(uri);
+
+  if (!IsLoopbackHost(ctx.host)) {
+    std::cerr << "The load generator only runs against loopback, " << ctx.host << " is not a loopback host." << std::endl;
+    return -1;
+  }
+
+  std::cout << "libwebrtc echo load generator: " << ctx.options.peers << " peers at " << ctx.options.rate
+    << " offers/s against " << ctx.options.url << "." << std::endl;
+
+  rtc::LogMessage::LogToDebug(rtc::LoggingSeverity::WARNING);
+
+  {
+    PcFactory pcFactory(ctx.options.media, ctx.options.codecs);
+    pcFactory.SetNetworkIgnoreMask(~static_cast<int>(rtc::ADAPTER_TYPE_LOOPBACK));
+
+    StatsCollector statsCollector(&pcFactory, ctx.options.reportSeconds * 1000);
+    statsCollector.Start();
+
+    ctx.pcFactory = &pcFactory;
+    ctx.statsCollector = &statsCollector;
+    ctx.allStartedAtMs = 0;
+    ctx.lastReportAtMs = rtc::TimeMillis();
+    ctx.lastCpuUs = GetProcessCpuMicros();
+    ctx.lastServerCpuUs = -1;
+
+    if (ctx.options.serverPid != 0) {
+      ctx.lastServerCpuUs = InstrumentedThread::GetProcessCpuTimeUs(ctx.options.serverPid);
+      if (ctx.lastServerCpuUs < 0) {
+        std::cerr << "Could not read the CPU use of server process " << ctx.options.serverPid << "." << std::endl;
+        return -1;
+      }
+    }
+
+    if (ctx.options.video) {
+      ctx.videoSource = new rtc::RefCountedObject<SyntheticVideoSource>(
+        ctx.options.media.videoWidth, ctx.options.media.videoHeight, ctx.options.media.videoFps);
+      ctx.videoSource->Start();
+    }
+
+    ctx.base = event_base_new();
+
+    struct timeval arrivalInterval;
+    int64_t arrivalIntervalUs = static_cast<int64_t>(rtc::kNumMicrosecsPerSec / ctx.options.rate);
+    arrivalInterval.tv_sec = arrivalIntervalUs / rtc::kNumMicrosecsPerSec;
+    arrivalInterval.tv_usec = arrivalIntervalUs % rtc::kNumMicrosecsPerSec;
+    ctx.arrivalTimer = event_new(ctx.base, -1, EV_PERSIST, OnArrival, &ctx);
+    event_add(ctx.arrivalTimer, &arrivalInterval);
+
+    struct timeval reportInterval = { ctx.options.reportSeconds, 0 };
+    ctx.reportTimer = event_new(ctx.base, -1, EV_PERSIST, OnReport, &ctx);
+    event_add(ctx.reportTimer, &reportInterval);
+
+    event_base_dispatch(ctx.base);
+
+    event_free(ctx.arrivalTimer);
+    event_free(ctx.reportTimer);
+    event_base_free(ctx.base);
+
+    if (ctx.videoSource) {
+      ctx.videoSource->Stop();
+    }
+
+    statsCollector.Stop();
+
+    for (auto& client : ctx.clients) {
+      if (client->entry.pc) {
+        client->entry.pc->Close();
+      }
+    }
+  }
+
+  std::cout << "Exiting..." << std::endl;
+  return 0;
+}
+
+static bool ParseOptions(int argc, char* argv[], LoadOptions& options)
+{
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (arg == "--no-video") {
+      options.video = false;
+    }
+    else if (arg == "--url" && hasValue) {
+      options.url = argv[++i];
+    }
+    else if (arg == "--peers" && hasValue) {
+      options.peers = atoi(argv[++i]);
+    }
+    else if (arg == "--rate" && hasValue) {
+      options.rate = atof(argv[++i]);
+    }
+    else if (arg == "--duration" && hasValue) {
+      options.durationSeconds = atoi(argv[++i]);
+    }
+    else if (arg == "--report" && hasValue) {
+      options.reportSeconds = atoi(argv[++i]);
+    }
+    else if (arg == "--width" && hasValue) {
+      options.media.videoWidth = atoi(argv[++i]);
+    }
+    else if (arg == "--height" && hasValue) {
+      options.media.videoHeight = atoi(argv[++i]);
+    }
+    else if (arg == "--fps" && hasValue) {
+      options.media.videoFps = atoi(argv[++i]);
+    }
+    else if (arg == "--sample-rate" && hasValue) {
+      options.media.audioSampleRate = atoi(argv[++i]);
+    }
+    else if (arg == "--channels" && hasValue) {
+      options.media.audioChannels = static_cast<size_t>(atoi(argv[++i]));
+    }
+    else if (arg == "--pre-encoded") {
+      options.media.preEncodedVideo = true;
+    }
+    else if (arg == "--server-pid" && hasValue) {
+      options.serverPid = atoll(argv[++i]);
+    }
+    else if (!ParseCodecProfileOption(argc, argv, i, options.codecs)) {
+      return false;
+    }
+  }
+
+  return options.peers > 0 && options.rate > 0 && options.durationSeconds > 0 &&
+    options.reportSeconds > 0 && options.media.videoWidth > 0 && options.media.videoHeight > 0 &&
+    options.media.videoFps > 0 && options.media.audioSampleRate > 0 && options.media.audioSampleRate % 100 == 0 &&
+    (options.media.audioChannels == 1 || options.media.audioChannels == 2) && options.serverPid >= 0;
+}
+
+static bool IsLoopbackHost(const std::string& host)
+{
+  return host == "localhost" || host == "::1" || host == "[::1]" || host.compare(0, 4, "127.") == 0;
+}
+
+static int64_t GetProcessCpuMicros()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * rtc::kNumMicrosecsPerSec +
+    usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/**
+* Timer callback that starts the next synthetic peer: creates its offer and
+* POSTs it to the echo server.
+*/
+static void OnArrival(evutil_socket_t fd, short events, void* arg)
+{
+  LoadContext* ctx = static_cast<LoadContext*>(arg);
+
+  if (ctx->clients.size() >= static_cast<size_t>(ctx->options.peers)) {
+    event_del(ctx->arrivalTimer);
+    ctx->allStartedAtMs = rtc::TimeMillis();
+    std::cout << "All " << ctx->options.peers << " peers started, running for a further "
+      << ctx->options.durationSeconds << "s." << std::endl;
+    return;
+  }
+
+  ctx->clients.push_back(std::make_unique<LoadClient>());
+  LoadClient* client = ctx->clients.back().get();
+  client->ctx = ctx;
+  client->startedAtMs = rtc::TimeMillis();
+  client->failed = false;
+
+  std::string offerSdp;
+  client->entry = ctx->pcFactory->CreateOfferPeerConnection(ctx->videoSource, offerSdp);
+
+  if (!client->entry.pc) {
+    client->failed = true;
+    return;
+  }
+
+  nlohmann::json offerJson;
+  offerJson["type"] = "offer";
+  offerJson["sdp"] = offerSdp;
+  std::string body = offerJson.dump();
+
+  evhttp_connection* conn = evhttp_connection_base_new(ctx->base, nullptr, ctx->host.c_str(), ctx->port);
+  evhttp_connection_free_on_completion(conn);
+
+  evhttp_request* req = evhttp_request_new(OnAnswer, client);
+  evhttp_add_header(evhttp_request_get_output_headers(req), "Host", ctx->host.c_str());
+  evhttp_add_header(evhttp_request_get_output_headers(req), "Content-Type", "application/json");
+  evbuffer_add(evhttp_request_get_output_buffer(req), body.data(), body.size());
+
+  if (evhttp_make_request(conn, req, EVHTTP_REQ_POST, ctx->path.c_str()) != 0) {
+    std::cerr << "Failed to send offer for peer " << client->entry.id << "." << std::endl;
+    client->failed = true;
+  }
+}
+
+static void OnAnswer(struct evhttp_request* req, void* arg)
+{
+  LoadClient* client = static_cast<LoadClient*>(arg);
+
+  if (req == nullptr || evhttp_request_get_response_code(req) != 200) {
+    std::cerr << "Offer for peer " << client->entry.id << " was rejected ("
+      << (req != nullptr ? evhttp_request_get_response_code(req) : 0) << ")." << std::endl;
+    client->failed = true;
+    return;
+  }
+
+  evbuffer* respBody = evhttp_request_get_input_buffer(req);
+  size_t respLength = evbuffer_get_length(respBody);
+  const char* respData = reinterpret_cast<const char*>(evbuffer_pullup(respBody, -1));
+
+  auto answerJson = nlohmann::json::parse(respData, respData + respLength, nullptr, false);
+
+  if (answerJson.is_discarded() || !answerJson.contains("sdp") ||
+    !client->ctx->pcFactory->SetRemoteAnswer(client->entry, answerJson["sdp"].get<std::string>())) {
+    client->failed = true;
+  }
+}
+
+/**
+* Periodic report of setup latency percentiles, connected peers, CPU and media
+* statistics. Also ends the run once the duration has elapsed.
+*/
+static void OnReport(evutil_socket_t fd, short events, void* arg)
+{
+  LoadContext* ctx = static_cast<LoadContext*>(arg);
+
+  int64_t nowMs = rtc::TimeMillis();
+  int64_t cpuUs = GetProcessCpuMicros();
+  int64_t elapsedMs = nowMs - ctx->lastReportAtMs;
+  double cpuPercent = (cpuUs - ctx->lastCpuUs) * 100.0 / (elapsedMs * 1000.0);
+  ctx->lastCpuUs = cpuUs;
+  ctx->lastReportAtMs = nowMs;
+
+  /* The server's CPU is what the per peer figure is really after, the load
+  * generator's own runs the client half of every peer. */
+  double serverCpuPercent = -1;
+  if (ctx->lastServerCpuUs >= 0) {
+    int64_t serverCpuUs = InstrumentedThread::GetProcessCpuTimeUs(ctx->options.serverPid);
+    if (serverCpuUs >= 0) {
+      serverCpuPercent = (serverCpuUs - ctx->lastServerCpuUs) * 100.0 / (elapsedMs * 1000.0);
+      ctx->lastServerCpuUs = serverCpuUs;
+    }
+  }
+
+  std::vector<int64_t> setupLatencies;
+  size_t failed = 0;
+
+  for (auto& client : ctx->clients) {
+    if (client->failed) {
+      failed++;
+    }
+    else if (client->entry.observer && client->entry.observer->GetConnectedAtMs() != 0) {
+      setupLatencies.push_back(client->entry.observer->GetConnectedAtMs() - client->startedAtMs);
+    }
+  }
+
+  std::sort(setupLatencies.begin(), setupLatencies.end());
+
+  auto percentile = [&setupLatencies](double p) -> int64_t {
+    if (setupLatencies.empty()) {
+      return 0;
+    }
+    size_t index = static_cast<size_t>(p / 100.0 * (setupLatencies.size() - 1) + 0.5);
+    return setupLatencies[index];
+  };
+
+  size_t connected = setupLatencies.size();
+  auto media = ctx->statsCollector->GetSummary();
+
+  std::cout << std::fixed << std::setprecision(1)
+    << "started " << ctx->clients.size() << "/" << ctx->options.peers
+    << " connected " << connected << " failed " << failed
+    << " | setup ms p50 " << percentile(50) << " p90 " << percentile(90)
+    << " p99 " << percentile(99) << " max " << (connected > 0 ? setupLatencies.back() : 0);
+
+  if (serverCpuPercent >= 0) {
+    std::cout << " | server cpu " << serverCpuPercent << "% ("
+      << (connected > 0 ? serverCpuPercent / connected : 0.0) << "%/peer)";
+  }
+  else if (ctx->lastServerCpuUs >= 0) {
+    std::cout << " | server cpu n/a";
+  }
+
+  std::cout << " | client cpu " << cpuPercent << "% (" << (connected > 0 ? cpuPercent / connected : 0.0) << "%/peer)"
+    << " | send " << media.sendBitrateKbps << "kbps recv " << media.recvBitrateKbps << "kbps"
+    << " rtt " << media.avgRttMs << "ms lost " << media.packetsLost
+    << " jitter " << media.maxJitterMs << "ms decoded " << media.framesDecoded << std::endl;
+
+  if (ctx->allStartedAtMs != 0 &&
+    nowMs - ctx->allStartedAtMs >= ctx->options.durationSeconds * rtc::kNumMillisecsPerSec) {
+    event_base_loopexit(ctx->base, nullptr);
+  }
+}
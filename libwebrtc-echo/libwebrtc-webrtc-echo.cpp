@@ -18,22 +18,108 @@
 /******************************************************************************/
 
 #include "HttpSimpleServer.h"
+#include "Logger.h"
+#include "ObjectPool.h"
 #include "PcFactory.h"
+#include "StatsCollector.h"
 
 #include <rtc_base/logging.h>
+#include <rtc_base/network_constants.h>
 
 #include <condition_variable>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <stdlib.h>
 #include <string>
+#include <string.h>
 
 #define HTTP_SERVER_ADDRESS "0.0.0.0"
 #define HTTP_SERVER_PORT 8080
 #define HTTP_OFFER_URL "/offer"
+#define HTTP_STATS_URL "/stats"
+#define HTTP_WHIP_URL "/whip"
+#define STATS_COLLECT_INTERVAL_MS 5000
 
-int main()
+int main(int argc, char* argv[])
 {
+  /* --loopback includes loopback candidates so local load tests can connect.
+  * --log-sample N logs 1 in every N verbose messages, 0 turns them off.
+  * --pre-encoded sends a pre-encoded VP8 loop instead of re-encoding the echo.
+  * --no-answer-cache creates every answer in full rather than from a cached template.
+  * --handoff PATH takes the listening socket over from a server running with the
+  * same PATH, and hands it to the next one. SIGTERM drains for up to
+  * --drain-timeout seconds before exiting.
+  * --event-log DIR writes an RtcEventLog per peer connection to DIR, for the
+  * percentage set by --event-log-sample, rotating at --event-log-max-mb.
+  * --event-log-pcap adds a pcap of the decrypted RTP headers.
+  * --thread-warn-percent N logs a warning when a factory thread uses more than
+  * N% of a core.
+  * --numa-nic IFACE or --numa-node N pins the factory threads to the cores of
+  * the interface's or given NUMA node, --cpus LIST restricts the cores used.
+  * The codec options are listed in CODEC_PROFILE_USAGE. */
+  bool allowLoopback = false;
+  bool useAnswerCache = true;
+  const char* handoffPath = nullptr;
+  int drainTimeoutSeconds = -1;
+  unsigned int logSampleRate = 1;
+  double threadWarnPercent = STATS_THREAD_WARN_PERCENT;
+  SyntheticMediaConfig mediaConfig;
+  CodecProfile codecProfile;
+  EventLogConfig eventLogConfig;
+  CpuPlacementConfig placementConfig;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--loopback") == 0) {
+      allowLoopback = true;
+    }
+    else if (strcmp(argv[i], "--log-sample") == 0 && i + 1 < argc) {
+      logSampleRate = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+    }
+    else if (strcmp(argv[i], "--pre-encoded") == 0) {
+      mediaConfig.preEncodedVideo = true;
+    }
+    else if (strcmp(argv[i], "--no-answer-cache") == 0) {
+      useAnswerCache = false;
+    }
+    else if (strcmp(argv[i], "--handoff") == 0 && i + 1 < argc) {
+      handoffPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--drain-timeout") == 0 && i + 1 < argc) {
+      drainTimeoutSeconds = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--event-log") == 0 && i + 1 < argc) {
+      eventLogConfig.directory = argv[++i];
+    }
+    else if (strcmp(argv[i], "--event-log-sample") == 0 && i + 1 < argc) {
+      eventLogConfig.samplePercent = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--event-log-max-mb") == 0 && i + 1 < argc) {
+      eventLogConfig.maxFileBytes = static_cast<size_t>(atoi(argv[++i])) * 1024 * 1024;
+    }
+    else if (strcmp(argv[i], "--event-log-pcap") == 0) {
+      eventLogConfig.rtpHeaderPcap = true;
+    }
+    else if (strcmp(argv[i], "--thread-warn-percent") == 0 && i + 1 < argc) {
+      threadWarnPercent = atof(argv[++i]);
+    }
+    else {
+      PlacementOptionResult placementResult = ParseCpuPlacementOption(argc, argv, i, placementConfig);
+
+      if (placementResult == PlacementOptionResult::InvalidValue) {
+        std::cerr << "Invalid value " << argv[i + 1] << " for " << argv[i] << ", placement options are "
+          CPU_PLACEMENT_USAGE "." << std::endl;
+        return -1;
+      }
+      else if (placementResult == PlacementOptionResult::NotPlacementOption &&
+        !ParseCodecProfileOption(argc, argv, i, codecProfile)) {
+        std::cerr << "Unrecognised option " << argv[i] << ", placement options are " CPU_PLACEMENT_USAGE
+          " and codec options are " CODEC_PROFILE_USAGE "." << std::endl;
+        return -1;
+      }
+    }
+  }
+
   std::cout << "libwebrtc echo test server" << std::endl;
 
 #ifdef _WIN32
@@ -50,20 +136,51 @@ int main()
 
   rtc::LogMessage::LogToDebug(rtc::LoggingSeverity::WARNING);
 
+  Logger::Instance().SetVerboseSampleRate(logSampleRate);
+  Logger::Instance().Start();
+
+  /* The threads started from here on, including the factory's encoder and
+  * task queue threads, inherit the process placement. */
+  CpuPlacementPlan placement = PlanCpuPlacement(placementConfig);
+  ApplyThreadPlacement(placement.process);
+
   {
+    /* The factory is ready before the listening socket is taken over, with
+    * --pre-encoded it spends a while encoding the loop and the old server has
+    * stopped accepting once the handoff is acknowledged. */
+    PcFactory pcFactory(mediaConfig, codecProfile, eventLogConfig, placement);
+
     HttpSimpleServer httpSvr;
-    httpSvr.Init(HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT, HTTP_OFFER_URL);
+    if (drainTimeoutSeconds >= 0) {
+      httpSvr.SetDrainTimeout(drainTimeoutSeconds);
+    }
+    httpSvr.Init(HTTP_SERVER_ADDRESS, HTTP_SERVER_PORT, HTTP_OFFER_URL, HTTP_STATS_URL, HTTP_WHIP_URL, handoffPath);
 
-    PcFactory pcFactory;
     HttpSimpleServer::SetPeerConnectionFactory(&pcFactory);
+    pcFactory.SetAnswerCacheEnabled(useAnswerCache);
+
+    if (allowLoopback) {
+      pcFactory.SetNetworkIgnoreMask(0);
+    }
+
+    StatsCollector statsCollector(&pcFactory, STATS_COLLECT_INTERVAL_MS);
+    HttpSimpleServer::SetStatsCollector(&statsCollector);
+    statsCollector.SetThreadWarnPercent(threadWarnPercent);
+    statsCollector.Start();
 
     httpSvr.Run();
 
     std::cout << "Stopping HTTP server..." << std::endl;
 
+    statsCollector.Stop();
     httpSvr.Stop();
   }
 
+  /* Everything allocated for signaling should have gone with the factory. */
+  ObjectPool::LogLiveObjects();
+
+  Logger::Instance().Stop();
+
 #ifdef _WIN32
   WSACleanup();
 #endif